@@ -12,18 +12,8 @@
  */
 class WebServer {
 	private:
-		std::vector<Server> servers;
 		NetworkHandler networkHandler;
 
-		// Check validity
-
-		void checkUniquePortForServers(const std::string& configFilename) const;
-		void checkEmptyServers(const std::string& configFilename) const;
-
-		// Init
-
-		void initServersSocket();
-
 		WebServer();
 	public:
 		WebServer(const std::string& configFilename);
@@ -39,10 +29,6 @@ class WebServer {
 
 		const std::vector<Server>& getServers() const;
 
-		// Setters
-
-		void addServer(Server& server);
-
 		// Run
 
 		void runServers();
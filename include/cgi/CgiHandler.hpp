@@ -5,13 +5,16 @@
 // Other includes
 #include <map>
 #include <vector>
+#include <sys/types.h> // pid_t
 #include "HttpRequest.hpp"
 #include "LocationConfig.hpp"
 #include "ServerConfig.hpp"
 #include "HttpResponse.hpp"
 
 /**
- * @brief 
+ * @brief One CGI script run, driven by the event loop: start() launches the
+ * script (or sends the request to the fastcgi_pass backend), then its 
+ * stdin/stdout are pumped one read/write per poll event.
  */
 class CgiHandler {
 	private:
@@ -31,19 +34,56 @@ class CgiHandler {
 		std::vector<std::string> env;
 		std::vector<char*> envp;
 
+		// Running state
+
+		pid_t pid;
+		int exit_fd; // pidfd of the script, -1 if the kernel has none
+		bool own_child; // Launched by the server itself, not by the spawner helper
+		int input_fd; // Script stdin, -1 once the whole body is written
+		int output_fd; // Script stdout, -1 once EOF is read
+		std::string input; // Request body, or FastCGI records for fastcgi_pass
+		size_t input_offset;
+		std::string output;
+		bool headers_taken; // Header block already removed from output
+		long deadline_ms; // Launch (then last output while streaming) + timeout, 0 until started
+		long end_ms; // Launch + CGI_MAX_RUN_SECONDS, where activity stops pushing deadline_ms
+
+		// NPH script: its stdout is the client socket, output_fd a dup of 
+		// exit_fd, which turns readable when it exits
+
+		bool nph;
+		int client_fd;
+
+		// FastCGI backend: input_fd is a dup of the connection output_fd reads
+
+		std::string fastcgi_pass;
+		std::string records; // Received bytes not yet forming a whole record
+		bool ended; // FCGI_END_REQUEST seen: the connection can be reused
+
+		// Context needed to finish the response once the script is done
+
+		HttpRequest httpRequest;
+		const ServerConfig* serverConfig;
+		const LocationConfig* locationConfig;
+		std::string cache_key;
+
 		// Setup
 
 		void setupEnvironment(const ServerConfig& serverConfig);
+		void setupEnvp();
 		std::vector<char*> buildArgs() const;
-		std::string extractCgiContentType(const std::string& cgi_output, std::string& body_out);
+		bool startScript();
+		int watchExit() const;
+		bool startFastCgi();
+		size_t findHeaderEnd(size_t& body_start) const;
 		CgiHandler();
 
 		// Check
 
 	public:
-		CgiHandler(const std::string& script_path, const std::string& cgi_bin, 
-			const HttpRequest& httpRequest, const ServerConfig& serverConfig, 
-			const std::string& path_info);
+		CgiHandler(const std::string& script_path, const std::string& cgi_bin,
+			const HttpRequest& httpRequest, const ServerConfig& serverConfig,
+			const LocationConfig* locationConfig, const std::string& path_info);
 		CgiHandler(const CgiHandler& other);
 		CgiHandler& operator=(const CgiHandler& other);
 		~CgiHandler();
@@ -52,9 +92,41 @@ class CgiHandler {
 
 		std::string toString() const;
 
+		// Getters
+
+		pid_t getPid() const;
+		int getInputFd() const;
+		int getOutputFd() const;
+		const std::string& getScriptPath() const;
+		const HttpRequest& getHttpRequest() const;
+		const ServerConfig& getServerConfig() const;
+		const LocationConfig* getLocationConfig() const;
+		const std::string& getCacheKey() const;
+		long getDeadlineMs() const;
+		bool hasTimedOut(long now_ms) const;
+		bool isStarted() const;
+		bool isFastCgi() const;
+		bool hasHeaders() const;
+		bool isNph() const;
+		bool isClientReceiving() const;
+
+		// Setters
+
+		void setCacheKey(const std::string& cache_key);
+
 		// Core functionality
 
-		bool execute(HttpResponse& httpResponse);
+		bool start(int client_fd);
+		bool writeInput();
+		bool readOutput();
+		void closeInput();
+		void closeOutput();
+		void abort();
+		bool reap();
+		void markActivity();
+		void applyHeaders(HttpResponse& httpResponse) const;
+		std::string takeBody();
+		bool buildResponse(HttpResponse& httpResponse);
 };
 
 std::ostream& operator<<(std::ostream& os, const CgiHandler& obj);
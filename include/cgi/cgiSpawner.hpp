@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+
+// Other includes
+#include <sys/types.h> // pid_t
+
+// Applied to each script before execve; 0 (or empty) leaves it unchanged
+struct CgiLimits {
+	long cpu_seconds; // RLIMIT_CPU, then SIGKILL one second later
+	long address_space; // RLIMIT_AS, in bytes
+	long open_files; // RLIMIT_NOFILE
+	int nice; // Scheduling priority
+	std::string cgroup; // cgroup v2 directory the script is moved into
+};
+
+/**
+ * @brief Launches CGI scripts without fork()ing the server. A helper process,
+ * forked at startup while the server is still small, receives each launch
+ * (with the script's pipe ends) over a Unix socket and vfork()s it; when the
+ * helper is gone the server vfork()s itself.
+ * Scripts launched by the helper are its children, and the kernel reaps 
+ * them: the server follows and kills them through a pidfd only, so the 
+ * helper is not started where pidfds are missing.
+ */
+namespace cgiSpawner {
+	bool start();
+	void stop();
+	bool hasHelper();
+	pid_t spawn(const std::string& dir, char* const argv[], char* const envp[],
+		const CgiLimits& limits, int stdin_fd, int stdout_fd);
+	pid_t spawnLocal(const std::string& dir, char* const argv[], char* const envp[],
+		const CgiLimits& limits, int stdin_fd, int stdout_fd);
+}
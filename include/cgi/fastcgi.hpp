@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// Other includes
+#include <vector>
+
+/**
+ * @brief FastCGI client side: records for one responder request, and a pool
+ * of kept-alive backend connections per fastcgi_pass address
+ * ("unix:/path" or "host:port").
+ */
+namespace fastcgi {
+	std::string buildRequest(const std::vector<std::string>& env,
+		const std::string& body);
+	bool parseRecords(std::string& buffer, std::string& stdout_data, bool& ended);
+
+	bool isValidAddress(const std::string& address);
+	int acquireConnection(const std::string& address);
+	void releaseConnection(const std::string& address, int fd);
+	void clear();
+}
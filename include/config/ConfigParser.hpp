@@ -4,7 +4,7 @@
 
 // Other includes
 #include <fstream> // std::ifstream
-#include "WebServer.hpp"
+#include "ConfigSnapshot.hpp"
 
 /**
  * @brief 
@@ -23,7 +23,7 @@ class ConfigParser {
 
 		ConfigParser();
 	public:
-		ConfigParser(const std::string& configFilename, WebServer& webServer);
+		ConfigParser(const std::string& configFilename, ConfigSnapshot& configSnapshot);
 		ConfigParser(const ConfigParser& other);
 		ConfigParser& operator=(const ConfigParser& other);
 		~ConfigParser();
@@ -49,7 +49,7 @@ class ConfigParser {
 
 		// Parsing
 
-		void parseFile(WebServer& webServer);
+		void parseFile(ConfigSnapshot& configSnapshot);
 		void cleanCurrentLine();
 };
 
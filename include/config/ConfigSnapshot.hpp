@@ -0,0 +1,66 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+#include <vector>
+#include <map>
+#include "Server.hpp"
+#include "SessionConfig.hpp"
+#include "VirtualHosts.hpp"
+
+/**
+ * @brief One loaded configuration file: the server blocks with their listen
+ * sockets, and the session settings. Left as built once checked. Every 
+ * connection holds a reference to the one it was accepted under, so after
+ * a reload the previous configuration lives until its last connection 
+ * closes. Listen sockets of addresses the previous configuration had are 
+ * taken over, not bound again.
+ */
+class ConfigSnapshot {
+	private:
+		std::vector<Server> servers;
+		SessionConfig sessionConfig;
+		std::map<int, VirtualHosts> virtual_hosts; // Listen fd -> its server blocks
+		size_t references; // Connections accepted under it, still open
+
+		// Check validity
+
+		void checkEmptyServers(const std::string& configFilename) const;
+		void checkListenAddresses(const std::string& configFilename) const;
+		void checkSessionConfig(const std::string& configFilename) const;
+
+		// Init
+
+		void preloadErrorResponses();
+		void initServersSocket(const ConfigSnapshot* previous);
+		void buildVirtualHosts();
+
+		ConfigSnapshot();
+	public:
+		ConfigSnapshot(const std::string& configFilename, const ConfigSnapshot* previous);
+		ConfigSnapshot(const ConfigSnapshot& other);
+		ConfigSnapshot& operator=(const ConfigSnapshot& other);
+		~ConfigSnapshot();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Getters
+
+		const std::vector<Server>& getServers() const;
+		SessionConfig& getSessionConfig();
+		const SessionConfig& getSessionConfig() const;
+		const std::map<int, VirtualHosts>& getVirtualHosts() const;
+		const VirtualHosts* findVirtualHosts(int server_fd) const;
+		bool isReferenced() const;
+
+		// Setters
+
+		void addServer(Server& server);
+		void acquire();
+		void release();
+};
+
+std::ostream& operator<<(std::ostream& os, const ConfigSnapshot& obj);
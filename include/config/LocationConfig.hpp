@@ -5,25 +5,46 @@
 // Other includes
 #include <vector>
 #include <map>
+#include "PrebuiltResponse.hpp"
 
 /**
  * @brief 
  */
 class LocationConfig {
 	private:
-		std::string location; // URL path
+		std::string location; // URL path, or a regex after "~" and "~*"
+		std::string modifier; // "", "=", "^~", "~" or "~*", as in nginx
 		std::string root; // Root directory override
 		std::string index; // Default index file
 		bool autoindex; // Enable directory listing
+		std::string autoindex_format; // Directory listing as "html" or "json"
 		std::vector<std::string> allowed_methods; // Allowed HTTP methods
 		std::string return_target; // Target path or URL for HTTP redirection
 		int return_code; // HTTP status code for redirection
 		std::string cgi_extension;
 		std::string cgi_path; // Path to CGI executable
+		std::string fastcgi_pass; // FastCGI backend ("unix:/path" or "host:port")
 		std::string upload_store; // Directory where uploaded files are stored
 		bool upload_enable; // Enable file upload
 		size_t client_max_body_size; // Maximum allowed body size for request
 		std::map<int, std::string> error_pages; // Custom error pages
+		int gzip; // Response compression: 1 on, 0 off, -1 inherit from server
+		std::vector<std::string> gzip_types; // Empty: inherit from server
+		int gzip_min_length; // -1: inherit from server
+		int gzip_comp_level; // -1: inherit from server
+		bool gzip_static; // Serve "<file>.gz" when it exists and gzip is accepted
+		std::map<int, PrebuiltResponse> error_responses; // error_pages, preloaded
+		bool response_cache; // Keep whole GET responses in the response cache
+		int response_cache_valid; // Seconds an entry lives without Cache-Control
+		int cgi_max_processes; // Scripts running at once, 0: no limit
+		int cgi_queue_size; // Requests waiting for a free script slot
+		int cgi_rlimit_cpu; // CPU seconds per script, 0: no limit
+		size_t cgi_rlimit_as; // Address space bytes per script, 0: no limit
+		int cgi_rlimit_nofile; // Open files per script, 0: no limit
+		int cgi_nice; // Scheduling priority of scripts, 0: the server's
+		std::string cgi_cgroup; // cgroup v2 directory scripts are moved into
+		bool cgi_nph; // Scripts write the whole response to the client socket
+		std::string session; // "on", "off", or "lazy": created on first write
 
 		LocationConfig();
 	public:
@@ -39,36 +60,78 @@ class LocationConfig {
 		// Getters && Is
 
 		const std::string& getLocation() const;
+		const std::string& getModifier() const;
 		const std::string& getRoot() const;
 		const std::string& getIndex() const;
+		const std::string& getAutoindexFormat() const;
 		const std::vector<std::string>& getAllowedMethods() const;
 		const std::string& getReturnTarget() const;
 		int getReturnCode() const;
 		const std::string& getCgiExtension() const;
 		const std::string& getCgiPath() const;
+		const std::string& getFastcgiPass() const;
 		const std::string& getUploadStore() const;
 		size_t getClientMaxBodySize() const;
 		const std::map<int, std::string>& getErrorPages() const;
+		int getGzip() const;
+		const std::vector<std::string>& getGzipTypes() const;
+		int getGzipMinLength() const;
+		int getGzipCompLevel() const;
+		const PrebuiltResponse* findErrorResponse(int error_code) const;
+		int getResponseCacheValid() const;
+		int getCgiMaxProcesses() const;
+		int getCgiQueueSize() const;
+		int getCgiRlimitCpu() const;
+		size_t getCgiRlimitAs() const;
+		int getCgiRlimitNofile() const;
+		int getCgiNice() const;
+		const std::string& getCgiCgroup() const;
+		const std::string& getSession() const;
 
 		bool isAutoindexOn() const;
 		bool isUploadEnabled() const;
+		bool isGzipStaticOn() const;
+		bool isResponseCacheOn() const;
+		bool isCgiNphOn() const;
+		bool isRegex() const;
 
 		// Setters && Adders
 
 		bool setLocation(const std::string& location);
+		bool setModifier(const std::string& modifier);
 		bool setRoot(const std::string& root);
 		bool setIndex(const std::string& index);
 		bool setAutoindex(bool isAutoindexOn);
+		bool setAutoindexFormat(const std::string& autoindex_format);
 		bool setAllowedMethods(const std::vector<std::string>& allowed_methods);
 		bool setReturnTarget(const std::string& return_target);
 		bool setReturnCode(int return_code);
 		bool setCgiExtension(const std::string& cgi_extension);
 		bool setCgiPath(const std::string& cgi_path);
+		bool setFastcgiPass(const std::string& fastcgi_pass);
 		bool setUploadStore(const std::string& upload_store);
 		bool setUploadEnable(bool isUploadEnabled);
 		bool setClientMaxBodySize(size_t client_max_body_size);
+		bool setGzip(bool isGzipOn);
+		bool setGzipTypes(const std::vector<std::string>& gzip_types);
+		bool setGzipMinLength(int gzip_min_length);
+		bool setGzipCompLevel(int gzip_comp_level);
+		bool setGzipStatic(bool isGzipStaticOn);
+		bool setResponseCache(bool isResponseCacheOn);
+		bool setResponseCacheValid(int response_cache_valid);
+		bool setCgiMaxProcesses(int cgi_max_processes);
+		bool setCgiQueueSize(int cgi_queue_size);
+		bool setCgiRlimitCpu(int cgi_rlimit_cpu);
+		bool setCgiRlimitAs(size_t cgi_rlimit_as);
+		bool setCgiRlimitNofile(int cgi_rlimit_nofile);
+		bool setCgiNice(int cgi_nice);
+		bool setCgiCgroup(const std::string& cgi_cgroup);
+		bool setCgiNph(bool isCgiNphOn);
+		bool setSession(const std::string& session);
+		static bool normalizeGzipTypes(std::vector<std::string>& gzip_types);
 
 		bool addErrorPage(int error_code, const std::string& file_path);
+		void addErrorResponse(int error_code, const PrebuiltResponse& response);
 
 		// Operators overload
 
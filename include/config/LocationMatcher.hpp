@@ -0,0 +1,71 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+#include <vector>
+#include <regex.h> // regex_t
+
+/**
+ * @brief The locations of a server, in nginx's order: an exact ("=") match,
+ * else the longest prefix if it is "^~", else the first regex ("~", or "~*"
+ * without case) in config order, else the longest prefix.
+ * Prefixes and exact paths share a radix trie: each edge holds a run of 
+ * characters, and a node lists its children by their first one, so a path
+ * is walked once, without allocating. Regexes are compiled as the location
+ * blocks are read. When there are any, the last results are remembered 
+ * per path (LOCATION_MEMO_SIZE of them), so a hot URL skips them.
+ * Locations are referred to by their index in ServerConfig::locations, 
+ * so copies of the config stay valid.
+ */
+class LocationMatcher {
+	private:
+		struct Node {
+			std::string label; // Characters on the edge from the parent
+			int location; // Prefix location ending here, -1 if none
+			bool stops_regex; // That location is "^~"
+			int exact; // "=" location for exactly this path, -1 if none
+			std::string firsts; // First character of each child's label
+			std::vector<size_t> children; // In the same order as firsts
+		};
+
+		struct Pattern {
+			std::string source;
+			bool caseless;
+			int location;
+			regex_t* compiled;
+		};
+
+		struct MemoEntry {
+			std::string path;
+			int location; // -2: empty entry
+		};
+
+		std::vector<Node> nodes; // nodes[0]: the root, with an empty label
+		std::vector<Pattern> patterns;
+		mutable std::vector<MemoEntry> memo; // Direct-mapped on the path's hash
+
+		size_t addNode(const std::string& label);
+		size_t insertPath(const std::string& path);
+		static regex_t* compilePattern(const std::string& source, bool caseless);
+		void clearPatterns();
+		void copyPatterns(const LocationMatcher& other);
+		int matchUncached(const std::string& path) const;
+	public:
+		LocationMatcher();
+		LocationMatcher(const LocationMatcher& other);
+		LocationMatcher& operator=(const LocationMatcher& other);
+		~LocationMatcher();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Core functionality
+
+		static bool isValidPattern(const std::string& source);
+		bool insert(const std::string& modifier, const std::string& path, int location);
+		int match(const std::string& path) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const LocationMatcher& obj);
@@ -6,6 +6,8 @@
 #include <LocationConfig.hpp>
 #include <vector>
 #include <map>
+#include "PrebuiltResponse.hpp"
+#include "LocationMatcher.hpp"
 
 /**
  * @brief 
@@ -14,13 +16,21 @@ class ServerConfig {
 	private:
 		int listen; // Server listening port (1-65535)
 		std::string host; // Server listening address (IP or hostname)
-		std::string server_name; // Server name (virtual host)
+		std::string server_name; // Server name (virtual host), the first one listed
+		std::vector<std::string> server_names; // All of them, for Host matching
+		bool default_server; // Picked when no server_name matches the Host
 		std::map<int, std::string> error_pages; // Custom error pages (error_code, file_path)
 		size_t client_max_body_size; // Maximum request body size in bytes
 		std::string root; // Document root directory
 		std::string index; // Default index file
 		std::vector<std::string> allowed_methods; // Allowed HTTP methods
 		std::vector<LocationConfig> locations;
+		LocationMatcher locationMatcher; // locations, by prefix
+		bool gzip; // Enable on-the-fly response compression
+		std::vector<std::string> gzip_types; // MIME types eligible for compression
+		size_t gzip_min_length; // Smallest body worth compressing
+		int gzip_comp_level; // zlib compression level (1-9)
+		std::map<int, PrebuiltResponse> error_responses; // error_pages, preloaded
 	public:
 		ServerConfig();
 		ServerConfig(const ServerConfig& other);
@@ -36,24 +46,40 @@ class ServerConfig {
 		int getListen() const;
 		const std::string& getHost() const;
 		const std::string& getServerName() const;
+		const std::vector<std::string>& getServerNames() const;
+		bool isDefaultServer() const;
 		const std::map<int, std::string>& getErrorPages() const;
 		size_t getClientMaxBodySize() const;
 		const std::string& getRoot() const;
 		const std::string& getIndex() const;
 		const std::vector<std::string>& getAllowedMethods() const;
 		const std::vector<LocationConfig>& getLocations() const;
+		std::vector<LocationConfig>& getLocations();
+		const LocationConfig* findLocation(const std::string& path) const;
+		bool isGzipOn() const;
+		const std::vector<std::string>& getGzipTypes() const;
+		size_t getGzipMinLength() const;
+		int getGzipCompLevel() const;
+		const PrebuiltResponse* findErrorResponse(int error_code) const;
 
 		// Setters && Adders
 
 		bool setListen(int listen);
 		bool setHost(const std::string& host);
 		bool setServerName(const std::string& server_name);
+		bool setDefaultServer(bool default_server);
 		bool setClientMaxBodySize(size_t client_max_body_size);
 		bool setRoot(const std::string& root);
 		bool setIndex(const std::string& index);
+		bool setGzip(bool isGzipOn);
+		bool setGzipTypes(const std::vector<std::string>& gzip_types);
+		bool setGzipMinLength(int gzip_min_length);
+		bool setGzipCompLevel(int gzip_comp_level);
 
+		bool addServerName(const std::string& server_name);
 		bool addErrorPage(int error_code, const std::string& file_path);
 		bool addLocation(const LocationConfig& location);
+		void addErrorResponse(int error_code, const PrebuiltResponse& response);
 };
 
 std::ostream& operator<<(std::ostream& os, const ServerConfig& obj);
@@ -0,0 +1,51 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+/**
+ * @brief Process-wide session settings, from directives outside any server
+ * block: all servers share one SessionManager
+ */
+class SessionConfig {
+	private:
+		std::string store_path; // Snapshot file, empty: sessions are not persisted
+		int snapshot_interval; // Seconds between snapshots, 0: only on shutdown
+		size_t max_count; // Live sessions before the least recent go, 0: no cap
+		size_t max_memory; // Estimated bytes before the least recent go, 0: no cap
+		int create_rate; // New sessions per client IP and window, 0: no limit
+		int create_window; // in seconds
+		std::string backend; // "memory", or "cookie": the signed record is the cookie
+		std::string secret; // HMAC-SHA256 key of the cookie backend
+	public:
+		SessionConfig();
+		SessionConfig(const SessionConfig& other);
+		SessionConfig& operator=(const SessionConfig& other);
+		~SessionConfig();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Getters
+
+		const std::string& getStorePath() const;
+		int getSnapshotInterval() const;
+		size_t getMaxCount() const;
+		size_t getMaxMemory() const;
+		int getCreateRate() const;
+		int getCreateWindow() const;
+		const std::string& getBackend() const;
+		const std::string& getSecret() const;
+
+		// Setters
+
+		bool setStorePath(const std::string& store_path);
+		bool setSnapshotInterval(int snapshot_interval);
+		bool setMaxCount(int max_count);
+		bool setMaxMemory(size_t max_memory);
+		bool setCreateRate(int create_rate, int create_window);
+		bool setBackend(const std::string& backend);
+		bool setSecret(const std::string& secret);
+};
+
+std::ostream& operator<<(std::ostream& os, const SessionConfig& obj);
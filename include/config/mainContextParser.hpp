@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include "SessionConfig.hpp"
+#include "ConfigParser.hpp"
+
+/**
+ * @brief Directives outside any server block
+ */
+namespace mainContextParser {
+	void parseMainDirectiveLine(SessionConfig& sessionConfig, ConfigParser& parser);
+}
@@ -3,8 +3,28 @@
 #include <string>
 
 // Other includes
-#include <map>
+#include <vector>
 #include <ctime>
+#include <stdint.h> // uint32_t, uint64_t
+
+// What the server itself tracks per session, as plain fields
+struct SessionRecord {
+	unsigned int page_views;
+	unsigned int upload_count;
+	unsigned int delete_count;
+	unsigned int cgi_count;
+	time_t last_page_time;
+	time_t last_upload_time;
+	time_t last_delete_time;
+	time_t last_cgi_time;
+	std::string last_page;
+	std::string last_upload;
+	std::string last_delete;
+	std::string last_cgi;
+	bool bound; // client_ip and user_agent_hash are set
+	uint32_t client_ip; // IPv4 address, network order
+	uint64_t user_agent_hash; // FNV-1a of the User-Agent header
+};
 
 /**
  * @brief 
@@ -12,10 +32,13 @@
 class Session {
 	private:
 		std::string session_id;
-		std::map<std::string, std::string> data;
+		SessionRecord record;
+		// Anything else: a handful of entries, searched linearly
+		std::vector<std::pair<std::string, std::string> > data;
 		time_t created_at;
 		time_t last_accessed;
 		int max_age; // in seconds
+		bool changed; // Written to by a handler, not just read or counted
 
 		Session();
 	public:
@@ -31,12 +54,17 @@ class Session {
 		// Getters
 
 		const std::string& getSessionId() const;
+		SessionRecord& getRecord();
+		const SessionRecord& getRecord() const;
 		std::string getData(const std::string& key) const;
+		const std::vector<std::pair<std::string, std::string> >& getDataEntries() const;
 		time_t getCreatedAt() const;
 		time_t getLastAccessed() const;
 		int getMaxAge() const;
+		size_t getMemoryUsage() const;
 
 		bool hasData(const std::string& key) const;
+		bool isChanged() const;
 
 		// Setters
 
@@ -44,11 +72,14 @@ class Session {
 		void setMaxAge(int seconds);
 
 		void removeData(const std::string& key);
+		void markChanged();
 
 		// Time management
 
 		bool isExpired() const;
+		time_t getExpiry() const;
 		void updateLastAccessed();
+		void restoreTimes(time_t created_at, time_t last_accessed);
 		bool isNew() const;
 
 };
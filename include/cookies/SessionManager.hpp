@@ -3,19 +3,96 @@
 #include <string>
 
 // Other includes
-#include <map>
+#include <vector>
+#include <list>
+#include <stdint.h> // uint64_t
 #include "Session.hpp"
+#include "SessionConfig.hpp"
+#include "SessionRateLimiter.hpp"
 
 /**
- * @brief 
+ * @brief Live sessions, in an open-addressing table (linear probing, 
+ * backward-shift deletion) keyed by 128-bit ids from getrandom(). The ids
+ * are uniform already, so their first half is the hash. Sessions themselves
+ * live on the heap: slots stay small, and a Session* survives a resize.
+ * Expiry goes through a deadline heap, a few sessions per loop iteration.
+ * The whole table can be saved to a binary snapshot file and read back; 
+ * the event loop writes it a batch of sessions per iteration.
+ * Past session_max_count sessions or session_max_memory estimated bytes, 
+ * creating a session evicts the least recently used ones.
+ * With session_backend cookie, nothing is kept here: the session travels in
+ * its cookie, signed with HMAC-SHA256, and only the one the current request
+ * brought is held until the next.
  */
 class SessionManager {
 	private:
-		std::map<std::string, Session> sessions;
+		// Recency order; bytes is the session's footprint as of its last use
+		struct LruEntry {
+			uint64_t key[2];
+			size_t bytes;
+		};
+
+		struct Slot {
+			uint64_t key[2];
+			Session* session; // NULL: empty slot
+			std::list<LruEntry>::iterator lru_position;
+		};
+
+		// Expiry times, soonest first. Accesses do not touch it: an entry that 
+		// comes due for a session used since is pushed back to its new expiry
+		struct Deadline {
+			time_t at;
+			uint64_t key[2];
+		};
+
+		std::vector<Slot> slots; // Power of two long, at most half full
+		size_t count;
+		std::vector<Deadline> deadlines; // Min-heap on at
+		std::list<LruEntry> lru; // Most recently used first
+		size_t used_bytes;
+		size_t max_count; // 0: no cap
+		size_t max_memory; // 0: no cap
+		SessionRateLimiter rateLimiter;
+		bool stateless; // session_backend cookie
+		std::string secret; // HMAC key for the cookies
+		Session* cookie_session; // The current request's, NULL if none yet
+		std::string cookie_payload; // What it was decoded from, empty if created
+		time_t cookie_issued; // Its last_accessed, as signed
+
+		// Snapshot being written, a batch at a time
+
+		int snapshot_fd; // -1 if none
+		std::string snapshot_path;
+		std::vector<LruEntry> snapshot_order; // Ids as of its start, oldest first
+		size_t snapshot_next; // First of snapshot_order not written yet
+		uint64_t snapshot_count; // Sessions written, some may be gone meanwhile
+		std::string snapshot_buffer;
 
 		// Private methods
 
-		std::string generateSessionId();
+		static bool decodeId(const std::string& session_id, uint64_t key[2]);
+		static std::string generateSessionId(uint64_t key[2]);
+		size_t findSlot(const uint64_t key[2]) const;
+		void rehash(size_t size);
+		void eraseSlot(size_t index);
+		void insertSlot(size_t index, const uint64_t key[2], Session* session);
+		void touch(size_t index);
+		static size_t footprint(const Session& session);
+		void evictOverLimits(size_t sessions, size_t bytes);
+		void compactDeadlines();
+		void pushDeadline(time_t at, const uint64_t key[2]);
+		static bool isLater(const Deadline& a, const Deadline& b);
+		void copySessions(const SessionManager& other);
+		void clearSessions();
+		void reserve(size_t total);
+		static void encodeSession(std::string& out, const uint64_t key[2], 
+			const Session& session);
+		bool openToken(const std::string& token, std::string& payload) const;
+		Session* decodeToken(const std::string& token);
+		void holdCookieSession(Session* session, const std::string& payload);
+		bool writeSnapshotBatch(size_t max_count);
+		bool finishSnapshot();
+		void abortSnapshot();
 	public:
 		SessionManager();
 		SessionManager(const SessionManager& other);
@@ -26,17 +103,33 @@ class SessionManager {
 
 		std::string toString() const;
 
+		// Setters
+
+		void setConfig(const SessionConfig& sessionConfig);
+
 		// Sessions management
 
+		bool allowCreation(const std::string& client_ip);
 		Session& createSession();
 		Session* getSession(const std::string& session_id);
 		void destroySession(const std::string& session_id);
-		void cleanExpiredSessions();
+		std::string issueCookie(const Session& session, const std::string& current_value);
+		size_t expireSessions(size_t max_count);
+		time_t getNextExpiry() const;
+
+		// Persistence
+
+		bool beginSnapshot(const std::string& path);
+		bool continueSnapshot(size_t max_count);
+		bool isSnapshotting() const;
+		bool writeSnapshot(const std::string& path);
+		size_t loadSnapshot(const std::string& path);
 
 		// Utility
 
 		bool sessionExists(const std::string& session_id) const;
 		size_t getSessionCount() const;
+		size_t getMemoryUsage() const;
 };
 
 std::ostream& operator<<(std::ostream& os, const SessionManager& obj);
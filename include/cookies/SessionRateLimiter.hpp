@@ -0,0 +1,46 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+#include <vector>
+#include <ctime>
+#include <stdint.h> // uint32_t
+
+/**
+ * @brief Caps how many sessions one client IP may create per window. The 
+ * counters live in a fixed table (SESSION_RATE_TABLE_SIZE buckets, probed
+ * SESSION_RATE_PROBE deep), so a flood from many addresses cannot grow it:
+ * a newcomer takes a bucket whose window is over, or else the oldest one
+ */
+class SessionRateLimiter {
+	private:
+		struct Bucket {
+			uint32_t ip; // IPv4 address, network order
+			uint32_t count; // Sessions created in the current window, 0: free
+			time_t window_start;
+		};
+
+		std::vector<Bucket> buckets; // Power of two long
+		unsigned int limit; // Sessions per window, 0: no limit
+		int window; // in seconds
+	public:
+		SessionRateLimiter();
+		SessionRateLimiter(const SessionRateLimiter& other);
+		SessionRateLimiter& operator=(const SessionRateLimiter& other);
+		~SessionRateLimiter();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Setters
+
+		void setRate(unsigned int limit, int window);
+
+		// Core functionality
+
+		bool allow(uint32_t ip);
+};
+
+std::ostream& operator<<(std::ostream& os, const SessionRateLimiter& obj);
@@ -5,13 +5,20 @@
 #include "HttpRequest.hpp"
 #include "SessionManager.hpp"
 #include "HttpResponse.hpp"
+#include "LocationConfig.hpp"
 
 /**
  * @brief
  */
 namespace cookieUtils {
+	Session* startSession(const HttpRequest& httpRequest, SessionManager& sessionManager);
 	Session* getOrCreateSession(const HttpRequest& httpRequest, 
-		SessionManager& sessionManager, HttpResponse& httpResponse);
+		SessionManager& sessionManager);
+	Session* openSession(const HttpRequest& httpRequest, 
+		const LocationConfig* locationConfig, SessionManager& sessionManager, 
+		HttpResponse& httpResponse, Session& pending);
+	void commitSession(const HttpRequest& httpRequest, SessionManager& sessionManager, 
+		HttpResponse& httpResponse, Session* session, const Session& pending);
 	void trackPageView(Session* session, const std::string& resource_path);
 	void trackFileUpload(Session* session, const std::string& filename);
 	void trackFileDelete(Session* session, const std::string& resource_path);
@@ -0,0 +1,46 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+#include <zlib.h>
+
+/**
+ * @brief Incremental gzip/deflate encoder: data is fed in pieces and the
+ * compressed bytes are appended to the caller's buffer as they come out.
+ */
+class Compressor {
+	private:
+		z_stream stream;
+		bool active;
+		std::string coding; // "gzip" or "deflate"
+		int level;
+
+	public:
+		Compressor();
+		Compressor(const Compressor& other);
+		Compressor& operator=(const Compressor& other);
+		~Compressor();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Getters
+
+		bool isActive() const;
+		const std::string& getCoding() const;
+
+		// Core functionality
+
+		bool start(const std::string& coding, int level);
+		bool compress(const char* data, size_t size, std::string& out, bool finish);
+		void end();
+
+		// One-shot helper for bodies already held in memory
+
+		static bool compressString(const std::string& coding, int level,
+			const std::string& in, std::string& out);
+};
+
+std::ostream& operator<<(std::ostream& os, const Compressor& obj);
@@ -4,7 +4,11 @@
 
 // Other includes
 #include "HttpRequest.hpp"
+#include "PrebuiltResponse.hpp"
 #include <vector>
+#include <sstream>
+
+class CgiHandler;
 
 /**
  * @brief 
@@ -18,6 +22,21 @@ class HttpResponse {
 		std::string body;
 
 		std::vector<std::string> cookies_to_set;
+
+		int body_fd; // File streamed after the headers, -1 when body is in memory
+		size_t body_fd_length;
+		std::string content_coding; // Coding applied while streaming body_fd
+		int compression_level;
+
+		const PrebuiltResponse* prebuilt; // Serialized error response, owned by config
+		bool streamed; // Body forwarded from the CGI output as it arrives
+
+		// Deferred: the event loop produces the response later
+
+		CgiHandler* cgi; // Running script whose output becomes this response
+		std::string awaited_cache_key; // Cache entry another request is filling
+
+		void appendHeaderFields(std::ostringstream& oss) const;
 	public:
 		HttpResponse();
 		HttpResponse(const HttpResponse& other);
@@ -32,6 +51,16 @@ class HttpResponse {
 
 		const std::string& getHeader(const std::string& key) const;
 		int getStatusCode() const;
+		const std::string& getBody() const;
+		int getBodyFd() const;
+		size_t getBodyFdLength() const;
+		const std::string& getContentCoding() const;
+		int getCompressionLevel() const;
+		const PrebuiltResponse* getPrebuilt() const;
+		CgiHandler* getCgi() const;
+		const std::string& getAwaitedCacheKey() const;
+		bool isDeferred() const;
+		bool isStreamed() const;
 
 		// Setters
 
@@ -40,6 +69,14 @@ class HttpResponse {
 		void setReasonPhrase(const std::string& reason_phrase);
 		void setHeader(const std::string& key, const std::string& value);
 		void setBody(const std::string& body);
+		void setBodyFile(int fd, size_t length);
+		void setContentCoding(const std::string& coding, int level);
+		void removeHeader(const std::string& key);
+		void setPrebuilt(const PrebuiltResponse& prebuilt);
+		void setCgi(CgiHandler* cgi);
+		void setAwaitedCacheKey(const std::string& cache_key);
+		void setStreamed(bool streamed);
+		void loadCached(const HttpResponse& cached);
 
 		// Builders
 
@@ -50,6 +87,7 @@ class HttpResponse {
 		void buildOk(const std::string& content, const std::string& mime_type);
 		void buildCreated();
 		void buildNoContent();
+		void buildNotModified();
 		void buildPayloadTooLarge();
 		void buildRedirect(int return_code, const std::string& return_target);
 		void buildForbidden();
@@ -57,6 +95,7 @@ class HttpResponse {
 
 		// Convert
 
+		std::string toStringHeaders() const;
 		std::string toStringResponse() const;
 
 		// Cookies
@@ -64,6 +103,8 @@ class HttpResponse {
 		void setCookie(const std::string& name, const std::string& value, 
 			int max_age = 3600, const std::string& path = "/");
 		void expireCookie(const std::string& name);
+		void addSetCookie(const std::string& set_cookie);
+		void clearCookies();
 };
 
 std::ostream& operator<<(std::ostream& os, const HttpResponse& obj);
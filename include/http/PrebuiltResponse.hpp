@@ -0,0 +1,37 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+
+
+/**
+ * @brief Immutable, already serialized response (status line, static headers 
+ * and body) built once at config load and served from memory.
+ */
+class PrebuiltResponse {
+	private:
+		int status_code;
+		std::string head; // Status line and static headers, each CRLF-terminated
+		std::string body;
+
+	public:
+		PrebuiltResponse();
+		PrebuiltResponse(int status_code, const std::string& reason_phrase, 
+			const std::string& content_type, const std::string& body);
+		PrebuiltResponse(const PrebuiltResponse& other);
+		PrebuiltResponse& operator=(const PrebuiltResponse& other);
+		~PrebuiltResponse();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Getters
+
+		int getStatusCode() const;
+		const std::string& getHead() const;
+		const std::string& getBody() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const PrebuiltResponse& obj);
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+// Other includes
+#include "HttpResponse.hpp"
+
+/**
+ * @brief Directory listings (autoindex_format html|json), rendered once per 
+ * directory mtime in sorted order and replayed until the directory changes.
+ */
+namespace autoindex {
+	bool serve(const std::string& dir_path, const std::string& format, 
+		HttpResponse& httpResponse);
+	void clear();
+}
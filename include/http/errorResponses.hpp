@@ -0,0 +1,15 @@
+#pragma once
+
+// Other includes
+#include "ServerConfig.hpp"
+#include "PrebuiltResponse.hpp"
+
+/**
+ * @brief Error and status responses serialized once at config load: built-in 
+ * defaults plus every configured error_page, per server and per location.
+ */
+namespace errorResponses {
+	const char* getReasonPhrase(int status_code);
+	const PrebuiltResponse& getDefault(int status_code);
+	void preload(ServerConfig& serverConfig);
+}
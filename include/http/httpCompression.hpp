@@ -0,0 +1,24 @@
+#pragma once
+
+// Other includes
+#include "ServerConfig.hpp"
+#include "LocationConfig.hpp"
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include <string>
+
+/**
+ * @brief Accept-Encoding negotiation and gzip/deflate policy (gzip, 
+ * gzip_types, gzip_min_length, gzip_comp_level) at server or location level.
+ */
+namespace httpCompression {
+	bool acceptsCoding(const std::string& accept_encoding, const std::string& coding);
+	std::string negotiateContentCoding(const std::string& accept_encoding);
+	bool isCompressibleType(const std::vector<std::string>& gzip_types, 
+		const std::string& content_type);
+	bool variesByEncoding(const ServerConfig& serverConfig, 
+		const LocationConfig* locationConfig, const std::string& content_type, 
+		size_t length);
+	void compressResponse(const HttpRequest& httpRequest, const ServerConfig& serverConfig, 
+		const LocationConfig* locationConfig, HttpResponse& httpResponse);
+}
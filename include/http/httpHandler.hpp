@@ -4,6 +4,8 @@
 #include "ServerConfig.hpp"
 #include "HttpResponse.hpp"
 #include "SessionManager.hpp"
+#include "CgiHandler.hpp"
+#include "VirtualHosts.hpp"
 
 /**
  * @brief 
@@ -11,7 +13,9 @@
 namespace httpHandler {
 	void handleError(int error_code, const ServerConfig& serverConfig, 
 		const LocationConfig* locationConfig, HttpResponse& httpResponse);
-	std::string processHttpRequest(const std::string& raw_request, 
-		const ServerConfig& serverConfig, const std::string& client_remote_addr, 
-		SessionManager& sessionManager);
+	void processHttpRequest(const std::string& raw_request, 
+		const VirtualHosts& virtualHosts, const std::string& client_remote_addr, 
+		SessionManager& sessionManager, HttpResponse& httpResponse);
+	void beginCgiStream(CgiHandler& cgi, HttpResponse& httpResponse);
+	void completeCgiRequest(CgiHandler& cgi, int error_code, HttpResponse& httpResponse);
 };
@@ -4,6 +4,8 @@
 #include "LocationConfig.hpp"
 #include "ServerConfig.hpp"
 #include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "statCache.hpp"
 #include <string>
 
 /**
@@ -17,6 +19,7 @@ namespace httpUtils {
 		const std::string& path);
 	const std::string buildResourcePath(const ServerConfig& serverConfig, 
 		const LocationConfig* locationConfig, const HttpRequest& httpRequest);
+	std::string resolveUriToPath(const ServerConfig& serverConfig, const std::string& uri);
 	const std::string extractFilenameFromPath(const std::string& path);
 	bool checkMethodAllowed(const ServerConfig& ServerConfig, const LocationConfig* locationConfig, 
 		const HttpRequest& HttpRequest);
@@ -27,4 +30,6 @@ namespace httpUtils {
 	bool checkUploadAllowed(const LocationConfig* locationConfig);
 	std::string extractCgiPathInfo(const std::string& request_path, const std::string& cgi_ext);
 	std::string extractCgiScriptPath(const std::string& resource_path, const std::string& cgi_ext);
+	bool checkNotModified(const HttpRequest& httpRequest, const FileInfo& fileInfo);
+	bool checkNotModified(const HttpRequest& httpRequest, const HttpResponse& cached);
 }
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <ctime>
+
+// Other includes
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "ServerConfig.hpp"
+
+/**
+ * @brief Process-wide microcache of whole GET responses (static, autoindex 
+ * or CGI) for locations with "response_cache on", bounded by a byte budget.
+ * While a CGI run fills a key, other requests for it wait instead of running 
+ * the script again; a fill that could not be cached lets them all pass.
+ */
+namespace responseCache {
+	std::string buildKey(const HttpRequest& httpRequest, const ServerConfig& serverConfig);
+	bool lookup(const std::string& key, HttpResponse& httpResponse);
+	bool store(const std::string& key, HttpResponse& httpResponse, int default_ttl);
+	bool isFilling(const std::string& key);
+	void beginFill(const std::string& key);
+	void endFill(const std::string& key, bool stored, int default_ttl);
+	void clear();
+	size_t getUsedBytes();
+	size_t getPassCount();
+}
@@ -3,8 +3,12 @@
 #include <string>
 
 // Other includes
-#include "ServerConfig.hpp"
+#include "VirtualHosts.hpp"
+#include "ConfigSnapshot.hpp"
+#include "HttpResponse.hpp"
+#include "Compressor.hpp"
 #include <poll.h>
+#include <sys/types.h> // off_t
 
 
 /**
@@ -13,7 +17,8 @@
 class Client {
 	private:
 		int client_fd;
-		const ServerConfig& serverConfig;
+		ConfigSnapshot* config; // Configuration the connection was accepted under
+		const VirtualHosts& virtualHosts; // Server blocks of the listen socket, in config
 		std::string request_buffer;
 		std::string response_buffer;
 		bool request_complete;
@@ -25,6 +30,37 @@ class Client {
 		size_t content_length;
 		bool content_parsed;
 
+		// Body sent after response_buffer: a preloaded error page written 
+		// straight from config memory, or a file (optionally compressed)
+
+		const std::string* body_ref;
+		size_t body_ref_offset;
+		int body_fd;
+		off_t body_offset;
+		size_t body_remaining;
+		Compressor compressor;
+
+		// CGI output forwarded while the script runs: framed into 
+		// response_buffer, or spliced from the pipe when it goes out untouched
+
+		bool streaming;
+		bool stream_chunked;
+		bool stream_ended; // Script done, only response_buffer is left
+		bool stream_blocked; // The socket refused a splice, wait for POLLOUT
+		bool stream_sized; // The script's Content-Length frames the body
+		size_t stream_remaining; // Body bytes that length still allows
+
+		// Response waiting on a CGI script or on another request's cache fill
+
+		HttpResponse deferred_response;
+		std::string deferred_request;
+
+		bool sendBodyFile();
+		bool fillCompressedChunk();
+		bool sendBodyRef();
+		void frameStreamBody(const std::string& data);
+		bool writeStream();
+
 		// Handle chunks
 
 		
@@ -34,7 +70,7 @@ class Client {
 		Client();
 		Client& operator=(const Client& other);
 	public:
-		Client(int client_fd, const ServerConfig& serverConfig, 
+		Client(int client_fd, ConfigSnapshot* config, const VirtualHosts& virtualHosts, 
 			const std::string& remote_addr);
 		Client(const Client& other);
 		~Client();
@@ -48,18 +84,32 @@ class Client {
 		// Getters
 
 		int getClientFd() const;
-		const ServerConfig& getServerConfig() const;
+		ConfigSnapshot* getConfig() const;
+		const VirtualHosts& getVirtualHosts() const;
 		std::string& getRequestBuffer();
 		std::string& getResponseBuffer();
 		bool isRequestComplete() const;
 		bool isResponseSent() const;
+		bool hasResponse() const;
 		const std::string& getRemoteAddr() const;
+		HttpResponse& getDeferredResponse();
+		const std::string& getDeferredRequest() const;
+		bool isDeferred() const;
+		bool isStreaming() const;
+		bool isStreamSpliceable() const;
+		bool isStreamBlocked() const;
+		bool isStreamFilled() const;
+		bool hasPendingOutput() const;
 
 		// Setters
 
 		void setRequestComplete(bool value);
 		void setResponseSent(bool value);
 		void setResponseBuffer(const std::string& response_buffer);
+		void setResponse(const HttpResponse& httpResponse);
+		void closeBody();
+		void setDeferred(const HttpResponse& httpResponse, const std::string& raw_request);
+		void clearDeferred();
 
 		// readRequest sub functions
 		size_t parseContentLength(const std::string& headers) const;
@@ -67,7 +117,11 @@ class Client {
 		// Core functionality
 
 		bool readRequest();
-		bool writeResponse(pollfd &pollClient);
+		bool writeResponse();
+		void startStream(const HttpResponse& httpResponse);
+		void appendStreamBody(const std::string& data);
+		void endStream();
+		ssize_t spliceStreamBody(int pipe_fd);
 
 };
 
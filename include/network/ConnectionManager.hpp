@@ -26,11 +26,12 @@ class ConnectionManager {
 		// Getters
 
 		Client& getClient(int client_fd);
+		bool hasClient(int client_fd) const;
 
 		// Core functionality
 
-		void addClient(int client_fd, const ServerConfig& serverConfig, 
-			const std::string& remote_addr);
+		void addClient(int client_fd, ConfigSnapshot* config, 
+			const VirtualHosts& virtualHosts, const std::string& remote_addr);
 		void removeClient(int client_fd);
 };
 
@@ -9,30 +9,78 @@
 #include "ConnectionManager.hpp"
 #include "ServerConfig.hpp"
 #include "SessionManager.hpp"
+#include "ConfigSnapshot.hpp"
+#include "CgiHandler.hpp"
+#include "VirtualHosts.hpp"
+#include <map>
+#include <deque>
 
 /**
  * @brief 
  */
 class NetworkHandler {
 	private:
-		const std::vector<Server>* servers;
+		ConfigSnapshot* config; // What new connections are accepted under
+		std::vector<ConfigSnapshot*> retired; // Replaced, still used by connections
+		std::string config_filename; // Read again on SIGHUP
 		Poller poller;
 		ConnectionManager connectionManager;
 		SessionManager sessionManager;
 
+		std::map<int, int> cgi_fds; // CGI pipe fd -> client fd it answers
+		std::map<std::string, std::vector<int> > cache_waiters; // Key -> client fds
+		std::vector<pid_t> unreaped; // Finished scripts not yet collected
+		std::map<const LocationConfig*, int> cgi_running; // Scripts per location
+		std::map<const LocationConfig*, std::deque<int> > cgi_queues; // Client fds waiting for a slot
+		int signal_fd; // signalfd reporting SIGCHLD and SIGHUP, -1 if unavailable
+		time_t next_snapshot; // When the next one is due, 0 if never
+
 		// Handle listen sockets
 
 		void addListeningSocketsToPoller();
 		bool isListeningSocket(int fd) const;
 		void acceptNewConnection(int server_fd);
-		const ServerConfig& findServerConfigForServerFd(int server_fd);
+		const VirtualHosts& findVirtualHostsForServerFd(int server_fd);
 
 		// Handle life cycle of a client (read, process, write)
 
 		bool readClientRequest(Client& client, int client_fd);
-		void generateClientResponse(Client& client);
-		void writeClientResponse(Client& client,pollfd& pollClient);
+		void generateClientResponse(Client& client, const std::string& raw_request);
+		void writeClientResponse(Client& client);
 		void processClientEvent(pollfd pollClient);
+		void closeClientConnection(int client_fd);
+
+		// Handle CGI scripts and cache waiters running alongside the clients
+
+		void launchCgi(Client& client);
+		void attachCgi(Client& client);
+		void detachCgi(CgiHandler& cgi, bool kill_script);
+		void processCgiEvent(pollfd pollCgi);
+		void respondCgi(Client& client, int error_code);
+		void finishCgi(Client& client, int error_code);
+		void abortCgi(Client& client);
+		void launchQueuedCgi(const LocationConfig* location);
+		void startCgiStream(Client& client);
+		void pumpCgiStream(Client& client);
+		void endCgiStream(Client& client);
+		void endNphCgi(Client& client, bool kill_script);
+		void updateStreamEvents(Client& client);
+		int nextTimeout();
+		void checkCgiTimeouts();
+		void releaseCacheWaiters(const std::string& cache_key);
+		void watchSignals();
+		void processSignalEvent();
+		void reapChildren();
+
+		// Persist sessions across restarts
+
+		bool isPersistingSessions() const;
+		void snapshotSessions();
+
+		// Reload the configuration on SIGHUP
+
+		void reloadConfig();
+		void releaseRetiredConfigs();
 
 		// Cleanup
 
@@ -48,9 +96,13 @@ class NetworkHandler {
 
 		std::string toString() const;
 
+		// Getters
+
+		const ConfigSnapshot& getConfig() const;
+
 		// Setters
 
-		void setServers(const std::vector<Server>* servers);
+		void loadConfig(const std::string& configFilename);
 
 		// Core functionality
 
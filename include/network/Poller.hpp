@@ -31,6 +31,7 @@ class Poller {
 
 		void addFd(int fd, short events = POLLIN);
 		void removeFd(int fd);
+		bool hasFd(int fd) const;
 		// void modifyFd(int fd, short events);
 		void setEvents(int fd, short events);
 		int poll(int timeout = -1);
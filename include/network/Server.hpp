@@ -33,6 +33,7 @@ class Server {
 		// Init
 
 		void initSocket();
+		void shareSocket(const Server& other);
 };
 
 std::ostream& operator<<(std::ostream& os, const Server& obj);
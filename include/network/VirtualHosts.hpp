@@ -0,0 +1,45 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// Other includes
+#include <map>
+#include "ServerConfig.hpp"
+
+/**
+ * @brief The server blocks sharing one listen socket, by server_name. A 
+ * request's Host picks, like nginx does: the exact name, else the longest
+ * leading wildcard ("*.example.com"), else the longest trailing one 
+ * ("www.example.*"), else the default_server, or the first block listed.
+ * Each step is a map lookup per label of the host, never a scan of the 
+ * blocks. A name claimed twice goes to the first block.
+ */
+class VirtualHosts {
+	private:
+		const ServerConfig* default_server;
+		std::map<std::string, const ServerConfig*> exact_names;
+		std::map<std::string, const ServerConfig*> leading_wildcards; // ".example.com"
+		std::map<std::string, const ServerConfig*> trailing_wildcards; // "www.example."
+
+		static std::string normalizeHost(const std::string& host);
+	public:
+		VirtualHosts();
+		VirtualHosts(const VirtualHosts& other);
+		VirtualHosts& operator=(const VirtualHosts& other);
+		~VirtualHosts();
+
+		// Debug
+
+		std::string toString() const;
+
+		// Getters
+
+		const ServerConfig& getDefault() const;
+
+		// Core functionality
+
+		void add(const ServerConfig* serverConfig);
+		const ServerConfig& find(const std::string& host) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const VirtualHosts& obj);
@@ -2,5 +2,28 @@
 
 #define KILO_OCTET 1024
 #define CLIENT_READ_REQUEST_BUFFER_SIZE 4096
-#define FIVE_MIN_IN_SECONDS 300
 #define TIMEOUT_SECONDS 3
+#define CGI_MAX_RUN_SECONDS 300
+#define STAT_CACHE_TTL_SECONDS 1
+#define STAT_CACHE_MAX_ENTRIES 4096
+#define CLIENT_SENDFILE_CHUNK_SIZE 1048576
+#define RESPONSE_CACHE_DEFAULT_TTL 10
+#define RESPONSE_CACHE_MAX_BYTES 33554432
+#define RESPONSE_CACHE_MAX_ENTRY_BYTES 1048576
+#define RESPONSE_CACHE_MAX_PASSES 4096
+#define AUTOINDEX_CACHE_MAX_ENTRIES 256
+#define AUTOINDEX_SPILL_SIZE 65536
+#define AUTOINDEX_TMP_TEMPLATE "/tmp/webserv-autoindex-XXXXXX"
+#define FASTCGI_MAX_IDLE_CONNECTIONS 16
+#define SESSION_TABLE_INITIAL_SIZE 1024
+#define SESSION_EXPIRY_BATCH 64
+#define CGI_DEFAULT_MAX_PROCESSES 16
+#define CGI_DEFAULT_QUEUE_SIZE 32
+#define SESSION_SNAPSHOT_DEFAULT_INTERVAL 60
+#define SESSION_SNAPSHOT_BUFFER_SIZE 65536
+#define SESSION_SNAPSHOT_BATCH 1024
+#define SESSION_RATE_TABLE_SIZE 4096
+#define SESSION_RATE_PROBE 8
+#define SESSION_SECRET_MIN_LENGTH 32
+#define SESSION_COOKIE_MAX_SIZE 4000
+#define LOCATION_MEMO_SIZE 256
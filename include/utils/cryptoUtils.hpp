@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief SHA-256 (FIPS 180-4) and HMAC-SHA256 (RFC 2104), for signing 
+ * session cookies. Digests are returned as 32 raw bytes.
+ */
+namespace cryptoUtils {
+	std::string sha256(const std::string& message);
+	std::string hmacSha256(const std::string& key, const std::string& message);
+	bool constantTimeEquals(const std::string& a, const std::string& b);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <ctime>
+#include <sys/types.h>
+
+struct FileInfo {
+	bool exists;
+	bool is_dir;
+	off_t size;
+	time_t mtime;
+	ino_t ino;
+	std::string etag; // Strong validator built from inode, size and mtime
+	std::string last_modified; // mtime as an HTTP-date
+	time_t cached_at;
+};
+
+/**
+ * @brief Short-lived cache of stat() results, so hot paths (revalidation,
+ * existence checks, error floods) never touch the disk twice per second.
+ */
+namespace statCache {
+	FileInfo lookup(const std::string& path);
+	void invalidate(const std::string& path);
+	void clear();
+	size_t getEntryCount();
+}
@@ -10,4 +10,6 @@ namespace stringUtils {
 	int stringToInt(const std::string& str);
 	bool isInt(const std::string& str);
 	std::string toString(int value);
+	std::string base64UrlEncode(const std::string& bytes);
+	bool base64UrlDecode(const std::string& text, std::string& bytes);
 }
@@ -20,6 +20,8 @@ namespace throwError {
 	void throwNotTerminatedBySemicolonError(const std::string& filename, int line_number, 
 		const std::string& directive);
 	void throwNoServerError(const std::string& filename);
+	void throwMissingDirectiveError(const std::string& filename, 
+		const std::string& directive, const std::string& required_by);
 
 	// Ports/addresses config errors
 
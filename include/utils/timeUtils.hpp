@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <ctime>
+
+/**
+ * @brief Coarse cached clock: refreshed once per event-loop iteration, so
+ * sessions, headers and logs share one time source instead of calling
+ * time() and strftime() per request.
+ */
+namespace timeUtils {
+	// Cached clock
+
+	void updateClock();
+	void advanceClock(time_t seconds);
+	time_t now();
+	long nowMs();
+	const std::string& httpDate();
+	const std::string& logTimestamp();
+
+	// Formatting
+
+	std::string formatHttpDate(time_t timestamp);
+	bool parseHttpDate(const std::string& date, time_t& out);
+}
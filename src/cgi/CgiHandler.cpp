@@ -3,17 +3,51 @@
 
 // Other includes
 #include "stringUtils.hpp"
-#include <unistd.h> // pipe, fork, dup2, execve, close, read, write
+#include <unistd.h> // pipe, close, read, write
 #include <sys/types.h> // pid_t
 #include <sys/wait.h> // waitpid
+#include <signal.h> // kill
 #include "fileUtils.hpp"
 #include "constants.hpp"
+#include "timeUtils.hpp"
+#include "fastcgi.hpp"
+#include "cgiSpawner.hpp"
+#include "errorResponses.hpp"
+#include <cctype> // tolower
+#include <cstdlib> // atoi
+#include <fcntl.h> // fcntl
+#include <sys/syscall.h> // SYS_pidfd_open, SYS_pidfd_send_signal
+#include <sys/socket.h> // getsockopt
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_INFO
 
 CgiHandler::CgiHandler(const std::string& script_path, 
 const std::string& cgi_bin, const HttpRequest& httpRequest, 
-const ServerConfig& serverConfig, const std::string& path_info) :
-	script_path(script_path), path_info(path_info), cgi_bin(cgi_bin)
+const ServerConfig& serverConfig, const LocationConfig* locationConfig, 
+const std::string& path_info) :
+	script_path(script_path), path_info(path_info), cgi_bin(cgi_bin),
+	pid(-1),
+	exit_fd(-1),
+	own_child(false),
+	input_fd(-1),
+	output_fd(-1),
+	input_offset(0),
+	headers_taken(false),
+	deadline_ms(0),
+	end_ms(0),
+	nph(false),
+	client_fd(-1),
+	ended(false),
+	httpRequest(httpRequest),
+	serverConfig(&serverConfig),
+	locationConfig(locationConfig)
 {
+	if (locationConfig) {
+		fastcgi_pass = locationConfig->getFastcgiPass();
+	}
+	// A FastCGI backend only ever answers through its connection
+	nph = fastcgi_pass.empty() && ((locationConfig && locationConfig->isCgiNphOn()) 
+		|| fileUtils::extractFilename(script_path).compare(0, 4, "nph-") == 0);
 	method = httpRequest.getMethod();
 	body = httpRequest.getBody();
 	query_string = httpRequest.getQueryString();
@@ -40,8 +74,29 @@ CgiHandler::CgiHandler(const CgiHandler& other) :
 	content_length(other.content_length),
 	headers(other.headers),
 	env(other.env),
-	envp(other.envp)
-{}
+	pid(other.pid),
+	exit_fd(other.exit_fd),
+	own_child(other.own_child),
+	input_fd(other.input_fd),
+	output_fd(other.output_fd),
+	input(other.input),
+	input_offset(other.input_offset),
+	output(other.output),
+	headers_taken(other.headers_taken),
+	deadline_ms(other.deadline_ms),
+	end_ms(other.end_ms),
+	nph(other.nph),
+	client_fd(other.client_fd),
+	fastcgi_pass(other.fastcgi_pass),
+	records(other.records),
+	ended(other.ended),
+	httpRequest(other.httpRequest),
+	serverConfig(other.serverConfig),
+	locationConfig(other.locationConfig),
+	cache_key(other.cache_key)
+{
+	setupEnvp();
+}
 
 CgiHandler& CgiHandler::operator=(const CgiHandler& other) {
 	if (this != &other) {
@@ -58,7 +113,27 @@ CgiHandler& CgiHandler::operator=(const CgiHandler& other) {
 		content_length = other.content_length;
 		headers = other.headers;
 		env = other.env;
-		envp = other.envp;
+		pid = other.pid;
+		exit_fd = other.exit_fd;
+		own_child = other.own_child;
+		input_fd = other.input_fd;
+		output_fd = other.output_fd;
+		input = other.input;
+		input_offset = other.input_offset;
+		output = other.output;
+		headers_taken = other.headers_taken;
+		deadline_ms = other.deadline_ms;
+		end_ms = other.end_ms;
+		nph = other.nph;
+		client_fd = other.client_fd;
+		fastcgi_pass = other.fastcgi_pass;
+		records = other.records;
+		ended = other.ended;
+		httpRequest = other.httpRequest;
+		serverConfig = other.serverConfig;
+		locationConfig = other.locationConfig;
+		cache_key = other.cache_key;
+		setupEnvp();
 	}
 	return *this;
 }
@@ -70,7 +145,11 @@ CgiHandler::~CgiHandler() {}
 std::string CgiHandler::toString() const {
 	std::ostringstream oss;
 
-	oss << "CgiHandler instance";
+	oss << "CgiHandler instance" << std::endl;
+	oss << "script_path: " << script_path << ", pid: " << pid 
+		<< ", input_fd: " << input_fd << ", output_fd: " << output_fd << std::endl;
+	oss << "fastcgi_pass: " << fastcgi_pass << ", nph: " << (nph ? "on" : "off") 
+		<< std::endl;
 	return oss.str();
 }
 
@@ -105,7 +184,11 @@ void CgiHandler::setupEnvironment(const ServerConfig& serverConfig) {
 			env.push_back("HTTP_" + key + "=" + val);
 		}
 	}
-	// Convert in char* array
+	setupEnvp();
+}
+
+// envp points into env, so it is rebuilt whenever env is copied
+void CgiHandler::setupEnvp() {
 	envp.clear();
 	for (size_t i = 0; i < env.size(); ++i) {
 		envp.push_back(const_cast<char*>(env[i].c_str()));
@@ -122,108 +205,380 @@ std::vector<char*> CgiHandler::buildArgs() const {
 	return args;
 }
 
-std::string CgiHandler::extractCgiContentType(const std::string& cgi_output, 
-std::string& body_out) {
-	size_t header_end = cgi_output.find("\r\n\r\n");
-	if (header_end == std::string::npos) {
-		header_end = cgi_output.find("\n\n");
-	}
-	std::string headers;
-	std::string body;
-	if (header_end != std::string::npos) {
-		headers = cgi_output.substr(0, header_end);
-		body = cgi_output.substr(header_end + ((cgi_output[header_end] == '\r') ? 4 : 2));
-	} else {
-		body = cgi_output;
+// Where the header block ends (earliest blank line, LF or CRLF), npos while
+// it is still incomplete
+size_t CgiHandler::findHeaderEnd(size_t& body_start) const {
+	size_t crlf = output.find("\r\n\r\n");
+	size_t lf = output.find("\n\n");
+	if (crlf != std::string::npos && (lf == std::string::npos || crlf < lf)) {
+		body_start = crlf + 4;
+		return crlf;
 	}
-	std::string content_type = "text/html";
-	std::istringstream iss(headers);
-	std::string line;
-	while (std::getline(iss, line)) {
-		if (line.find("Content-Type:") == 0) {
-			content_type = line.substr(13);
-			size_t start = content_type.find_first_not_of(" \t");
-			size_t end = content_type.find_last_not_of(" \t\r");
-			if (start != std::string::npos && end != std::string::npos) {
-				content_type = content_type.substr(start, end - start + 1);
-			}
-			break;
-		}
+	body_start = lf + 2;
+	return lf;
+}
+
+// Getters
+
+pid_t CgiHandler::getPid() const {
+	return pid;
+}
+
+int CgiHandler::getInputFd() const {
+	return input_fd;
+}
+
+int CgiHandler::getOutputFd() const {
+	return output_fd;
+}
+
+const std::string& CgiHandler::getScriptPath() const {
+	return script_path;
+}
+
+const HttpRequest& CgiHandler::getHttpRequest() const {
+	return httpRequest;
+}
+
+const ServerConfig& CgiHandler::getServerConfig() const {
+	return *serverConfig;
+}
+
+const LocationConfig* CgiHandler::getLocationConfig() const {
+	return locationConfig;
+}
+
+const std::string& CgiHandler::getCacheKey() const {
+	return cache_key;
+}
+
+long CgiHandler::getDeadlineMs() const {
+	return deadline_ms;
+}
+
+bool CgiHandler::hasTimedOut(long now_ms) const {
+	return now_ms >= deadline_ms;
+}
+
+bool CgiHandler::isStarted() const {
+	return deadline_ms != 0;
+}
+
+bool CgiHandler::isFastCgi() const {
+	return !fastcgi_pass.empty();
+}
+
+bool CgiHandler::isNph() const {
+	return nph;
+}
+
+// An NPH script is only seen through its socket: data sent within the 
+// timeout counts as activity, like output of a streamed script
+bool CgiHandler::isClientReceiving() const {
+	tcp_info info;
+	socklen_t size = sizeof(info);
+	if (getsockopt(client_fd, IPPROTO_TCP, TCP_INFO, &info, &size) < 0) {
+		return false;
 	}
-	body_out = body;
-	return content_type;
+	return info.tcpi_last_data_sent < TIMEOUT_SECONDS * 1000U;
+}
+
+bool CgiHandler::hasHeaders() const {
+	size_t body_start;
+	return headers_taken || findHeaderEnd(body_start) != std::string::npos;
+}
+
+// Setters
+
+void CgiHandler::setCacheKey(const std::string& cache_key) {
+	this->cache_key = cache_key;
 }
 
 // Core functionality
 
-bool CgiHandler::execute(HttpResponse& httpResponse) {
+// Launches the script and returns at once; the pipes are then driven by poll.
+// client_fd is only handed over to NPH scripts
+bool CgiHandler::start(int client_fd) {
+	this->client_fd = client_fd;
+	input_offset = 0;
+	end_ms = timeUtils::nowMs() + CGI_MAX_RUN_SECONDS * 1000L;
+	markActivity();
+	if (isFastCgi()) {
+		return startFastCgi();
+	}
+	return startScript();
+}
+
+bool CgiHandler::startScript() {
 	int in_pipe[2];
 	int out_pipe[2];
 	if (pipe(in_pipe) < 0) {
 		return false;
 	}
-	if (pipe(out_pipe) < 0) {
+	if (nph) {
+		// The script writes straight to the client, and expects to block
+		out_pipe[0] = -1;
+		out_pipe[1] = client_fd;
+		fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL, 0) & ~O_NONBLOCK);
+	} else if (pipe(out_pipe) < 0) {
 		close(in_pipe[0]);
 		close(in_pipe[1]);
 		return false;
 	}
-	pid_t pid = fork();
-	if (pid < 0) {
-		return false;
+	// No script may inherit another one's pipes (or its own write end)
+	int pipe_fds[4] = { in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1] };
+	for (size_t i = 0; i < 4; ++i) {
+		if (pipe_fds[i] >= 0 && pipe_fds[i] != client_fd) {
+			fcntl(pipe_fds[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+	std::vector<char*> args;
+	std::string script_filename = "./" + fileUtils::extractFilename(script_path);
+	args.push_back(const_cast<char*>(script_filename.c_str()));
+	args.push_back(const_cast<char*>(cgi_bin.c_str()));
+	args.push_back(NULL);
+	CgiLimits limits;
+	limits.cpu_seconds = locationConfig ? locationConfig->getCgiRlimitCpu() : 0;
+	limits.address_space = locationConfig ? locationConfig->getCgiRlimitAs() : 0;
+	limits.open_files = locationConfig ? locationConfig->getCgiRlimitNofile() : 0;
+	limits.nice = locationConfig ? locationConfig->getCgiNice() : 0;
+	limits.cgroup = locationConfig ? locationConfig->getCgiCgroup() : "";
+	pid = cgiSpawner::spawn(fileUtils::extractDirectory(script_path), args.data(), 
+		envp.data(), limits, in_pipe[0], out_pipe[1]);
+	own_child = !cgiSpawner::hasHelper();
+	close(in_pipe[0]);
+	if (nph && pid < 0) {
+		// The error response goes out through the event loop again
+		fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL, 0) | O_NONBLOCK);
+	} else if (!nph) {
+		close(out_pipe[1]);
 	}
-	if (pid == 0) {
-		dup2(in_pipe[0], STDIN_FILENO);
-		dup2(out_pipe[1], STDOUT_FILENO);
+	if (pid < 0) {
 		close(in_pipe[1]);
-		close(out_pipe[0]);
-		std::string script_dir = fileUtils::extractDirectory(script_path);
-		if (chdir(script_dir.c_str()) != 0) {
-			_exit(1);
+		if (!nph) {
+			close(out_pipe[0]);
 		}
-		//build args in same scope because we lost in buildargs fonction the first value of array 
-		std::vector<char*> args;
-		std::string script_filename = "./" + fileUtils::extractFilename(script_path);
-		args.push_back(const_cast<char*>(script_filename.c_str()));
-		args.push_back(const_cast<char*>(cgi_bin.c_str()));
-		args.push_back(NULL);
-		std::cout << args[0] << std::endl;
-		execve(args[0], args.data(), envp.data());
-		_exit(1);
+		return false;
+	}
+	input_fd = in_pipe[1];
+	exit_fd = watchExit();
+	if (nph) {
+		output_fd = (exit_fd >= 0) ? fcntl(exit_fd, F_DUPFD_CLOEXEC, 0) : -1;
 	} else {
-		close(in_pipe[0]);
-		close(out_pipe[1]);
-		if (method == "POST" && !body.empty()) {
-			write(in_pipe[1], body.c_str(), body.size());
+		output_fd = out_pipe[0];
+	}
+	input = body;
+	if (method != "POST" || body.empty()) {
+		closeInput(); // EOF for CGI
+	}
+	return true;
+}
+
+// A pidfd works for scripts the spawner helper launched too, though they are 
+// not our children. -1 when the kernel has none, or the script is already gone
+int CgiHandler::watchExit() const {
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	return -1;
+#endif
+}
+
+// The whole request is serialized up front and written as the socket allows.
+// Polling the same connection for writing and reading goes through a dup, so
+// the event loop sees the usual stdin/stdout pair
+bool CgiHandler::startFastCgi() {
+	int fd = fastcgi::acquireConnection(fastcgi_pass);
+	if (fd < 0) {
+		return false;
+	}
+	input_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (input_fd < 0) {
+		close(fd);
+		return false;
+	}
+	output_fd = fd;
+	input = fastcgi::buildRequest(env, method == "POST" ? body : "");
+	records.clear();
+	ended = false;
+	return true;
+}
+
+// One write per POLLOUT on the script stdin; false once nothing is left to 
+// send. The caller closes the pipe, after taking it out of the poller
+bool CgiHandler::writeInput() {
+	if (input_fd < 0) {
+		return false;
+	}
+	ssize_t bytes_written = write(input_fd, input.c_str() + input_offset, 
+		input.size() - input_offset);
+	if (bytes_written <= 0) {
+		return false;
+	}
+	input_offset += bytes_written;
+	return input_offset < input.size();
+}
+
+// One read per POLLIN on the script stdout; false at EOF, or once the 
+// FastCGI backend ended the request (the connection itself stays open)
+bool CgiHandler::readOutput() {
+	if (output_fd < 0) {
+		return false;
+	}
+	char buffer[CLIENT_READ_REQUEST_BUFFER_SIZE];
+	ssize_t bytes_read = read(output_fd, buffer, sizeof(buffer));
+	if (bytes_read <= 0) {
+		return false;
+	}
+	if (!isFastCgi()) {
+		output.append(buffer, bytes_read);
+		return true;
+	}
+	records.append(buffer, bytes_read);
+	if (!fastcgi::parseRecords(records, output, ended)) {
+		return false;
+	}
+	return !ended;
+}
+
+void CgiHandler::closeInput() {
+	if (input_fd >= 0) {
+		close(input_fd);
+		input_fd = -1;
+	}
+}
+
+// A backend connection goes back to the pool only when it sits cleanly 
+// between two requests: everything sent, and nothing unread after the end
+void CgiHandler::closeOutput() {
+	if (output_fd < 0) {
+		return;
+	}
+	if (isFastCgi() && ended && records.empty() && input_offset == input.size()) {
+		fastcgi::releaseConnection(fastcgi_pass, output_fd);
+	} else {
+		close(output_fd);
+	}
+	output_fd = -1;
+}
+
+// Through the pidfd, which cannot reach a process that reused the pid. 
+// Without one, only our own child is signalled by pid: until it is 
+// reaped, its pid stays its own. A helper script with no pidfd has exited
+void CgiHandler::abort() {
+	closeInput();
+	closeOutput();
+	if (exit_fd >= 0) {
+#ifdef SYS_pidfd_send_signal
+		syscall(SYS_pidfd_send_signal, exit_fd, SIGKILL, NULL, 0);
+#endif
+	} else if (own_child && pid > 0) {
+		kill(pid, SIGKILL);
+	}
+}
+
+// Never blocks: a child that has not exited yet is left for a later call.
+// Scripts launched by the spawner helper are reaped by the kernel; there is
+// only their pidfd to close
+bool CgiHandler::reap() {
+	if (exit_fd >= 0) {
+		close(exit_fd);
+		exit_fd = -1;
+	}
+	if (pid <= 0) {
+		return true;
+	}
+	if (own_child && waitpid(pid, NULL, WNOHANG) == 0) {
+		return false;
+	}
+	pid = -1;
+	return true;
+}
+
+// A stream that keeps producing output is not timed out, until it has run 
+// for CGI_MAX_RUN_SECONDS in all
+void CgiHandler::markActivity() {
+	deadline_ms = timeUtils::nowMs() + TIMEOUT_SECONDS * 1000L;
+	if (deadline_ms > end_ms) {
+		deadline_ms = end_ms;
+	}
+}
+
+// Script headers (RFC 3875 section 6.3) merged into the response: Status 
+// sets the status line, Location alone means 302, Set-Cookie may repeat.
+// Framing and connection headers stay ours; Content-Length is left to the 
+// caller, which knows whether the body goes out untouched
+void CgiHandler::applyHeaders(HttpResponse& httpResponse) const {
+	size_t body_start;
+	size_t header_end = findHeaderEnd(body_start);
+	if (header_end == std::string::npos) {
+		return;
+	}
+	std::istringstream iss(output.substr(0, header_end));
+	std::string line;
+	bool has_status = false;
+	while (std::getline(iss, line)) {
+		size_t colon = line.find(':');
+		if (colon == std::string::npos || colon == 0) {
+			continue;
+		}
+		std::string name = stringUtils::trim(line.substr(0, colon));
+		std::string value = stringUtils::trim(line.substr(colon + 1));
+		std::string lower = name;
+		for (size_t i = 0; i < lower.size(); ++i) {
+			lower[i] = static_cast<char>(std::tolower(lower[i]));
 		}
-		close(in_pipe[1]); // EOF for CGI
-		time_t start_time = time(NULL);
-		char buffer[4096];
-		std::string cgi_output;
-		ssize_t bytes_read;
-		while (true) {
-			if (time(NULL) - start_time > TIMEOUT_SECONDS) {
-				kill(pid, SIGKILL);
-				close(out_pipe[0]);
-				waitpid(pid, NULL, 0);
-				httpResponse.buildError(504, "CGI Script Timeout");
-				return false;
+		if (lower == "status") {
+			int code = std::atoi(value.c_str());
+			if (code >= 200 && code <= 599) {
+				std::string reason = value.size() > 3 ? stringUtils::trim(value.substr(3)) : "";
+				httpResponse.setStatusCode(code);
+				httpResponse.setReasonPhrase(reason.empty() 
+					? errorResponses::getReasonPhrase(code) : reason);
+				has_status = true;
 			}
-			bytes_read = read(out_pipe[0], buffer, sizeof(buffer));
-			if (bytes_read > 0) {
-				cgi_output.append(buffer, bytes_read);
-			} else if (bytes_read == 0) {
-				break;
-			} else {
-				usleep(50000);
+		} else if (lower == "content-type") {
+			httpResponse.setHeader("Content-Type", value);
+		} else if (lower == "content-length") {
+			httpResponse.setHeader("Content-Length", value);
+		} else if (lower == "location") {
+			httpResponse.setHeader("Location", value);
+			if (!has_status) {
+				httpResponse.setStatusCode(302);
+				httpResponse.setReasonPhrase("Found");
 			}
+		} else if (lower == "set-cookie") {
+			httpResponse.addSetCookie(value);
+		} else if (lower != "connection" && lower != "keep-alive" 
+		&& lower != "transfer-encoding" && lower != "date") {
+			httpResponse.setHeader(name, value);
 		}
-		// When read() return 0, it's EOF, end of loop
-		close(out_pipe[0]);
-		waitpid(pid, NULL, 0);
-		std::string cgi_body;
-		std::string content_type = extractCgiContentType(cgi_output, cgi_body);
-		httpResponse.buildOk(cgi_body, content_type);
-		return true;
 	}
-	return false;
+}
+
+// Body bytes read so far (without the header block), handed over once
+std::string CgiHandler::takeBody() {
+	if (!headers_taken) {
+		size_t body_start;
+		if (findHeaderEnd(body_start) != std::string::npos) {
+			output.erase(0, body_start);
+		}
+		headers_taken = true;
+	}
+	std::string body;
+	body.swap(output);
+	return body;
+}
+
+// Whole output at once; without a header block all of it is the body
+bool CgiHandler::buildResponse(HttpResponse& httpResponse) {
+	if (output.empty()) {
+		return false;
+	}
+	httpResponse.buildOk("", "text/html");
+	applyHeaders(httpResponse);
+	// The body may still be compressed: its length is ours to announce
+	httpResponse.removeHeader("Content-Length");
+	httpResponse.setBody(takeBody());
+	return true;
 }
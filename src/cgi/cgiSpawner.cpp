@@ -0,0 +1,336 @@
+#include "cgiSpawner.hpp"
+
+// Other includes
+#include <vector>
+#include <sstream>
+#include <cstring> // memset, memcpy
+#include <unistd.h> // vfork, execve, dup2, chdir, read, write, close
+#include <fcntl.h> // fcntl, open
+#include <signal.h> // signal, kill, sigprocmask
+#include <sys/wait.h> // waitpid
+#include <stdint.h> // uint32_t
+#include <sys/socket.h> // socketpair, sendmsg, recvmsg
+#include <sys/resource.h> // setrlimit, setpriority
+#include <sys/syscall.h> // SYS_pidfd_open
+
+namespace cgiSpawner {
+
+	// Server side of the socket to the helper, -1 when there is no helper
+	static int& channel() {
+		static int fd = -1;
+		return fd;
+	}
+
+	static pid_t& helper() {
+		static pid_t pid = -1;
+		return pid;
+	}
+
+	static bool writeAll(int fd, const char* data, size_t size) {
+		while (size > 0) {
+			ssize_t written = write(fd, data, size);
+			if (written <= 0) {
+				return false;
+			}
+			data += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	static bool readAll(int fd, char* data, size_t size) {
+		while (size > 0) {
+			ssize_t bytes_read = read(fd, data, size);
+			if (bytes_read <= 0) {
+				return false;
+			}
+			data += bytes_read;
+			size -= bytes_read;
+		}
+		return true;
+	}
+
+	// Launch request: the two pipe ends ride along the length prefix, then
+	// comes "dir\0cgroup\0limits\0argv...\0\0envp...\0"
+
+	static bool sendRequest(int sock, const std::string& payload, int stdin_fd,
+	int stdout_fd) {
+		uint32_t length = payload.size();
+		int fds[2] = { stdin_fd, stdout_fd };
+		char control[CMSG_SPACE(sizeof(fds))];
+		std::memset(control, 0, sizeof(control));
+		iovec iov;
+		iov.iov_base = &length;
+		iov.iov_len = sizeof(length);
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+		std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+		if (sendmsg(sock, &msg, 0) != static_cast<ssize_t>(sizeof(length))) {
+			return false;
+		}
+		return writeAll(sock, payload.data(), payload.size());
+	}
+
+	static bool receiveRequest(int sock, std::string& payload, int fds[2]) {
+		uint32_t length = 0;
+		char control[CMSG_SPACE(sizeof(int) * 2)];
+		iovec iov;
+		iov.iov_base = &length;
+		iov.iov_len = sizeof(length);
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(length))) {
+			return false;
+		}
+		cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS
+		|| cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 2)) {
+			return false;
+		}
+		std::memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+		payload.resize(length);
+		if (length > 0 && !readAll(sock, &payload[0], length)) {
+			close(fds[0]);
+			close(fds[1]);
+			return false;
+		}
+		return true;
+	}
+
+	static void splitPayload(std::string& payload, CgiLimits& limits,
+	std::vector<char*>& argv, std::vector<char*>& envp) {
+		std::vector<char*>* current = &argv;
+		size_t cgroup = payload.find('\0') + 1;
+		size_t numbers = payload.find('\0', cgroup) + 1;
+		size_t pos = payload.find('\0', numbers) + 1;
+		if (cgroup == 0 || numbers == 0 || pos == 0) {
+			pos = payload.size();
+		} else {
+			limits.cgroup = payload.substr(cgroup, numbers - cgroup - 1);
+			std::istringstream iss(payload.substr(numbers, pos - numbers - 1));
+			iss >> limits.cpu_seconds >> limits.address_space >> limits.open_files 
+				>> limits.nice;
+		}
+		while (pos < payload.size()) {
+			size_t end = payload.find('\0', pos);
+			if (end == pos && current == &argv) {
+				current = &envp;
+			} else {
+				current->push_back(&payload[pos]);
+			}
+			pos = end + 1;
+		}
+		argv.push_back(NULL);
+		envp.push_back(NULL);
+	}
+
+	// The helper itself: one launch per request, until the server goes away
+	static void serve(int sock) {
+		signal(SIGINT, SIG_IGN);
+		signal(SIGHUP, SIG_IGN); // Reloads are the server's business
+		signal(SIGCHLD, SIG_IGN); // Scripts are reaped by the kernel
+		std::string payload;
+		int fds[2];
+		while (receiveRequest(sock, payload, fds)) {
+			CgiLimits limits = CgiLimits();
+			std::vector<char*> argv;
+			std::vector<char*> envp;
+			splitPayload(payload, limits, argv, envp);
+			pid_t pid = -1;
+			if (argv.size() > 1) {
+				pid = spawnLocal(payload.c_str(), argv.data(), envp.data(), limits, 
+					fds[0], fds[1]);
+			}
+			close(fds[0]);
+			close(fds[1]);
+			if (!writeAll(sock, reinterpret_cast<char*>(&pid), sizeof(pid))) {
+				break;
+			}
+		}
+	}
+
+	// Scripts the helper launches are not ours to waitpid: their pid may be
+	// reused as soon as they exit, so only a pidfd may signal them
+	static bool hasPidfd() {
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
+		int fd = syscall(SYS_pidfd_open, getpid(), 0);
+		if (fd < 0) {
+			return false;
+		}
+		close(fd);
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool start() {
+		if (!hasPidfd()) {
+			return false;
+		}
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+			return false;
+		}
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		pid_t pid = fork();
+		if (pid < 0) {
+			close(fds[0]);
+			close(fds[1]);
+			return false;
+		}
+		if (pid == 0) {
+			close(fds[0]);
+			serve(fds[1]);
+			_exit(0);
+		}
+		close(fds[1]);
+		channel() = fds[0];
+		helper() = pid;
+		return true;
+	}
+
+	// Scripts the helper launched keep running, re-parented to init
+	void stop() {
+		if (channel() < 0) {
+			return;
+		}
+		close(channel());
+		channel() = -1;
+		kill(helper(), SIGKILL);
+		waitpid(helper(), NULL, 0);
+		helper() = -1;
+	}
+
+	// Whether spawn() goes through the helper; it stops being so for good 
+	// once the helper dies
+	bool hasHelper() {
+		return channel() >= 0;
+	}
+
+	pid_t spawn(const std::string& dir, char* const argv[], char* const envp[],
+	const CgiLimits& limits, int stdin_fd, int stdout_fd) {
+		if (channel() < 0) {
+			return spawnLocal(dir, argv, envp, limits, stdin_fd, stdout_fd);
+		}
+		std::ostringstream numbers;
+		numbers << limits.cpu_seconds << ' ' << limits.address_space << ' ' 
+			<< limits.open_files << ' ' << limits.nice;
+		std::string payload = dir;
+		payload += '\0';
+		payload += limits.cgroup;
+		payload += '\0';
+		payload += numbers.str();
+		payload += '\0';
+		for (size_t i = 0; argv[i]; ++i) {
+			payload += argv[i];
+			payload += '\0';
+		}
+		payload += '\0';
+		for (size_t i = 0; envp[i]; ++i) {
+			payload += envp[i];
+			payload += '\0';
+		}
+		pid_t pid = -1;
+		if (!sendRequest(channel(), payload, stdin_fd, stdout_fd)
+		|| !readAll(channel(), reinterpret_cast<char*>(&pid), sizeof(pid))) {
+			// The helper died: launch from here from now on
+			stop();
+			return spawnLocal(dir, argv, envp, limits, stdin_fd, stdout_fd);
+		}
+		return pid;
+	}
+
+	// A soft limit under the current hard one; the hard one follows at
+	// value + hard_margin, so the script may get the soft signal first
+	static bool setLimit(int resource, long value, long hard_margin) {
+		if (value <= 0) {
+			return true;
+		}
+		rlimit limit;
+		if (getrlimit(resource, &limit) < 0) {
+			return false;
+		}
+		rlim_t hard = value + hard_margin;
+		if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < hard) {
+			hard = limit.rlim_max;
+		}
+		limit.rlim_max = hard;
+		limit.rlim_cur = static_cast<rlim_t>(value) < hard ? value : hard;
+		return setrlimit(resource, &limit) == 0;
+	}
+
+	// Runs in the vfork child. A limit that cannot be applied fails the 
+	// launch rather than letting the script run unbounded
+	static bool applyLimits(const CgiLimits& limits, const char* procs_path) {
+		if (procs_path[0]) {
+			// Writing "0" moves the writing process itself
+			int fd = open(procs_path, O_WRONLY | O_CLOEXEC);
+			if (fd < 0) {
+				return false;
+			}
+			bool moved = write(fd, "0", 1) == 1;
+			close(fd);
+			if (!moved) {
+				return false;
+			}
+		}
+		if (limits.nice != 0 && setpriority(PRIO_PROCESS, 0, limits.nice) < 0) {
+			return false;
+		}
+		return setLimit(RLIMIT_CPU, limits.cpu_seconds, 1)
+			&& setLimit(RLIMIT_AS, limits.address_space, 0)
+			&& setLimit(RLIMIT_NOFILE, limits.open_files, 0);
+	}
+
+	// Ignored signals survive execve: the script gets the default back for 
+	// those the server or the helper ignore. The vfork child has its own
+	// table of actions, so the caller's is left alone
+	static bool resetSignals() {
+		const int ignored[] = { SIGHUP, SIGINT, SIGQUIT, SIGPIPE, SIGCHLD };
+		for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); ++i) {
+			if (signal(ignored[i], SIG_DFL) == SIG_ERR) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// vfork shares the address space until execve, so no page table is copied
+	// however large the process is. The child only makes system calls; it
+	// drops the SIGCHLD block the server keeps for its signalfd
+	pid_t spawnLocal(const std::string& dir, char* const argv[], char* const envp[],
+	const CgiLimits& limits, int stdin_fd, int stdout_fd) {
+		const char* dir_path = dir.c_str();
+		std::string procs = limits.cgroup.empty() ? "" : limits.cgroup + "/cgroup.procs";
+		const char* procs_path = procs.c_str();
+		sigset_t no_signals;
+		sigemptyset(&no_signals);
+		pid_t pid = vfork();
+		if (pid == 0) {
+			if (!resetSignals() || sigprocmask(SIG_SETMASK, &no_signals, NULL) < 0
+			|| !applyLimits(limits, procs_path)
+			|| dup2(stdin_fd, STDIN_FILENO) < 0 || dup2(stdout_fd, STDOUT_FILENO) < 0
+			|| chdir(dir_path) != 0) {
+				_exit(1);
+			}
+			execve(argv[0], argv, envp);
+			_exit(1);
+		}
+		return pid;
+	}
+
+}
@@ -0,0 +1,236 @@
+#include "fastcgi.hpp"
+
+// Other includes
+#include <map>
+#include <algorithm> // min
+#include <cerrno> // EINPROGRESS
+#include <cstring> // memset, strncpy
+#include <cstdlib> // atoi
+#include <unistd.h> // close
+#include <fcntl.h> // fcntl
+#include <sys/socket.h> // socket, connect, recv
+#include <sys/un.h> // sockaddr_un
+#include <arpa/inet.h> // inet_addr, htons
+#include "constants.hpp"
+#include "stringUtils.hpp"
+
+namespace fastcgi {
+
+	// Protocol values from the FastCGI 1.0 specification
+	enum {
+		VERSION_1 = 1,
+		BEGIN_REQUEST = 1,
+		END_REQUEST = 3,
+		PARAMS = 4,
+		STDIN = 5,
+		STDOUT = 6,
+		RESPONDER = 1,
+		KEEP_CONN = 1,
+		HEADER_SIZE = 8,
+		MAX_CONTENT = 65535
+	};
+
+	// One request at a time per connection, so every request is id 1
+	static const int REQUEST_ID = 1;
+
+	static std::map<std::string, std::vector<int> >& idle() {
+		static std::map<std::string, std::vector<int> > connections;
+		return connections;
+	}
+
+	// Records
+
+	static void appendRecord(std::string& out, int type, const char* data, size_t size) {
+		size_t padding = (8 - size % 8) % 8;
+		out += static_cast<char>(VERSION_1);
+		out += static_cast<char>(type);
+		out += static_cast<char>((REQUEST_ID >> 8) & 0xff);
+		out += static_cast<char>(REQUEST_ID & 0xff);
+		out += static_cast<char>((size >> 8) & 0xff);
+		out += static_cast<char>(size & 0xff);
+		out += static_cast<char>(padding);
+		out += '\0';
+		out.append(data, size);
+		out.append(padding, '\0');
+	}
+
+	// A stream is split in records of at most 64 KiB, then closed by an empty one
+	static void appendStream(std::string& out, int type, const std::string& data) {
+		for (size_t offset = 0; offset < data.size(); offset += MAX_CONTENT) {
+			size_t size = std::min(data.size() - offset, static_cast<size_t>(MAX_CONTENT));
+			appendRecord(out, type, data.data() + offset, size);
+		}
+		appendRecord(out, type, "", 0);
+	}
+
+	static void appendLength(std::string& out, size_t length) {
+		if (length < 128) {
+			out += static_cast<char>(length);
+			return;
+		}
+		out += static_cast<char>(((length >> 24) & 0x7f) | 0x80);
+		out += static_cast<char>((length >> 16) & 0xff);
+		out += static_cast<char>((length >> 8) & 0xff);
+		out += static_cast<char>(length & 0xff);
+	}
+
+	// The CGI environment ("NAME=value") becomes the PARAMS stream
+	std::string buildRequest(const std::vector<std::string>& env,
+	const std::string& body) {
+		std::string request;
+		const char begin[8] = { 0, RESPONDER, KEEP_CONN, 0, 0, 0, 0, 0 };
+		appendRecord(request, BEGIN_REQUEST, begin, sizeof(begin));
+		std::string params;
+		for (size_t i = 0; i < env.size(); ++i) {
+			size_t equal = env[i].find('=');
+			if (equal == std::string::npos) {
+				continue;
+			}
+			appendLength(params, equal);
+			appendLength(params, env[i].size() - equal - 1);
+			params.append(env[i], 0, equal);
+			params.append(env[i], equal + 1, std::string::npos);
+		}
+		appendStream(request, PARAMS, params);
+		appendStream(request, STDIN, body);
+		return request;
+	}
+
+	// Consumes the complete records at the front of buffer; false when the
+	// backend does not speak FastCGI. STDERR and unknown records are dropped
+	bool parseRecords(std::string& buffer, std::string& stdout_data, bool& ended) {
+		size_t offset = 0;
+		while (!ended && buffer.size() - offset >= HEADER_SIZE) {
+			const unsigned char* header =
+				reinterpret_cast<const unsigned char*>(buffer.data() + offset);
+			if (header[0] != VERSION_1) {
+				return false;
+			}
+			size_t size = (header[4] << 8) | header[5];
+			size_t record_size = HEADER_SIZE + size + header[6];
+			if (buffer.size() - offset < record_size) {
+				break;
+			}
+			if (header[1] == STDOUT) {
+				stdout_data.append(buffer, offset + HEADER_SIZE, size);
+			} else if (header[1] == END_REQUEST) {
+				ended = true;
+			}
+			offset += record_size;
+		}
+		buffer.erase(0, offset);
+		return true;
+	}
+
+	// Connections
+
+	static bool splitHostPort(const std::string& address, std::string& host, int& port) {
+		size_t colon = address.rfind(':');
+		if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+			return false;
+		}
+		std::string port_str = address.substr(colon + 1);
+		if (!stringUtils::isInt(port_str)) {
+			return false;
+		}
+		host = address.substr(0, colon);
+		if (host == "localhost") {
+			host = "127.0.0.1";
+		}
+		port = std::atoi(port_str.c_str());
+		return port > 0 && port <= 65535 && inet_addr(host.c_str()) != INADDR_NONE;
+	}
+
+	bool isValidAddress(const std::string& address) {
+		if (address.compare(0, 5, "unix:") == 0) {
+			std::string path = address.substr(5);
+			return !path.empty() && path.size() < sizeof(((sockaddr_un*)0)->sun_path);
+		}
+		std::string host;
+		int port;
+		return splitHostPort(address, host, port);
+	}
+
+	static int openConnection(const std::string& address) {
+		int fd;
+		int result;
+		if (address.compare(0, 5, "unix:") == 0) {
+			sockaddr_un addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			std::strncpy(addr.sun_path, address.c_str() + 5, sizeof(addr.sun_path) - 1);
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0) {
+				return -1;
+			}
+			fcntl(fd, F_SETFL, O_NONBLOCK);
+			result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+		} else {
+			std::string host;
+			int port;
+			if (!splitHostPort(address, host, port)) {
+				return -1;
+			}
+			sockaddr_in addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(port);
+			addr.sin_addr.s_addr = inet_addr(host.c_str());
+			fd = socket(AF_INET, SOCK_STREAM, 0);
+			if (fd < 0) {
+				return -1;
+			}
+			fcntl(fd, F_SETFL, O_NONBLOCK);
+			result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+		}
+		// A TCP connect finishes in the background; the first write reports it
+		if (result < 0 && errno != EINPROGRESS) {
+			close(fd);
+			return -1;
+		}
+		// Scripts forked later must not inherit backend connections
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		return fd;
+	}
+
+	// An idle connection that turned readable was closed (or spoken on) by
+	// the backend in the meantime and cannot carry a new request
+	static bool isStillIdle(int fd) {
+		char byte;
+		return recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) < 0;
+	}
+
+	int acquireConnection(const std::string& address) {
+		std::vector<int>& connections = idle()[address];
+		while (!connections.empty()) {
+			int fd = connections.back();
+			connections.pop_back();
+			if (isStillIdle(fd)) {
+				return fd;
+			}
+			close(fd);
+		}
+		return openConnection(address);
+	}
+
+	void releaseConnection(const std::string& address, int fd) {
+		std::vector<int>& connections = idle()[address];
+		if (connections.size() >= FASTCGI_MAX_IDLE_CONNECTIONS) {
+			close(fd);
+			return;
+		}
+		connections.push_back(fd);
+	}
+
+	void clear() {
+		std::map<std::string, std::vector<int> >& pool = idle();
+		for (std::map<std::string, std::vector<int> >::iterator it = pool.begin();
+		it != pool.end(); ++it) {
+			for (size_t i = 0; i < it->second.size(); ++i) {
+				close(it->second[i]);
+			}
+		}
+		pool.clear();
+	}
+
+}
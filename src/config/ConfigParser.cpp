@@ -6,17 +6,19 @@
 #include "Server.hpp"
 #include "throwError.hpp"
 #include "serverBlockParser.hpp"
+#include "mainContextParser.hpp"
 
 ConfigParser::ConfigParser() :
 	line_number(0)
 {}
 
-ConfigParser::ConfigParser(const std::string& configFilename, WebServer& webServer) :
+ConfigParser::ConfigParser(const std::string& configFilename, 
+ConfigSnapshot& configSnapshot) :
 	configFilename(configFilename),
 	line_number(0)
 {
 	openFile();
-	parseFile(webServer);
+	parseFile(configSnapshot);
 	closeFile();
 }
 
@@ -113,7 +115,7 @@ void ConfigParser::incrementLineNumber() {
 
 // Parsing
 
-void ConfigParser::parseFile(WebServer& webServer) {
+void ConfigParser::parseFile(ConfigSnapshot& configSnapshot) {
 	line_number = 0;
 	while (std::getline(file, current_line)) {
 		line_number++;
@@ -125,12 +127,9 @@ void ConfigParser::parseFile(WebServer& webServer) {
 		if (current_line == "server {") {
 			Server server;
 			serverBlockParser::parseServerBlock(server.getConfig(), *this);
-			webServer.addServer(server);
+			configSnapshot.addServer(server);
 		} else {
-			std::vector<std::string> tokens = stringUtils::split(current_line, ' ');
-			std::string directive = tokens[0];
-			throwError::throwDirectiveNotAllowedHereError(configFilename, 
-				line_number, directive);
+			mainContextParser::parseMainDirectiveLine(configSnapshot.getSessionConfig(), *this);
 		}
 	}
 }
@@ -0,0 +1,197 @@
+#include "ConfigSnapshot.hpp"
+#include <sstream>
+
+// Other includes
+#include "ConfigParser.hpp"
+#include <set>
+#include <unistd.h> // close
+#include "stringUtils.hpp"
+#include "throwError.hpp"
+#include "errorResponses.hpp"
+
+ConfigSnapshot::ConfigSnapshot() :
+	references(0)
+{}
+
+// Parsed and checked in full before any socket is bound: a bad file throws
+// and leaves previous, and its sockets, as they were
+ConfigSnapshot::ConfigSnapshot(const std::string& configFilename, 
+const ConfigSnapshot* previous) :
+	references(0)
+{
+	ConfigParser parser(configFilename, *this);
+	checkEmptyServers(configFilename);
+	checkListenAddresses(configFilename);
+	checkSessionConfig(configFilename);
+	preloadErrorResponses();
+	initServersSocket(previous);
+	buildVirtualHosts();
+}
+
+// The copy shares the sockets; its VirtualHosts point to its own servers
+ConfigSnapshot::ConfigSnapshot(const ConfigSnapshot& other) :
+	servers(other.servers),
+	sessionConfig(other.sessionConfig),
+	references(0)
+{
+	buildVirtualHosts();
+}
+
+ConfigSnapshot& ConfigSnapshot::operator=(const ConfigSnapshot& other) {
+	if (this != &other) {
+		servers = other.servers;
+		sessionConfig = other.sessionConfig;
+		virtual_hosts.clear();
+		buildVirtualHosts();
+	}
+	return *this;
+}
+
+ConfigSnapshot::~ConfigSnapshot() {}
+
+// Debug
+
+std::string ConfigSnapshot::toString() const {
+	std::ostringstream oss;
+
+	oss << "ConfigSnapshot instance" << std::endl;
+	for (std::vector<Server>::const_iterator it = servers.begin();
+	it != servers.end(); ++it) {
+		oss << *it << std::endl;
+	}
+	oss << sessionConfig;
+	oss << "references: " << references << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const ConfigSnapshot& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Check validity
+
+// Server blocks may share a port, as virtual hosts, if they also share the
+// host; at most one of them is the default_server
+void ConfigSnapshot::checkListenAddresses(const std::string& configFilename) const {
+	std::map<int, const ServerConfig*> first_on_port;
+	std::set<int> default_ports;
+	for (std::vector<Server>::const_iterator it = servers.begin();
+	it != servers.end(); ++it) {
+		const ServerConfig& config = it->getConfig();
+		int port = config.getListen();
+		std::map<int, const ServerConfig*>::iterator first = first_on_port.find(port);
+		if ((first != first_on_port.end() && first->second->getHost() != config.getHost())
+		|| (config.isDefaultServer() && !default_ports.insert(port).second)) {
+			throwError::throwDuplicateListenOptionsError(configFilename, 
+				stringUtils::toString(port));
+		}
+		first_on_port.insert(std::make_pair(port, &config));
+	}
+}
+
+void ConfigSnapshot::checkEmptyServers(const std::string& configFilename) const {
+	if (servers.size() < 1) {
+		throwError::throwNoServerError(configFilename);
+	}
+}
+
+void ConfigSnapshot::checkSessionConfig(const std::string& configFilename) const {
+	if (sessionConfig.getBackend() == "cookie" && sessionConfig.getSecret().empty()) {
+		throwError::throwMissingDirectiveError(configFilename, "session_secret", 
+			"session_backend cookie");
+	}
+}
+
+// Init
+
+void ConfigSnapshot::preloadErrorResponses() {
+	for (size_t i = 0; i < servers.size(); ++i) {
+		errorResponses::preload(servers[i].getConfig());
+	}
+}
+
+// A port listed earlier in this file, or listened on by previous with the 
+// same host, keeps its socket. When a bind fails, the sockets bound here 
+// are closed again before the error goes up. A port moving to another host
+// is bound while previous still holds it, so that reload fails: it takes a
+// restart
+void ConfigSnapshot::initServersSocket(const ConfigSnapshot* previous) {
+	std::vector<int> bound;
+	try {
+		for (size_t i = 0; i < servers.size(); ++i) {
+			const ServerConfig& config = servers[i].getConfig();
+			size_t first = 0;
+			while (servers[first].getConfig().getListen() != config.getListen()) {
+				++first;
+			}
+			const Server* listening = (first < i) ? &servers[first] : NULL;
+			for (size_t j = 0; previous && !listening && j < previous->servers.size(); ++j) {
+				const ServerConfig& old = previous->servers[j].getConfig();
+				if (old.getListen() == config.getListen() && old.getHost() == config.getHost()) {
+					listening = &previous->servers[j];
+				}
+			}
+			if (listening) {
+				servers[i].shareSocket(*listening);
+			} else {
+				servers[i].initSocket();
+				bound.push_back(servers[i].getSocket().getFd());
+			}
+		}
+	} catch (...) {
+		for (size_t i = 0; i < bound.size(); ++i) {
+			close(bound[i]);
+		}
+		throw;
+	}
+}
+
+// Blocks sharing a socket are looked up by Host
+void ConfigSnapshot::buildVirtualHosts() {
+	for (size_t i = 0; i < servers.size(); ++i) {
+		virtual_hosts[servers[i].getSocket().getFd()].add(&servers[i].getConfig());
+	}
+}
+
+// Getters
+
+const std::vector<Server>& ConfigSnapshot::getServers() const {
+	return servers;
+}
+
+SessionConfig& ConfigSnapshot::getSessionConfig() {
+	return sessionConfig;
+}
+
+const SessionConfig& ConfigSnapshot::getSessionConfig() const {
+	return sessionConfig;
+}
+
+const std::map<int, VirtualHosts>& ConfigSnapshot::getVirtualHosts() const {
+	return virtual_hosts;
+}
+
+// NULL when server_fd is not one of its listen sockets
+const VirtualHosts* ConfigSnapshot::findVirtualHosts(int server_fd) const {
+	std::map<int, VirtualHosts>::const_iterator it = virtual_hosts.find(server_fd);
+	return (it != virtual_hosts.end()) ? &it->second : NULL;
+}
+
+bool ConfigSnapshot::isReferenced() const {
+	return references > 0;
+}
+
+// Setters
+
+void ConfigSnapshot::addServer(Server& server) {
+	servers.push_back(server);
+}
+
+void ConfigSnapshot::acquire() {
+	++references;
+}
+
+void ConfigSnapshot::release() {
+	--references;
+}
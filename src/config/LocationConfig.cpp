@@ -4,13 +4,32 @@
 // Other includes
 #include  <algorithm>
 #include "fileUtils.hpp"
+#include "constants.hpp"
+#include "fastcgi.hpp"
+#include <unistd.h> // access
+#include "LocationMatcher.hpp"
 
 LocationConfig::LocationConfig(const std::string& path, size_t server_client_max_body_size) :
 	location(path),
 	autoindex(false),
+	autoindex_format("html"),
 	return_code(0),
 	upload_enable(false),
-	client_max_body_size(server_client_max_body_size)
+	client_max_body_size(server_client_max_body_size),
+	gzip(-1),
+	gzip_min_length(-1),
+	gzip_comp_level(-1),
+	gzip_static(false),
+	response_cache(false),
+	response_cache_valid(RESPONSE_CACHE_DEFAULT_TTL),
+	cgi_max_processes(CGI_DEFAULT_MAX_PROCESSES),
+	cgi_queue_size(CGI_DEFAULT_QUEUE_SIZE),
+	cgi_rlimit_cpu(0),
+	cgi_rlimit_as(0),
+	cgi_rlimit_nofile(0),
+	cgi_nice(0),
+	cgi_nph(false),
+	session("on")
 {
 	allowed_methods.push_back("GET");
 	allowed_methods.push_back("POST");
@@ -19,35 +38,75 @@ LocationConfig::LocationConfig(const std::string& path, size_t server_client_max
 
 LocationConfig::LocationConfig(const LocationConfig& other) :
 	location(other.location),
+	modifier(other.modifier),
 	root(other.root),
 	index(other.index),
 	autoindex(other.autoindex),
+	autoindex_format(other.autoindex_format),
 	allowed_methods(other.allowed_methods),
 	return_target(other.return_target),
 	return_code(other.return_code),
 	cgi_extension(other.cgi_extension),
 	cgi_path(other.cgi_path),
+	fastcgi_pass(other.fastcgi_pass),
 	upload_store(other.upload_store),
 	upload_enable(other.upload_enable),
 	client_max_body_size(other.client_max_body_size),
-	error_pages(other.error_pages)
+	error_pages(other.error_pages),
+	gzip(other.gzip),
+	gzip_types(other.gzip_types),
+	gzip_min_length(other.gzip_min_length),
+	gzip_comp_level(other.gzip_comp_level),
+	gzip_static(other.gzip_static),
+	error_responses(other.error_responses),
+	response_cache(other.response_cache),
+	response_cache_valid(other.response_cache_valid),
+	cgi_max_processes(other.cgi_max_processes),
+	cgi_queue_size(other.cgi_queue_size),
+	cgi_rlimit_cpu(other.cgi_rlimit_cpu),
+	cgi_rlimit_as(other.cgi_rlimit_as),
+	cgi_rlimit_nofile(other.cgi_rlimit_nofile),
+	cgi_nice(other.cgi_nice),
+	cgi_cgroup(other.cgi_cgroup),
+	cgi_nph(other.cgi_nph),
+	session(other.session)
 {}
 
 LocationConfig& LocationConfig::operator=(const LocationConfig& other) {
 	if (this != &other) {
 		location = other.location;
+		modifier = other.modifier;
 		root = other.root;
 		index = other.index;
 		autoindex = other.autoindex;
+		autoindex_format = other.autoindex_format;
 		allowed_methods = other.allowed_methods;
 		return_target = other.return_target;
 		return_code = other.return_code;
 		cgi_extension = other.cgi_extension;
 		cgi_path = other.cgi_path;
+		fastcgi_pass = other.fastcgi_pass;
 		upload_store = other.upload_store;
 		upload_enable = other.upload_enable;
 		client_max_body_size = other.client_max_body_size;
 		error_pages = other.error_pages;
+		gzip = other.gzip;
+		gzip_types = other.gzip_types;
+		gzip_min_length = other.gzip_min_length;
+		gzip_comp_level = other.gzip_comp_level;
+		gzip_static = other.gzip_static;
+		error_responses = other.error_responses;
+		response_cache = other.response_cache;
+		response_cache_valid = other.response_cache_valid;
+		cgi_max_processes = other.cgi_max_processes;
+		cgi_queue_size = other.cgi_queue_size;
+		cgi_rlimit_cpu = other.cgi_rlimit_cpu;
+		cgi_rlimit_as = other.cgi_rlimit_as;
+		cgi_rlimit_nofile = other.cgi_rlimit_nofile;
+		cgi_nice = other.cgi_nice;
+		cgi_cgroup = other.cgi_cgroup;
+		cgi_nph = other.cgi_nph;
+		session = other.session;
 	}
 	return *this;
 }
@@ -60,10 +119,11 @@ std::string LocationConfig::toString() const {
 	std::ostringstream oss;
 
 	oss << "LocationConfig instance" << std::endl;
-	oss << "location: " << location << std::endl;
+	oss << "location: " << (modifier.empty() ? "" : modifier + " ") << location << std::endl;
 	oss << "root: " << root << std::endl;
 	oss << "index: " << index << std::endl;
 	oss << "autoindex: " << (autoindex ? "true" : "false") << std::endl;
+	oss << "autoindex_format: " << autoindex_format << std::endl;
 	for (std::vector<std::string>::const_iterator it = allowed_methods.begin();
 	it != allowed_methods.end(); ++it) {
 		oss << "allowed_method: " << *it << std::endl;
@@ -72,6 +132,7 @@ std::string LocationConfig::toString() const {
 	oss << "return_code: " << return_code << std::endl;
 	oss << "cgi_extension: " << cgi_extension << std::endl;
 	oss << "cgi_path: " << cgi_path << std::endl;
+	oss << "fastcgi_pass: " << fastcgi_pass << std::endl;
 	oss << "upload_store: " << upload_store << std::endl;
 	oss << "upload_enable: " << (upload_enable ? "true" : "false") << std::endl;
 	oss << "client_max_body_size: " << client_max_body_size << std::endl;
@@ -79,6 +140,25 @@ std::string LocationConfig::toString() const {
 	it != error_pages.end(); ++it) {
 		oss << "error_page: " << it->first << ": " << it->second << std::endl;
 	}
+	oss << "gzip: " << gzip << std::endl;
+	for (std::vector<std::string>::const_iterator it = gzip_types.begin();
+	it != gzip_types.end(); ++it) {
+		oss << "gzip_type: " << *it << std::endl;
+	}
+	oss << "gzip_min_length: " << gzip_min_length << std::endl;
+	oss << "gzip_comp_level: " << gzip_comp_level << std::endl;
+	oss << "gzip_static: " << (gzip_static ? "on" : "off") << std::endl;
+	oss << "response_cache: " << (response_cache ? "on" : "off") << std::endl;
+	oss << "response_cache_valid: " << response_cache_valid << std::endl;
+	oss << "cgi_max_processes: " << cgi_max_processes << std::endl;
+	oss << "cgi_queue_size: " << cgi_queue_size << std::endl;
+	oss << "cgi_rlimit_cpu: " << cgi_rlimit_cpu << std::endl;
+	oss << "cgi_rlimit_as: " << cgi_rlimit_as << std::endl;
+	oss << "cgi_rlimit_nofile: " << cgi_rlimit_nofile << std::endl;
+	oss << "cgi_nice: " << cgi_nice << std::endl;
+	oss << "cgi_cgroup: " << cgi_cgroup << std::endl;
+	oss << "cgi_nph: " << (cgi_nph ? "on" : "off") << std::endl;
+	oss << "session: " << session << std::endl;
 	return oss.str();
 }
 
@@ -93,6 +173,10 @@ const std::string& LocationConfig::getLocation() const {
 	return location;
 }
 
+const std::string& LocationConfig::getModifier() const {
+	return modifier;
+}
+
 const std::string& LocationConfig::getRoot() const {
 	return root;
 }
@@ -101,6 +185,10 @@ const std::string& LocationConfig::getIndex() const {
 	return index;
 }
 
+const std::string& LocationConfig::getAutoindexFormat() const {
+	return autoindex_format;
+}
+
 const std::vector<std::string>& LocationConfig::getAllowedMethods() const {
 	return allowed_methods;
 }
@@ -121,6 +209,10 @@ const std::string& LocationConfig::getCgiPath() const {
 	return cgi_path;
 }
 
+const std::string& LocationConfig::getFastcgiPass() const {
+	return fastcgi_pass;
+}
+
 const std::string& LocationConfig::getUploadStore() const {
 	return upload_store;
 }
@@ -133,6 +225,63 @@ const std::map<int, std::string>& LocationConfig::getErrorPages() const {
 	return error_pages;
 }
 
+int LocationConfig::getGzip() const {
+	return gzip;
+}
+
+const std::vector<std::string>& LocationConfig::getGzipTypes() const {
+	return gzip_types;
+}
+
+int LocationConfig::getGzipMinLength() const {
+	return gzip_min_length;
+}
+
+int LocationConfig::getGzipCompLevel() const {
+	return gzip_comp_level;
+}
+
+int LocationConfig::getResponseCacheValid() const {
+	return response_cache_valid;
+}
+
+int LocationConfig::getCgiMaxProcesses() const {
+	return cgi_max_processes;
+}
+
+int LocationConfig::getCgiQueueSize() const {
+	return cgi_queue_size;
+}
+
+int LocationConfig::getCgiRlimitCpu() const {
+	return cgi_rlimit_cpu;
+}
+
+size_t LocationConfig::getCgiRlimitAs() const {
+	return cgi_rlimit_as;
+}
+
+int LocationConfig::getCgiRlimitNofile() const {
+	return cgi_rlimit_nofile;
+}
+
+int LocationConfig::getCgiNice() const {
+	return cgi_nice;
+}
+
+const std::string& LocationConfig::getCgiCgroup() const {
+	return cgi_cgroup;
+}
+
+const std::string& LocationConfig::getSession() const {
+	return session;
+}
+
+const PrebuiltResponse* LocationConfig::findErrorResponse(int error_code) const {
+	std::map<int, PrebuiltResponse>::const_iterator it = error_responses.find(error_code);
+	return (it != error_responses.end()) ? &it->second : NULL;
+}
+
 bool LocationConfig::isAutoindexOn() const {
 	return autoindex;
 }
@@ -141,9 +290,33 @@ bool LocationConfig::isUploadEnabled() const {
 	return upload_enable;
 }
 
+bool LocationConfig::isGzipStaticOn() const {
+	return gzip_static;
+}
+
+bool LocationConfig::isResponseCacheOn() const {
+	return response_cache;
+}
+
+bool LocationConfig::isCgiNphOn() const {
+	return cgi_nph;
+}
+
+bool LocationConfig::isRegex() const {
+	return modifier == "~" || modifier == "~*";
+}
+
 // Setters && Adders
 
+// A regex location takes any pattern regcomp() accepts
 bool LocationConfig::setLocation(const std::string& location) {
+	if (isRegex()) {
+		if (location.empty() || !LocationMatcher::isValidPattern(location)) {
+			return false;
+		}
+		this->location = location;
+		return true;
+	}
 	if (location[0] != '/') {
 		return false;
 	}
@@ -160,6 +333,15 @@ bool LocationConfig::setLocation(const std::string& location) {
 	return true;
 }
 
+// Set before the location itself, which is checked against it
+bool LocationConfig::setModifier(const std::string& modifier) {
+	if (modifier != "=" && modifier != "^~" && modifier != "~" && modifier != "~*") {
+		return false;
+	}
+	this->modifier = modifier;
+	return true;
+}
+
 bool LocationConfig::setRoot(const std::string& root) {
 	if (root.find("..") != std::string::npos) {
 		return false;
@@ -190,6 +372,14 @@ bool LocationConfig::setAutoindex(bool isAutoindexOn) {
 	return true;
 }
 
+bool LocationConfig::setAutoindexFormat(const std::string& autoindex_format) {
+	if (autoindex_format != "html" && autoindex_format != "json") {
+		return false;
+	}
+	this->autoindex_format = autoindex_format;
+	return true;
+}
+
 bool LocationConfig::setAllowedMethods(const std::vector<std::string>& allowed_methods) {
 	// check if methods are GET, POST, DELETE
 	for (size_t i = 0; i < allowed_methods.size(); ++i) {
@@ -262,6 +452,14 @@ bool LocationConfig::setCgiPath(const std::string& cgi_path) {
 	return true;
 }
 
+bool LocationConfig::setFastcgiPass(const std::string& fastcgi_pass) {
+	if (!fastcgi::isValidAddress(fastcgi_pass)) {
+		return false;
+	}
+	this->fastcgi_pass = fastcgi_pass;
+	return true;
+}
+
 bool LocationConfig::setUploadStore(const std::string& upload_store) {
 	if (upload_store.find("..") != std::string::npos) {
 		return false;
@@ -290,6 +488,142 @@ bool LocationConfig::setClientMaxBodySize(size_t client_max_body_size) {
 	return true;
 }
 
+bool LocationConfig::setGzip(bool isGzipOn) {
+	this->gzip = isGzipOn ? 1 : 0;
+	return true;
+}
+
+bool LocationConfig::setGzipTypes(const std::vector<std::string>& gzip_types) {
+	std::vector<std::string> types(gzip_types);
+	if (!normalizeGzipTypes(types)) {
+		return false;
+	}
+	this->gzip_types.swap(types);
+	return true;
+}
+
+// Shared with ServerConfig: "type/subtype" or "*" only, and text/html is 
+// always compressed, like nginx does
+bool LocationConfig::normalizeGzipTypes(std::vector<std::string>& gzip_types) {
+	for (size_t i = 0; i < gzip_types.size(); ++i) {
+		if (gzip_types[i] != "*" && gzip_types[i].find('/') == std::string::npos) {
+			return false;
+		}
+	}
+	if (std::find(gzip_types.begin(), gzip_types.end(), "text/html") == gzip_types.end()) {
+		gzip_types.push_back("text/html");
+	}
+	return true;
+}
+
+bool LocationConfig::setGzipMinLength(int gzip_min_length) {
+	if (gzip_min_length < 0) {
+		return false;
+	}
+	this->gzip_min_length = gzip_min_length;
+	return true;
+}
+
+bool LocationConfig::setGzipCompLevel(int gzip_comp_level) {
+	if (gzip_comp_level < 1 || gzip_comp_level > 9) {
+		return false;
+	}
+	this->gzip_comp_level = gzip_comp_level;
+	return true;
+}
+
+bool LocationConfig::setGzipStatic(bool isGzipStaticOn) {
+	this->gzip_static = isGzipStaticOn;
+	return true;
+}
+
+bool LocationConfig::setResponseCache(bool isResponseCacheOn) {
+	this->response_cache = isResponseCacheOn;
+	return true;
+}
+
+bool LocationConfig::setResponseCacheValid(int response_cache_valid) {
+	if (response_cache_valid <= 0) {
+		return false;
+	}
+	this->response_cache_valid = response_cache_valid;
+	return true;
+}
+
+bool LocationConfig::setCgiMaxProcesses(int cgi_max_processes) {
+	if (cgi_max_processes < 0) {
+		return false;
+	}
+	this->cgi_max_processes = cgi_max_processes;
+	return true;
+}
+
+bool LocationConfig::setCgiQueueSize(int cgi_queue_size) {
+	if (cgi_queue_size < 0) {
+		return false;
+	}
+	this->cgi_queue_size = cgi_queue_size;
+	return true;
+}
+
+bool LocationConfig::setCgiRlimitCpu(int cgi_rlimit_cpu) {
+	if (cgi_rlimit_cpu <= 0) {
+		return false;
+	}
+	this->cgi_rlimit_cpu = cgi_rlimit_cpu;
+	return true;
+}
+
+bool LocationConfig::setCgiRlimitAs(size_t cgi_rlimit_as) {
+	if (cgi_rlimit_as == 0) {
+		return false;
+	}
+	this->cgi_rlimit_as = cgi_rlimit_as;
+	return true;
+}
+
+bool LocationConfig::setCgiRlimitNofile(int cgi_rlimit_nofile) {
+	// stdin, stdout and stderr at least
+	if (cgi_rlimit_nofile < 3) {
+		return false;
+	}
+	this->cgi_rlimit_nofile = cgi_rlimit_nofile;
+	return true;
+}
+
+// Raising the priority needs privileges the server does not keep, so every 
+// launch would fail; only lowering it is accepted
+bool LocationConfig::setCgiNice(int cgi_nice) {
+	if (cgi_nice < 0 || cgi_nice > 19) {
+		return false;
+	}
+	this->cgi_nice = cgi_nice;
+	return true;
+}
+
+// The cgroup must exist already, with its controllers set up by the admin; 
+// scripts are only moved into it
+bool LocationConfig::setCgiCgroup(const std::string& cgi_cgroup) {
+	if (access((cgi_cgroup + "/cgroup.procs").c_str(), W_OK) != 0) {
+		return false;
+	}
+	this->cgi_cgroup = cgi_cgroup;
+	return true;
+}
+
+bool LocationConfig::setCgiNph(bool isCgiNphOn) {
+	this->cgi_nph = isCgiNphOn;
+	return true;
+}
+
+bool LocationConfig::setSession(const std::string& session) {
+	if (session != "on" && session != "off" && session != "lazy") {
+		return false;
+	}
+	this->session = session;
+	return true;
+}
+
 bool LocationConfig::addErrorPage(int error_code, const std::string& file_path) {
 	if (error_code < 400 || error_code > 599) {
 		return false;
@@ -307,8 +641,14 @@ bool LocationConfig::addErrorPage(int error_code, const std::string& file_path)
 	return true;
 }
 
+void LocationConfig::addErrorResponse(int error_code, const PrebuiltResponse& response) {
+	error_responses[error_code] = response;
+}
+
 // Operators overload
 
+// "^~ /a" and "/a" are the same prefix; "= /a" is not
 bool LocationConfig::operator==(const LocationConfig& other) const {
-	return location == other.location;
+	return location == other.location && isRegex() == other.isRegex()
+		&& (modifier == "=") == (other.modifier == "=");
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "LocationMatcher.hpp"
+#include <sstream>
+
+// Other includes
+#include <stdint.h> // uint64_t
+#include "constants.hpp"
+
+LocationMatcher::LocationMatcher() {
+	addNode("");
+}
+
+LocationMatcher::LocationMatcher(const LocationMatcher& other) :
+	nodes(other.nodes),
+	memo(other.memo)
+{
+	copyPatterns(other);
+}
+
+LocationMatcher& LocationMatcher::operator=(const LocationMatcher& other) {
+	if (this != &other) {
+		clearPatterns();
+		nodes = other.nodes;
+		memo = other.memo;
+		copyPatterns(other);
+	}
+	return *this;
+}
+
+LocationMatcher::~LocationMatcher() {
+	clearPatterns();
+}
+
+// Debug
+
+std::string LocationMatcher::toString() const {
+	std::ostringstream oss;
+
+	oss << "LocationMatcher instance" << std::endl;
+	oss << "nodes: " << nodes.size() << std::endl;
+	oss << "patterns: " << patterns.size() << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const LocationMatcher& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Private methods
+
+size_t LocationMatcher::addNode(const std::string& label) {
+	Node node;
+	node.label = label;
+	node.location = -1;
+	node.stops_regex = false;
+	node.exact = -1;
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+// The node for path, created if needed. An edge that only partly matches 
+// path is split where they part. Indices rather than references: addNode 
+// may move the nodes
+size_t LocationMatcher::insertPath(const std::string& path) {
+	size_t node = 0;
+	size_t pos = 0;
+	while (pos < path.size()) {
+		size_t i = nodes[node].firsts.find(path[pos]);
+		if (i == std::string::npos) {
+			size_t leaf = addNode(path.substr(pos));
+			nodes[node].firsts += path[pos];
+			nodes[node].children.push_back(leaf);
+			return leaf;
+		}
+		size_t child = nodes[node].children[i];
+		const std::string& label = nodes[child].label;
+		size_t common = 0;
+		while (common < label.size() && pos + common < path.size() 
+		&& label[common] == path[pos + common]) {
+			++common;
+		}
+		if (common < label.size()) {
+			size_t middle = addNode(label.substr(0, common));
+			nodes[middle].firsts += nodes[child].label[common];
+			nodes[middle].children.push_back(child);
+			nodes[child].label.erase(0, common);
+			nodes[node].children[i] = middle;
+			child = middle;
+		}
+		node = child;
+		pos += common;
+	}
+	return node;
+}
+
+// regex_t cannot be copied: each copy of the matcher compiles its own
+regex_t* LocationMatcher::compilePattern(const std::string& source, bool caseless) {
+	regex_t* compiled = new regex_t;
+	int flags = REG_EXTENDED | REG_NOSUB | (caseless ? REG_ICASE : 0);
+	if (regcomp(compiled, source.c_str(), flags) != 0) {
+		delete compiled;
+		return NULL;
+	}
+	return compiled;
+}
+
+void LocationMatcher::clearPatterns() {
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		regfree(patterns[i].compiled);
+		delete patterns[i].compiled;
+	}
+	patterns.clear();
+}
+
+void LocationMatcher::copyPatterns(const LocationMatcher& other) {
+	for (size_t i = 0; i < other.patterns.size(); ++i) {
+		Pattern pattern = other.patterns[i];
+		pattern.compiled = compilePattern(pattern.source, pattern.caseless);
+		if (pattern.compiled) {
+			patterns.push_back(pattern);
+		}
+	}
+}
+
+static size_t hashPath(const std::string& path) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < path.size(); ++i) {
+		hash ^= static_cast<unsigned char>(path[i]);
+		hash *= 1099511628211ULL;
+	}
+	return static_cast<size_t>(hash);
+}
+
+int LocationMatcher::matchUncached(const std::string& path) const {
+	int prefix = nodes[0].location;
+	bool stops_regex = nodes[0].stops_regex;
+	size_t node = 0;
+	size_t pos = 0;
+	while (pos < path.size()) {
+		size_t i = nodes[node].firsts.find(path[pos]);
+		if (i == std::string::npos) {
+			break;
+		}
+		size_t child = nodes[node].children[i];
+		const std::string& label = nodes[child].label;
+		if (path.compare(pos, label.size(), label) != 0) {
+			break;
+		}
+		node = child;
+		pos += label.size();
+		if (nodes[node].location >= 0) {
+			prefix = nodes[node].location;
+			stops_regex = nodes[node].stops_regex;
+		}
+	}
+	if (pos == path.size() && nodes[node].exact >= 0) {
+		return nodes[node].exact;
+	}
+	if (stops_regex) {
+		return prefix;
+	}
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		if (regexec(patterns[i].compiled, path.c_str(), 0, NULL, 0) == 0) {
+			return patterns[i].location;
+		}
+	}
+	return prefix;
+}
+
+// Core functionality
+
+bool LocationMatcher::isValidPattern(const std::string& source) {
+	regex_t* compiled = compilePattern(source, false);
+	if (!compiled) {
+		return false;
+	}
+	regfree(compiled);
+	delete compiled;
+	return true;
+}
+
+// modifier is "", "=", "^~", "~" or "~*"; false if a regex does not compile
+bool LocationMatcher::insert(const std::string& modifier, const std::string& path, 
+int location) {
+	if (modifier == "~" || modifier == "~*") {
+		Pattern pattern;
+		pattern.source = path;
+		pattern.caseless = modifier == "~*";
+		pattern.location = location;
+		pattern.compiled = compilePattern(path, pattern.caseless);
+		if (!pattern.compiled) {
+			return false;
+		}
+		patterns.push_back(pattern);
+		MemoEntry empty;
+		empty.location = -2;
+		memo.assign(LOCATION_MEMO_SIZE, empty);
+		return true;
+	}
+	size_t node = insertPath(path);
+	if (modifier == "=") {
+		nodes[node].exact = location;
+	} else {
+		nodes[node].location = location;
+		nodes[node].stops_regex = modifier == "^~";
+	}
+	return true;
+}
+
+// Index of the location for path, -1 if none applies
+int LocationMatcher::match(const std::string& path) const {
+	if (memo.empty()) {
+		return matchUncached(path);
+	}
+	MemoEntry& entry = memo[hashPath(path) & (memo.size() - 1)];
+	if (entry.location == -2 || entry.path != path) {
+		entry.path = path;
+		entry.location = matchUncached(path);
+	}
+	return entry.location;
+}
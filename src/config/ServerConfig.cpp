@@ -7,25 +7,38 @@
 ServerConfig::ServerConfig() :
 	listen(80),
 	server_name("localhost"),
+	default_server(false),
 	client_max_body_size(1048576), // 1MB default
 	root("www/"),
-	index("index.html")
+	index("index.html"),
+	gzip(false),
+	gzip_min_length(20),
+	gzip_comp_level(1)
 {
 	allowed_methods.push_back("GET");
 	allowed_methods.push_back("POST");
 	allowed_methods.push_back("DELETE");
+	gzip_types.push_back("text/html");
 }
 
 ServerConfig::ServerConfig(const ServerConfig& other) :
 	listen(other.listen),
 	host(other.host),
 	server_name(other.server_name),
+	server_names(other.server_names),
+	default_server(other.default_server),
 	error_pages(other.error_pages),
 	client_max_body_size(other.client_max_body_size),
 	root(other.root),
 	index(other.index),
 	allowed_methods(other.allowed_methods),
-	locations(other.locations)
+	locations(other.locations),
+	locationMatcher(other.locationMatcher),
+	gzip(other.gzip),
+	gzip_types(other.gzip_types),
+	gzip_min_length(other.gzip_min_length),
+	gzip_comp_level(other.gzip_comp_level),
+	error_responses(other.error_responses)
 {}
 
 ServerConfig& ServerConfig::operator=(const ServerConfig& other) {
@@ -33,12 +46,20 @@ ServerConfig& ServerConfig::operator=(const ServerConfig& other) {
 		listen = other.listen;
 		host = other.host;
 		server_name = other.server_name;
+		server_names = other.server_names;
+		default_server = other.default_server;
 		error_pages = other.error_pages;
 		client_max_body_size = other.client_max_body_size;
 		root = other.root;
 		index = other.index;
 		allowed_methods = other.allowed_methods;
 		locations = other.locations;
+		locationMatcher = other.locationMatcher;
+		gzip = other.gzip;
+		gzip_types = other.gzip_types;
+		gzip_min_length = other.gzip_min_length;
+		gzip_comp_level = other.gzip_comp_level;
+		error_responses = other.error_responses;
 	}
 	return *this;
 }
@@ -51,9 +72,11 @@ std::string ServerConfig::toString() const {
 	std::ostringstream oss;
 
 	oss << "ServerConfig instance" << std::endl;
-	oss << "listen: " << listen << std::endl;
+	oss << "listen: " << listen << (default_server ? " default_server" : "") << std::endl;
 	oss << "host: " << host << std::endl;
-	oss << "server_name: " << server_name << std::endl;
+	for (size_t i = 0; i < server_names.size(); ++i) {
+		oss << "server_name: " << server_names[i] << std::endl;
+	}
 	for (std::map<int, std::string>::const_iterator it = error_pages.begin();
 	it != error_pages.end(); ++it) {
 		oss << "error_page: " << it->first << ": " << it->second << std::endl;
@@ -65,6 +88,13 @@ std::string ServerConfig::toString() const {
 	it != allowed_methods.end(); ++it) {
 		oss << "allowed_method: " << *it << std::endl;
 	}
+	oss << "gzip: " << (gzip ? "on" : "off") << std::endl;
+	for (std::vector<std::string>::const_iterator it = gzip_types.begin();
+	it != gzip_types.end(); ++it) {
+		oss << "gzip_type: " << *it << std::endl;
+	}
+	oss << "gzip_min_length: " << gzip_min_length << std::endl;
+	oss << "gzip_comp_level: " << gzip_comp_level << std::endl;
 	for (std::vector<LocationConfig>::const_iterator it = locations.begin();
 	it != locations.end(); ++it) {
 		oss << *it << std::endl;
@@ -91,6 +121,14 @@ const std::string& ServerConfig::getServerName() const {
 	return server_name;
 }
 
+const std::vector<std::string>& ServerConfig::getServerNames() const {
+	return server_names;
+}
+
+bool ServerConfig::isDefaultServer() const {
+	return default_server;
+}
+
 const std::map<int, std::string>& ServerConfig::getErrorPages() const {
 	return error_pages;
 }
@@ -115,6 +153,37 @@ const std::vector<LocationConfig>& ServerConfig::getLocations() const {
 	return locations;
 }
 
+std::vector<LocationConfig>& ServerConfig::getLocations() {
+	return locations;
+}
+
+// Longest location prefix of path, NULL if there is none
+const LocationConfig* ServerConfig::findLocation(const std::string& path) const {
+	int index = locationMatcher.match(path);
+	return index < 0 ? NULL : &locations[index];
+}
+
+bool ServerConfig::isGzipOn() const {
+	return gzip;
+}
+
+const std::vector<std::string>& ServerConfig::getGzipTypes() const {
+	return gzip_types;
+}
+
+size_t ServerConfig::getGzipMinLength() const {
+	return gzip_min_length;
+}
+
+int ServerConfig::getGzipCompLevel() const {
+	return gzip_comp_level;
+}
+
+const PrebuiltResponse* ServerConfig::findErrorResponse(int error_code) const {
+	std::map<int, PrebuiltResponse>::const_iterator it = error_responses.find(error_code);
+	return (it != error_responses.end()) ? &it->second : NULL;
+}
+
 // Setters & Adders
 
 bool ServerConfig::setListen(int listen) {
@@ -162,6 +231,11 @@ bool ServerConfig::setServerName(const std::string& server_name) {
 	return true;
 }
 
+bool ServerConfig::setDefaultServer(bool default_server) {
+	this->default_server = default_server;
+	return true;
+}
+
 bool ServerConfig::setClientMaxBodySize(size_t client_max_body_size) {
 	// 2UL = 2 unsigned long, << 30 moves 30 bits on the left, 2 * 2^30 = 2147483648 (2Go)
 	if (client_max_body_size == 0 || client_max_body_size > (2UL << 30)) {
@@ -199,6 +273,49 @@ bool ServerConfig::setIndex(const std::string& index) {
 	return true;
 }
 
+bool ServerConfig::setGzip(bool isGzipOn) {
+	this->gzip = isGzipOn;
+	return true;
+}
+
+bool ServerConfig::setGzipTypes(const std::vector<std::string>& gzip_types) {
+	std::vector<std::string> types(gzip_types);
+	if (!LocationConfig::normalizeGzipTypes(types)) {
+		return false;
+	}
+	this->gzip_types.swap(types);
+	return true;
+}
+
+bool ServerConfig::setGzipMinLength(int gzip_min_length) {
+	if (gzip_min_length < 0) {
+		return false;
+	}
+	this->gzip_min_length = static_cast<size_t>(gzip_min_length);
+	return true;
+}
+
+bool ServerConfig::setGzipCompLevel(int gzip_comp_level) {
+	if (gzip_comp_level < 1 || gzip_comp_level > 9) {
+		return false;
+	}
+	this->gzip_comp_level = gzip_comp_level;
+	return true;
+}
+
+// The first name stays the one scripts get as SERVER_NAME
+bool ServerConfig::addServerName(const std::string& server_name) {
+	std::string first = this->server_name;
+	if (!setServerName(server_name)) {
+		return false;
+	}
+	if (!server_names.empty()) {
+		this->server_name = first;
+	}
+	server_names.push_back(server_name);
+	return true;
+}
+
 bool ServerConfig::addErrorPage(int error_code, const std::string& file_path) {
 	if (error_code < 400 || error_code > 599) {
 		return false;
@@ -216,24 +333,32 @@ bool ServerConfig::addErrorPage(int error_code, const std::string& file_path) {
 	return true;
 }
 
+// Regex locations were checked by LocationConfig::setLocation already
 bool ServerConfig::addLocation(const LocationConfig& location) {
-	if (location.getLocation()[0] != '/') {
-		return false;
-	}
-	if (location.getLocation().find("..") != std::string::npos) {
-		return false;
-	}
-	const std::string invalidChars = "*?|<>\"";
-	for (size_t i = 0; i < location.getLocation().size(); ++i) {
-		if (invalidChars.find(location.getLocation()[i]) != std::string::npos) {
+	if (!location.isRegex()) {
+		if (location.getLocation()[0] != '/') {
+			return false;
+		}
+		if (location.getLocation().find("..") != std::string::npos) {
 			return false;
 		}
+		const std::string invalidChars = "*?|<>\"";
+		for (size_t i = 0; i < location.getLocation().size(); ++i) {
+			if (invalidChars.find(location.getLocation()[i]) != std::string::npos) {
+				return false;
+			}
+		}
 	}
 	std::vector<LocationConfig>::const_iterator it = std::find(locations.begin(),
 		locations.end(), location);
-	if (it == locations.end()) {
-		locations.push_back(location);
-		return true;
+	if (it != locations.end() || !locationMatcher.insert(location.getModifier(), 
+	location.getLocation(), locations.size())) {
+		return false;
 	}
-	return false;
+	locations.push_back(location);
+	return true;
+}
+
+void ServerConfig::addErrorResponse(int error_code, const PrebuiltResponse& response) {
+	error_responses[error_code] = response;
 }
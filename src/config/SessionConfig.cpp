@@ -0,0 +1,160 @@
+#include "SessionConfig.hpp"
+#include <sstream>
+
+// Other includes
+#include <unistd.h> // access
+#include "constants.hpp"
+
+SessionConfig::SessionConfig() :
+	snapshot_interval(SESSION_SNAPSHOT_DEFAULT_INTERVAL),
+	max_count(0),
+	max_memory(0),
+	create_rate(0),
+	create_window(60),
+	backend("memory")
+{}
+
+SessionConfig::SessionConfig(const SessionConfig& other) :
+	store_path(other.store_path),
+	snapshot_interval(other.snapshot_interval),
+	max_count(other.max_count),
+	max_memory(other.max_memory),
+	create_rate(other.create_rate),
+	create_window(other.create_window),
+	backend(other.backend),
+	secret(other.secret)
+{}
+
+SessionConfig& SessionConfig::operator=(const SessionConfig& other) {
+	if (this != &other) {
+		store_path = other.store_path;
+		snapshot_interval = other.snapshot_interval;
+		max_count = other.max_count;
+		max_memory = other.max_memory;
+		create_rate = other.create_rate;
+		create_window = other.create_window;
+		backend = other.backend;
+		secret = other.secret;
+	}
+	return *this;
+}
+
+SessionConfig::~SessionConfig() {}
+
+// Debug
+
+std::string SessionConfig::toString() const {
+	std::ostringstream oss;
+
+	oss << "SessionConfig instance" << std::endl;
+	oss << "store_path: " << store_path << std::endl;
+	oss << "snapshot_interval: " << snapshot_interval << std::endl;
+	oss << "max_count: " << max_count << std::endl;
+	oss << "max_memory: " << max_memory << std::endl;
+	oss << "create_rate: " << create_rate << " per " << create_window << "s" << std::endl;
+	oss << "backend: " << backend << std::endl;
+	oss << "secret: " << (secret.empty() ? "unset" : "set") << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const SessionConfig& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Getters
+
+const std::string& SessionConfig::getStorePath() const {
+	return store_path;
+}
+
+int SessionConfig::getSnapshotInterval() const {
+	return snapshot_interval;
+}
+
+size_t SessionConfig::getMaxCount() const {
+	return max_count;
+}
+
+size_t SessionConfig::getMaxMemory() const {
+	return max_memory;
+}
+
+int SessionConfig::getCreateRate() const {
+	return create_rate;
+}
+
+int SessionConfig::getCreateWindow() const {
+	return create_window;
+}
+
+const std::string& SessionConfig::getBackend() const {
+	return backend;
+}
+
+const std::string& SessionConfig::getSecret() const {
+	return secret;
+}
+
+// Setters
+
+// Snapshots are written next to the file, then renamed over it
+bool SessionConfig::setStorePath(const std::string& store_path) {
+	if (store_path.empty() || store_path[store_path.size() - 1] == '/') {
+		return false;
+	}
+	size_t slash = store_path.rfind('/');
+	std::string dir = slash == std::string::npos ? "." : store_path.substr(0, slash + 1);
+	if (access(dir.c_str(), W_OK) != 0) {
+		return false;
+	}
+	this->store_path = store_path;
+	return true;
+}
+
+bool SessionConfig::setSnapshotInterval(int snapshot_interval) {
+	if (snapshot_interval < 0) {
+		return false;
+	}
+	this->snapshot_interval = snapshot_interval;
+	return true;
+}
+
+bool SessionConfig::setMaxCount(int max_count) {
+	if (max_count < 0) {
+		return false;
+	}
+	this->max_count = static_cast<size_t>(max_count);
+	return true;
+}
+
+bool SessionConfig::setMaxMemory(size_t max_memory) {
+	this->max_memory = max_memory;
+	return true;
+}
+
+bool SessionConfig::setCreateRate(int create_rate, int create_window) {
+	if (create_rate < 0 || create_window <= 0) {
+		return false;
+	}
+	this->create_rate = create_rate;
+	this->create_window = create_window;
+	return true;
+}
+
+bool SessionConfig::setBackend(const std::string& backend) {
+	if (backend != "memory" && backend != "cookie") {
+		return false;
+	}
+	this->backend = backend;
+	return true;
+}
+
+// Every node behind the balancer must share it; short keys are guessable
+bool SessionConfig::setSecret(const std::string& secret) {
+	if (secret.size() < SESSION_SECRET_MIN_LENGTH) {
+		return false;
+	}
+	this->secret = secret;
+	return true;
+}
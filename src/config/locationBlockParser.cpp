@@ -47,6 +47,93 @@ namespace locationBlockParser {
 		}
 	}
 
+	// "fastcgi_pass unix:/run/app.sock;" or "fastcgi_pass 127.0.0.1:9000;"
+	void parseFastcgiPassDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!locationConfig.setFastcgiPass(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+					parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// "cgi_max_processes 4;" caps the scripts running at once (16 by default), 
+	// 0 lifts the cap
+	void parseCgiMaxProcessesDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!stringUtils::isInt(tokens[1]) 
+		|| !locationConfig.setCgiMaxProcesses(stringUtils::stringToInt(tokens[1]))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// Requests over cgi_max_processes wait in line, beyond it they get a 503
+	void parseCgiQueueSizeDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!stringUtils::isInt(tokens[1]) 
+		|| !locationConfig.setCgiQueueSize(stringUtils::stringToInt(tokens[1]))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// "cgi_rlimit_cpu 10;", "cgi_rlimit_nofile 64;" and "cgi_nice 10;" (0 to 19)
+	void parseCgiLimitDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		bool valid = stringUtils::isInt(tokens[1]);
+		int value = valid ? stringUtils::stringToInt(tokens[1]) : 0;
+		if (valid && directive == "cgi_rlimit_cpu") {
+			valid = locationConfig.setCgiRlimitCpu(value);
+		} else if (valid && directive == "cgi_rlimit_nofile") {
+			valid = locationConfig.setCgiRlimitNofile(value);
+		} else if (valid) {
+			valid = locationConfig.setCgiNice(value);
+		}
+		if (!valid) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// "cgi_rlimit_as 256M;"
+	void parseCgiRlimitAsDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!locationConfig.setCgiRlimitAs(serverBlockParser::convertBodySize(tokens[1]))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// "cgi_cgroup /sys/fs/cgroup/webserv/cgi;"
+	void parseCgiCgroupDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!locationConfig.setCgiCgroup(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	void parseCgiNphDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		bool isCgiNphOn = false;
+		if (tokens[1] == "on") {
+			isCgiNphOn = true;
+		} else if (tokens[1] == "off") {
+			isCgiNphOn = false;
+		} else {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+		locationConfig.setCgiNph(isCgiNphOn);
+	}
+
 	void parseReturnDirective(LocationConfig& locationConfig, ConfigParser& parser, 
 	std::vector<std::string>& tokens, const std::string& directive) {
 		serverBlockParser::checkTokensSize(tokens, 2, 3, parser, directive);
@@ -104,6 +191,70 @@ namespace locationBlockParser {
 		locationConfig.setAutoindex(isAutoindexEnabled);
 	}
 
+	void parseAutoindexFormatDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!locationConfig.setAutoindexFormat(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	void parseGzipStaticDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		bool isGzipStaticOn = false;
+		if (tokens[1] == "on") {
+			isGzipStaticOn = true;
+		} else if (tokens[1] == "off") {
+			isGzipStaticOn = false;
+		} else {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+		locationConfig.setGzipStatic(isGzipStaticOn);
+	}
+
+	void parseResponseCacheDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		bool isResponseCacheOn = false;
+		if (tokens[1] == "on") {
+			isResponseCacheOn = true;
+		} else if (tokens[1] == "off") {
+			isResponseCacheOn = false;
+		} else {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+		locationConfig.setResponseCache(isResponseCacheOn);
+	}
+
+	// Seconds, with an optional "s" suffix: "response_cache_valid 30s;"
+	void parseResponseCacheValidDirective(LocationConfig& locationConfig, 
+	ConfigParser& parser, std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		std::string value = tokens[1];
+		if (!value.empty() && value[value.size() - 1] == 's') {
+			value.erase(value.size() - 1);
+		}
+		if (!stringUtils::isInt(value) 
+		|| !locationConfig.setResponseCacheValid(stringUtils::stringToInt(value))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// "session lazy;": no session until a handler writes to one
+	void parseSessionDirective(LocationConfig& locationConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!locationConfig.setSession(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
 	void parseLocationDirectiveLine(LocationConfig& locationConfig, 
 	ConfigParser& parser) {
 		std::vector<std::string> tokens = stringUtils::split(parser.getCurrentLine(), ' ');
@@ -126,6 +277,8 @@ namespace locationBlockParser {
 			parseIndexDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "autoindex") {
 			parseAutoindexDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "autoindex_format") {
+			parseAutoindexFormatDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "allowed_methods") {
 			parseAllowedMethodsDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "return") {
@@ -134,6 +287,23 @@ namespace locationBlockParser {
 			parseCgiExtensionDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "cgi_path") {
 			parseCgiPathDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "fastcgi_pass") {
+			parseFastcgiPassDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_max_processes") {
+			parseCgiMaxProcessesDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_queue_size") {
+			parseCgiQueueSizeDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_rlimit_cpu" || directive == "cgi_rlimit_nofile" 
+		|| directive == "cgi_nice") {
+			parseCgiLimitDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_rlimit_as") {
+			parseCgiRlimitAsDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_cgroup") {
+			parseCgiCgroupDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "cgi_nph") {
+			parseCgiNphDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "session") {
+			parseSessionDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "upload_store") {
 			parseUploadStoreDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "upload_enable") {
@@ -142,6 +312,20 @@ namespace locationBlockParser {
 			parseBodySizeDirective(locationConfig, parser, tokens, directive);
 		} else if (directive == "error_page") {
 			parseErrorPageDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "gzip") {
+			parseGzipDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "gzip_types") {
+			parseGzipTypesDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "gzip_min_length") {
+			parseGzipMinLengthDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "gzip_comp_level") {
+			parseGzipCompLevelDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "gzip_static") {
+			parseGzipStaticDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "response_cache") {
+			parseResponseCacheDirective(locationConfig, parser, tokens, directive);
+		} else if (directive == "response_cache_valid") {
+			parseResponseCacheValidDirective(locationConfig, parser, tokens, directive);
 		} else {
 			throwError::throwUnknownDirectiveError(parser.getConfigFilename(), 
 				parser.getLineNumber(), directive);
@@ -149,6 +333,10 @@ namespace locationBlockParser {
 	}
 
 	bool checkCgi(const LocationConfig& locationConfig) {
+		// A FastCGI backend runs the scripts itself: only the extension matters
+		if (!locationConfig.getFastcgiPass().empty()) {
+			return !locationConfig.getCgiExtension().empty();
+		}
 		if (locationConfig.getCgiExtension().empty() && locationConfig.getCgiPath().empty()) {
 			return true;
 		}
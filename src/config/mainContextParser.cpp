@@ -0,0 +1,134 @@
+#include "mainContextParser.hpp"
+#include "serverBlockParser.hpp"
+#include "stringUtils.hpp"
+#include "throwError.hpp"
+
+namespace mainContextParser {
+
+	void parseSessionStorePathDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!sessionConfig.setStorePath(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// Seconds, with an optional "s" suffix: "session_snapshot_interval 60s;"
+	void parseSessionSnapshotIntervalDirective(SessionConfig& sessionConfig, 
+	ConfigParser& parser, std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		std::string value = tokens[1];
+		if (!value.empty() && value[value.size() - 1] == 's') {
+			value.erase(value.size() - 1);
+		}
+		if (!stringUtils::isInt(value) 
+		|| !sessionConfig.setSnapshotInterval(stringUtils::stringToInt(value))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	void parseSessionMaxCountDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!stringUtils::isInt(tokens[1]) 
+		|| !sessionConfig.setMaxCount(stringUtils::stringToInt(tokens[1]))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// Same units as client_max_body_size: "session_max_memory 64M;"
+	void parseSessionMaxMemoryDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!sessionConfig.setMaxMemory(serverBlockParser::convertBodySize(tokens[1]))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// Per client IP, a second or a minute: "session_create_rate 30/m;"
+	void parseSessionCreateRateDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		std::string value = tokens[1];
+		int window = 0;
+		if (value.size() > 2 && value.compare(value.size() - 2, 2, "/s") == 0) {
+			window = 1;
+		} else if (value.size() > 2 && value.compare(value.size() - 2, 2, "/m") == 0) {
+			window = 60;
+		}
+		value.erase(value.size() - (window ? 2 : 0));
+		if (!window || !stringUtils::isInt(value) 
+		|| !sessionConfig.setCreateRate(stringUtils::stringToInt(value), window)) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	void parseSessionBackendDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!sessionConfig.setBackend(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[1]);
+		}
+	}
+
+	// The value is not echoed back in the error
+	void parseSessionSecretDirective(SessionConfig& sessionConfig, ConfigParser& parser, 
+	std::vector<std::string>& tokens, const std::string& directive) {
+		serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+		if (!sessionConfig.setSecret(tokens[1])) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, "(too short)");
+		}
+	}
+
+	// Anything else up here, blocks and server directives included, is misplaced
+	bool isMainDirective(const std::string& directive) {
+		return directive == "session_store_path" || directive == "session_snapshot_interval"
+			|| directive == "session_max_count" || directive == "session_max_memory"
+			|| directive == "session_create_rate" || directive == "session_backend"
+			|| directive == "session_secret";
+	}
+
+	void parseMainDirectiveLine(SessionConfig& sessionConfig, ConfigParser& parser) {
+		std::vector<std::string> tokens = stringUtils::split(parser.getCurrentLine(), ' ');
+		if (tokens.empty()) {
+			return;
+		}
+		std::string& directive = tokens[0];
+		if (!isMainDirective(directive)) {
+			throwError::throwDirectiveNotAllowedHereError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive);
+		}
+		std::string& lastToken = tokens.back();
+		if (lastToken[lastToken.size() - 1] != ';') {
+			throwError::throwNotTerminatedBySemicolonError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive);
+		}
+		lastToken = stringUtils::removeTrailingSemicolon(lastToken);
+		if (lastToken.empty()) {
+			tokens.pop_back();
+		}
+		if (directive == "session_store_path") {
+			parseSessionStorePathDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_snapshot_interval") {
+			parseSessionSnapshotIntervalDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_max_count") {
+			parseSessionMaxCountDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_max_memory") {
+			parseSessionMaxMemoryDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_create_rate") {
+			parseSessionCreateRateDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_backend") {
+			parseSessionBackendDirective(sessionConfig, parser, tokens, directive);
+		} else if (directive == "session_secret") {
+			parseSessionSecretDirective(sessionConfig, parser, tokens, directive);
+		}
+	}
+
+}
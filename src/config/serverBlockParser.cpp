@@ -39,10 +39,12 @@ namespace serverBlockParser {
 
 	void parseServerNameDirective(ServerConfig& serverConfig, ConfigParser& parser, 
 	std::vector<std::string>& tokens, const std::string& directive) {
-		checkTokensSize(tokens, 2, 2, parser, directive);
-		if (!serverConfig.setServerName(tokens[1])) {
-			throwError::throwInvalidValueError(parser.getConfigFilename(), 
-				parser.getLineNumber(), directive, tokens[1]);
+		checkTokensSize(tokens, 2, tokens.size(), parser, directive);
+		for (size_t i = 1; i < tokens.size(); ++i) {
+			if (!serverConfig.addServerName(tokens[i])) {
+				throwError::throwInvalidValueError(parser.getConfigFilename(), 
+					parser.getLineNumber(), directive, tokens[i]);
+			}
 		}
 	}
 
@@ -57,12 +59,17 @@ namespace serverBlockParser {
 
 	void parseListenDirective(ServerConfig& serverConfig, ConfigParser& parser, 
 	std::vector<std::string>& tokens, const std::string& directive) {
-		checkTokensSize(tokens, 2, 2, parser, directive);
+		checkTokensSize(tokens, 2, 3, parser, directive);
 		int port = stringUtils::stringToInt(tokens[1]);
 		if (!serverConfig.setListen(port)) {
 			throwError::throwInvalidValueError(parser.getConfigFilename(), 
 				parser.getLineNumber(), directive, tokens[1]);
 		}
+		if (tokens.size() == 3 && (tokens[2] != "default_server" 
+		|| !serverConfig.setDefaultServer(true))) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), directive, tokens[2]);
+		}
 	}
 
 	void parseServerDirectiveLine(ServerConfig& serverConfig, ConfigParser& parser) {
@@ -94,6 +101,14 @@ namespace serverBlockParser {
 			parseRootDirective(serverConfig, parser, tokens, directive);
 		} else if (directive == "index") {
 			parseIndexDirective(serverConfig, parser, tokens, directive);
+		} else if (directive == "gzip") {
+			parseGzipDirective(serverConfig, parser, tokens, directive);
+		} else if (directive == "gzip_types") {
+			parseGzipTypesDirective(serverConfig, parser, tokens, directive);
+		} else if (directive == "gzip_min_length") {
+			parseGzipMinLengthDirective(serverConfig, parser, tokens, directive);
+		} else if (directive == "gzip_comp_level") {
+			parseGzipCompLevelDirective(serverConfig, parser, tokens, directive);
 		} else {
 			throwError::throwUnknownDirectiveError(parser.getConfigFilename(), 
 				parser.getLineNumber(), directive);
@@ -102,13 +117,18 @@ namespace serverBlockParser {
 
 	void handleLocation(ServerConfig& serverConfig, ConfigParser& parser) {
 		std::vector<std::string> tokens = stringUtils::split(parser.getCurrentLine(), ' ');
-		checkTokensSize(tokens, 3, 3, parser, "location");
-		std::string path = tokens[1];
+		checkTokensSize(tokens, 3, 4, parser, "location");
+		// location [= | ^~ | ~ | ~*] path {
+		std::string path = tokens[tokens.size() - 2];
 		LocationConfig location(path, serverConfig.getClientMaxBodySize());
-		if (!location.setLocation(path)) {
+		if (tokens.size() == 4 && !location.setModifier(tokens[1])) {
 			throwError::throwInvalidValueError(parser.getConfigFilename(), 
 				parser.getLineNumber(), tokens[0], tokens[1]);
 		}
+		if (!location.setLocation(path)) {
+			throwError::throwInvalidValueError(parser.getConfigFilename(), 
+				parser.getLineNumber(), tokens[0], path);
+		}
 		locationBlockParser::parseLocationBlock(location, parser);
 		serverConfig.addLocation(location);
 	}
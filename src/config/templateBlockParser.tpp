@@ -46,3 +46,52 @@ std::vector<std::string>& tokens, const std::string& directive) {
 			parser.getLineNumber(), directive, tokens[1]);
 	}
 }
+
+template <typename T>
+void parseGzipDirective(T& config, ConfigParser& parser,
+std::vector<std::string>& tokens, const std::string& directive) {
+	serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+	bool isGzipOn = false;
+	if (tokens[1] == "on") {
+		isGzipOn = true;
+	} else if (tokens[1] == "off") {
+		isGzipOn = false;
+	} else {
+		throwError::throwInvalidValueError(parser.getConfigFilename(), 
+			parser.getLineNumber(), directive, tokens[1]);
+	}
+	config.setGzip(isGzipOn);
+}
+
+template <typename T>
+void parseGzipTypesDirective(T& config, ConfigParser& parser,
+std::vector<std::string>& tokens, const std::string& directive) {
+	serverBlockParser::checkTokensSize(tokens, 2, 64, parser, directive);
+	std::vector<std::string> gzip_types(tokens.begin() + 1, tokens.end());
+	if (!config.setGzipTypes(gzip_types)) {
+		throwError::throwInvalidValueError(parser.getConfigFilename(), 
+			parser.getLineNumber(), directive, tokens[1]);
+	}
+}
+
+template <typename T>
+void parseGzipMinLengthDirective(T& config, ConfigParser& parser,
+std::vector<std::string>& tokens, const std::string& directive) {
+	serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+	size_t min_length = serverBlockParser::convertBodySize(tokens[1]);
+	if (!config.setGzipMinLength(static_cast<int>(min_length))) {
+		throwError::throwInvalidValueError(parser.getConfigFilename(), 
+			parser.getLineNumber(), directive, tokens[1]);
+	}
+}
+
+template <typename T>
+void parseGzipCompLevelDirective(T& config, ConfigParser& parser,
+std::vector<std::string>& tokens, const std::string& directive) {
+	serverBlockParser::checkTokensSize(tokens, 2, 2, parser, directive);
+	if (!stringUtils::isInt(tokens[1]) 
+	|| !config.setGzipCompLevel(stringUtils::stringToInt(tokens[1]))) {
+		throwError::throwInvalidValueError(parser.getConfigFilename(), 
+			parser.getLineNumber(), directive, tokens[1]);
+	}
+}
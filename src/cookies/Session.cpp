@@ -2,29 +2,36 @@
 #include <sstream>
 
 // Other includes
+#include "timeUtils.hpp"
 
 Session::Session(const std::string& id) :
 	session_id(id),
-	created_at(time(NULL)),
-	last_accessed(time(NULL)),
-	max_age(3600)
+	record(SessionRecord()),
+	created_at(timeUtils::now()),
+	last_accessed(timeUtils::now()),
+	max_age(3600),
+	changed(false)
 {}
 
 Session::Session(const Session& other) :
 	session_id(other.session_id),
+	record(other.record),
 	data(other.data),
 	created_at(other.created_at),
 	last_accessed(other.last_accessed),
-	max_age(other.max_age)
+	max_age(other.max_age),
+	changed(other.changed)
 {}
 
 Session& Session::operator=(const Session& other) {
 	if (this != &other) {
 		session_id = other.session_id;
+		record = other.record;
 		data = other.data;
 		created_at = other.created_at;
 		last_accessed = other.last_accessed;
 		max_age = other.max_age;
+		changed = other.changed;
 	}
 	return *this;
 }
@@ -41,8 +48,11 @@ std::string Session::toString() const {
 	oss << "  Created: " << created_at << std::endl;
 	oss << "  Last accessed: " << last_accessed << std::endl;
 	oss << "  Max age: " << max_age << " seconds" << std::endl;
+	oss << "  Page views: " << record.page_views << ", uploads: " << record.upload_count 
+		<< ", deletes: " << record.delete_count << ", CGI runs: " << record.cgi_count 
+		<< std::endl;
 	oss << "  Data entries: " << data.size() << std::endl;
-	for (std::map<std::string, std::string>::const_iterator it = data.begin();
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = data.begin();
 	it != data.end(); ++it) {
 		oss << "    " << it->first << " = " << it->second << std::endl;
 	}
@@ -60,14 +70,27 @@ const std::string& Session::getSessionId() const {
 	return session_id;
 }
 
+SessionRecord& Session::getRecord() {
+	return record;
+}
+
+const SessionRecord& Session::getRecord() const {
+	return record;
+}
+
 std::string Session::getData(const std::string& key) const {
-	std::map<std::string, std::string>::const_iterator it = data.find(key);
-	if (it != data.end()) {
-		return it->second;
+	for (size_t i = 0; i < data.size(); ++i) {
+		if (data[i].first == key) {
+			return data[i].second;
+		}
 	}
 	return "";
 }
 
+const std::vector<std::pair<std::string, std::string> >& Session::getDataEntries() const {
+	return data;
+}
+
 time_t Session::getCreatedAt() const {
 	return created_at;
 }
@@ -80,15 +103,43 @@ int Session::getMaxAge() const {
 	return max_age;
 }
 
+// Heap bytes the session holds, roughly: string and vector capacities count
+// in full, even when the characters fit inside the string itself
+size_t Session::getMemoryUsage() const {
+	size_t bytes = sizeof(Session) + session_id.capacity() + record.last_page.capacity()
+		+ record.last_upload.capacity() + record.last_delete.capacity() 
+		+ record.last_cgi.capacity() + data.capacity() * sizeof(data[0]);
+	for (size_t i = 0; i < data.size(); ++i) {
+		bytes += data[i].first.capacity() + data[i].second.capacity();
+	}
+	return bytes;
+}
+
 bool Session::hasData(const std::string& key) const {
-	return data.find(key) != data.end();
+	for (size_t i = 0; i < data.size(); ++i) {
+		if (data[i].first == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Session::isChanged() const {
+	return changed;
 }
 
 // Setters
 
 void Session::setData(const std::string& key, const std::string& value) {
-	data[key] = value;
 	updateLastAccessed();
+	changed = true;
+	for (size_t i = 0; i < data.size(); ++i) {
+		if (data[i].first == key) {
+			data[i].second = value;
+			return;
+		}
+	}
+	data.push_back(std::make_pair(key, value));
 }
 
 void Session::setMaxAge(int seconds) {
@@ -96,8 +147,18 @@ void Session::setMaxAge(int seconds) {
 }
 
 void Session::removeData(const std::string& key) {
-	data.erase(key);
+	for (size_t i = 0; i < data.size(); ++i) {
+		if (data[i].first == key) {
+			data.erase(data.begin() + i);
+			break;
+		}
+	}
 	updateLastAccessed();
+	changed = true;
+}
+
+void Session::markChanged() {
+	changed = true;
 }
 
 // Time management
@@ -106,16 +167,28 @@ bool Session::isExpired() const {
 	if (max_age <= 0) {
 		return false;
 	}
-	time_t current_time = time(NULL);
-	return (current_time - last_accessed) > max_age;
+	return (timeUtils::now() - last_accessed) > max_age;
+}
+
+// First second the session counts as expired, 0 if it never does
+time_t Session::getExpiry() const {
+	if (max_age <= 0) {
+		return 0;
+	}
+	return last_accessed + max_age + 1;
 }
 
 void Session::updateLastAccessed() {
-	last_accessed = time(NULL);
+	last_accessed = timeUtils::now();
+}
+
+// For sessions read back from a snapshot, once their data is set
+void Session::restoreTimes(time_t created_at, time_t last_accessed) {
+	this->created_at = created_at;
+	this->last_accessed = last_accessed;
 }
 
 bool Session::isNew() const {
 	// Consider session "new" if created less than 5 seconds ago
-	time_t current_time = time(NULL);
-	return (current_time - created_at) < 5;
+	return (timeUtils::now() - created_at) < 5;
 }
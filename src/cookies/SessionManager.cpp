@@ -2,26 +2,75 @@
 #include <sstream>
 
 // Other includes
-#include <cstdlib> // srand(), rand()
-#include <ctime> // time()
+#include <cstring> // memcpy
+#include <algorithm> // push_heap, pop_heap
+#include "timeUtils.hpp"
+#include <fcntl.h> // open, sync_file_range
+#include <unistd.h> // read, write, pwrite, close, fsync
+#include <cstdio> // rename
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <sys/random.h> // getrandom
+#include <stdexcept> // runtime_error
+#include "stringUtils.hpp"
+#include "constants.hpp"
+#include <arpa/inet.h> // inet_addr
+#include "cryptoUtils.hpp"
 
-SessionManager::SessionManager() {
-	// Init random seed for session ID generation
-	srand(time(NULL));
-}
+SessionManager::SessionManager() :
+	slots(SESSION_TABLE_INITIAL_SIZE, Slot()),
+	count(0),
+	used_bytes(0),
+	max_count(0),
+	max_memory(0),
+	stateless(false),
+	cookie_session(NULL),
+	cookie_issued(0),
+	snapshot_fd(-1),
+	snapshot_next(0),
+	snapshot_count(0)
+{}
 
 SessionManager::SessionManager(const SessionManager& other) :
-	sessions(other.sessions)
-{}
+	count(0),
+	used_bytes(0),
+	max_count(other.max_count),
+	max_memory(other.max_memory),
+	rateLimiter(other.rateLimiter),
+	stateless(other.stateless),
+	secret(other.secret),
+	cookie_session(other.cookie_session ? new Session(*other.cookie_session) : NULL),
+	cookie_payload(other.cookie_payload),
+	cookie_issued(other.cookie_issued),
+	snapshot_fd(-1),
+	snapshot_next(0),
+	snapshot_count(0)
+{
+	copySessions(other);
+}
 
 SessionManager& SessionManager::operator=(const SessionManager& other) {
 	if (this != &other) {
-		sessions = other.sessions;
+		clearSessions();
+		max_count = other.max_count;
+		max_memory = other.max_memory;
+		rateLimiter = other.rateLimiter;
+		stateless = other.stateless;
+		secret = other.secret;
+		holdCookieSession(other.cookie_session ? new Session(*other.cookie_session) : NULL,
+			other.cookie_payload);
+		cookie_issued = other.cookie_issued;
+		copySessions(other);
 	}
 	return *this;
 }
 
-SessionManager::~SessionManager() {}
+// A snapshot in progress stays with the original
+SessionManager::~SessionManager() {
+	abortSnapshot();
+	clearSessions();
+	delete cookie_session;
+}
 
 // Debug
 
@@ -29,10 +78,12 @@ std::string SessionManager::toString() const {
 	std::ostringstream oss;
 
 	oss << "SessionManager instance" << std::endl;
-	oss << "Active sessions: " << sessions.size() << std::endl;
-	for (std::map<std::string, Session>::const_iterator it = sessions.begin();
-	it != sessions.end(); ++it) {
-		oss << "  - Session ID: " << it->first << std::endl;
+	oss << "Active sessions: " << count << " (" << slots.size() << " slots, about " 
+		<< used_bytes << " bytes)" << std::endl;
+	for (size_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].session) {
+			oss << "  - Session ID: " << slots[i].session->getSessionId() << std::endl;
+		}
 	}
 	return oss.str();
 }
@@ -44,51 +95,719 @@ std::ostream& operator<<(std::ostream& os, const SessionManager& obj) {
 
 // Private methods
 
-std::string SessionManager::generateSessionId() {
-	std::ostringstream oss;
-	// "sess_timestamp_randomNumber_randomNumber", "sess_1723723845_12345_67890"
-	oss << "sess_" << time(NULL) << "_" << rand() << "_" << rand();
-	return oss.str();
+static bool fillRandom(unsigned char* buffer, size_t size) {
+	ssize_t filled = getrandom(buffer, size, 0);
+	if (filled == static_cast<ssize_t>(size)) {
+		return true;
+	}
+	// Kernels without getrandom() still have the device
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	filled = read(fd, buffer, size);
+	close(fd);
+	return filled == static_cast<ssize_t>(size);
+}
+
+// The cookie value is the 16 bytes in base64url: 22 characters
+bool SessionManager::decodeId(const std::string& session_id, uint64_t key[2]) {
+	std::string bytes;
+	if (session_id.size() != 22 || !stringUtils::base64UrlDecode(session_id, bytes)
+	|| bytes.size() != 16) {
+		return false;
+	}
+	std::memcpy(key, bytes.data(), 16);
+	return true;
+}
+
+std::string SessionManager::generateSessionId(uint64_t key[2]) {
+	unsigned char bytes[16];
+	if (!fillRandom(bytes, sizeof(bytes))) {
+		throw std::runtime_error("no randomness for session ids");
+	}
+	std::memcpy(key, bytes, 16);
+	return stringUtils::base64UrlEncode(std::string(reinterpret_cast<char*>(bytes), 16));
+}
+
+// The slot holding key, or the empty slot its probe ends on
+size_t SessionManager::findSlot(const uint64_t key[2]) const {
+	size_t mask = slots.size() - 1;
+	size_t index = key[0] & mask;
+	while (slots[index].session 
+	&& (slots[index].key[0] != key[0] || slots[index].key[1] != key[1])) {
+		index = (index + 1) & mask;
+	}
+	return index;
+}
+
+void SessionManager::rehash(size_t size) {
+	std::vector<Slot> old(size, Slot());
+	old.swap(slots);
+	for (size_t i = 0; i < old.size(); ++i) {
+		if (old[i].session) {
+			slots[findSlot(old[i].key)] = old[i];
+		}
+	}
+}
+
+// Entries after the hole move back into it unless that would put them 
+// before their home slot, so no probe ever meets a gap (no tombstones)
+void SessionManager::eraseSlot(size_t index) {
+	used_bytes -= slots[index].lru_position->bytes;
+	lru.erase(slots[index].lru_position);
+	size_t mask = slots.size() - 1;
+	size_t hole = index;
+	size_t next = (hole + 1) & mask;
+	while (slots[next].session) {
+		size_t home = slots[next].key[0] & mask;
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			slots[hole] = slots[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+	slots[hole].session = NULL;
+	--count;
+}
+
+// Into the empty slot findSlot(key) ended on, as the most recently used
+void SessionManager::insertSlot(size_t index, const uint64_t key[2], Session* session) {
+	LruEntry entry;
+	entry.key[0] = key[0];
+	entry.key[1] = key[1];
+	entry.bytes = footprint(*session);
+	lru.push_front(entry);
+	used_bytes += entry.bytes;
+	slots[index].key[0] = key[0];
+	slots[index].key[1] = key[1];
+	slots[index].session = session;
+	slots[index].lru_position = lru.begin();
+	++count;
+}
+
+// Moves the session to the front, and recounts what the requests since its
+// previous use added to it
+void SessionManager::touch(size_t index) {
+	std::list<LruEntry>::iterator position = slots[index].lru_position;
+	lru.splice(lru.begin(), lru, position);
+	used_bytes -= position->bytes;
+	position->bytes = footprint(*slots[index].session);
+	used_bytes += position->bytes;
+}
+
+// The session plus its share of the table, the list and the heap
+size_t SessionManager::footprint(const Session& session) {
+	return session.getMemoryUsage() + 2 * sizeof(Slot) + sizeof(LruEntry) 
+		+ 2 * sizeof(void*) + sizeof(Deadline);
+}
+
+// Drops the least recently used sessions until sessions more, weighing 
+// bytes, fit under both caps
+void SessionManager::evictOverLimits(size_t sessions, size_t bytes) {
+	while (!lru.empty() && ((max_count && count + sessions > max_count) 
+	|| (max_memory && used_bytes + bytes > max_memory))) {
+		size_t index = findSlot(lru.back().key);
+		delete slots[index].session;
+		eraseSlot(index);
+	}
+}
+
+// Evicted and destroyed sessions leave their deadlines behind until due: 
+// under a flood of new sessions, they would pile up for a whole max-age
+void SessionManager::compactDeadlines() {
+	if (deadlines.size() <= count * 2 + SESSION_TABLE_INITIAL_SIZE) {
+		return;
+	}
+	deadlines.clear();
+	for (size_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].session && slots[i].session->getExpiry()) {
+			Deadline deadline;
+			deadline.at = slots[i].session->getExpiry();
+			deadline.key[0] = slots[i].key[0];
+			deadline.key[1] = slots[i].key[1];
+			deadlines.push_back(deadline);
+		}
+	}
+	std::make_heap(deadlines.begin(), deadlines.end(), isLater);
+}
+
+void SessionManager::pushDeadline(time_t at, const uint64_t key[2]) {
+	Deadline deadline;
+	deadline.at = at;
+	deadline.key[0] = key[0];
+	deadline.key[1] = key[1];
+	deadlines.push_back(deadline);
+	std::push_heap(deadlines.begin(), deadlines.end(), isLater);
+}
+
+bool SessionManager::isLater(const Deadline& a, const Deadline& b) {
+	return a.at > b.at;
+}
+
+// Oldest first, so the copy ends up in the same recency order
+void SessionManager::copySessions(const SessionManager& other) {
+	slots.assign(other.slots.size(), Slot());
+	deadlines = other.deadlines;
+	for (std::list<LruEntry>::const_reverse_iterator it = other.lru.rbegin();
+	it != other.lru.rend(); ++it) {
+		const Session* session = other.slots[other.findSlot(it->key)].session;
+		insertSlot(findSlot(it->key), it->key, new Session(*session));
+	}
+}
+
+// Room for total sessions, in a single rehash
+void SessionManager::reserve(size_t total) {
+	size_t size = slots.size();
+	while (total * 2 > size) {
+		size *= 2;
+	}
+	if (size != slots.size()) {
+		rehash(size);
+	}
+}
+
+// Snapshot format, native byte order (the file stays on this host):
+// "WSSNAP01", uint64 record count, then per session the fixed-size fields
+// and the strings, each behind a uint32 length
+
+static void putBytes(std::string& out, const void* data, size_t size) {
+	out.append(static_cast<const char*>(data), size);
+}
+
+template <typename T>
+static void put(std::string& out, T value) {
+	putBytes(out, &value, sizeof(value));
+}
+
+static void putString(std::string& out, const std::string& value) {
+	put<uint32_t>(out, value.size());
+	out += value;
+}
+
+void SessionManager::encodeSession(std::string& out, const uint64_t key[2], 
+const Session& session) {
+	const SessionRecord& record = session.getRecord();
+	putBytes(out, key, 16);
+	put<int64_t>(out, session.getCreatedAt());
+	put<int64_t>(out, session.getLastAccessed());
+	put<int32_t>(out, session.getMaxAge());
+	put<uint32_t>(out, record.page_views);
+	put<uint32_t>(out, record.upload_count);
+	put<uint32_t>(out, record.delete_count);
+	put<uint32_t>(out, record.cgi_count);
+	put<int64_t>(out, record.last_page_time);
+	put<int64_t>(out, record.last_upload_time);
+	put<int64_t>(out, record.last_delete_time);
+	put<int64_t>(out, record.last_cgi_time);
+	put<uint8_t>(out, record.bound);
+	put<uint32_t>(out, record.client_ip);
+	put<uint64_t>(out, record.user_agent_hash);
+	putString(out, record.last_page);
+	putString(out, record.last_upload);
+	putString(out, record.last_delete);
+	putString(out, record.last_cgi);
+	const std::vector<std::pair<std::string, std::string> >& data = session.getDataEntries();
+	put<uint32_t>(out, data.size());
+	for (size_t i = 0; i < data.size(); ++i) {
+		putString(out, data[i].first);
+		putString(out, data[i].second);
+	}
+}
+
+// Reads from a mapped snapshot, never past its end
+struct SnapshotReader {
+	const char* pos;
+	const char* end;
+
+	bool takeBytes(void* data, size_t size) {
+		if (static_cast<size_t>(end - pos) < size) {
+			return false;
+		}
+		std::memcpy(data, pos, size);
+		pos += size;
+		return true;
+	}
+
+	template <typename T>
+	bool take(T& value) {
+		return takeBytes(&value, sizeof(value));
+	}
+
+	bool takeString(std::string& value) {
+		uint32_t size;
+		if (!take(size) || static_cast<size_t>(end - pos) < size) {
+			return false;
+		}
+		value.assign(pos, size);
+		pos += size;
+		return true;
+	}
+};
+
+template <typename Field, typename Stored>
+static bool takeAs(SnapshotReader& reader, Field& field) {
+	Stored value;
+	if (!reader.take(value)) {
+		return false;
+	}
+	field = static_cast<Field>(value);
+	return true;
+}
+
+// The fields encodeSession writes before the record
+static bool takeSessionHead(SnapshotReader& reader, uint64_t key[2], time_t& created_at,
+time_t& last_accessed, int& max_age) {
+	return reader.takeBytes(key, 16) && takeAs<time_t, int64_t>(reader, created_at)
+		&& takeAs<time_t, int64_t>(reader, last_accessed) 
+		&& takeAs<int, int32_t>(reader, max_age);
+}
+
+// The record and, when with_data, the entries; without, they are read past
+static bool takeSessionBody(SnapshotReader& reader, Session& session, bool with_data) {
+	SessionRecord& record = session.getRecord();
+	uint32_t entries = 0;
+	bool complete = takeAs<unsigned int, uint32_t>(reader, record.page_views)
+	&& takeAs<unsigned int, uint32_t>(reader, record.upload_count)
+	&& takeAs<unsigned int, uint32_t>(reader, record.delete_count)
+	&& takeAs<unsigned int, uint32_t>(reader, record.cgi_count)
+	&& takeAs<time_t, int64_t>(reader, record.last_page_time)
+	&& takeAs<time_t, int64_t>(reader, record.last_upload_time)
+	&& takeAs<time_t, int64_t>(reader, record.last_delete_time)
+	&& takeAs<time_t, int64_t>(reader, record.last_cgi_time)
+	&& takeAs<bool, uint8_t>(reader, record.bound)
+	&& reader.take(record.client_ip) && reader.take(record.user_agent_hash)
+	&& reader.takeString(record.last_page) && reader.takeString(record.last_upload)
+	&& reader.takeString(record.last_delete) && reader.takeString(record.last_cgi)
+	&& reader.take(entries);
+	std::string name;
+	std::string value;
+	for (uint32_t i = 0; i < entries && complete; ++i) {
+		complete = reader.takeString(name) && reader.takeString(value);
+		if (complete && with_data) {
+			session.setData(name, value);
+		}
+	}
+	return complete;
+}
+
+static bool writeAll(int fd, const std::string& data) {
+	const char* pos = data.data();
+	size_t size = data.size();
+	while (size > 0) {
+		ssize_t written = write(fd, pos, size);
+		if (written <= 0) {
+			return false;
+		}
+		pos += written;
+		size -= written;
+	}
+	return true;
+}
+
+// Cookie backend: base64url(encodeSession output + HMAC-SHA256 of it). 
+// Returns the payload only if the signature matches
+bool SessionManager::openToken(const std::string& token, std::string& payload) const {
+	std::string bytes;
+	if (token.size() > SESSION_COOKIE_MAX_SIZE || !stringUtils::base64UrlDecode(token, bytes)
+	|| bytes.size() <= 32) {
+		return false;
+	}
+	payload = bytes.substr(0, bytes.size() - 32);
+	return cryptoUtils::constantTimeEquals(bytes.substr(bytes.size() - 32),
+		cryptoUtils::hmacSha256(secret, payload));
+}
+
+// The session a valid, unexpired token carries, held until the next request
+Session* SessionManager::decodeToken(const std::string& token) {
+	std::string payload;
+	if (!openToken(token, payload)) {
+		return NULL;
+	}
+	SnapshotReader reader;
+	reader.pos = payload.data();
+	reader.end = reader.pos + payload.size();
+	uint64_t key[2];
+	time_t created_at;
+	time_t last_accessed;
+	int max_age;
+	if (!takeSessionHead(reader, key, created_at, last_accessed, max_age)) {
+		return NULL;
+	}
+	Session* session = new Session(stringUtils::base64UrlEncode(
+		std::string(reinterpret_cast<char*>(key), 16)));
+	session->setMaxAge(max_age);
+	session->restoreTimes(created_at, last_accessed);
+	if (!takeSessionBody(reader, *session, true) || reader.pos != reader.end
+	|| session->isExpired()) {
+		delete session;
+		return NULL;
+	}
+	holdCookieSession(session, payload);
+	cookie_issued = last_accessed;
+	return session;
+}
+
+void SessionManager::holdCookieSession(Session* session, const std::string& payload) {
+	delete cookie_session;
+	cookie_session = session;
+	cookie_payload = payload;
+}
+
+void SessionManager::clearSessions() {
+	for (size_t i = 0; i < slots.size(); ++i) {
+		delete slots[i].session;
+		slots[i].session = NULL;
+	}
+	count = 0;
+	used_bytes = 0;
+	lru.clear();
+	deadlines.clear();
+}
+
+// Setters
+
+void SessionManager::setConfig(const SessionConfig& sessionConfig) {
+	stateless = sessionConfig.getBackend() == "cookie";
+	secret = sessionConfig.getSecret();
+	max_count = sessionConfig.getMaxCount();
+	max_memory = sessionConfig.getMaxMemory();
+	rateLimiter.setRate(sessionConfig.getCreateRate(), sessionConfig.getCreateWindow());
+	evictOverLimits(0, 0);
 }
 
 // Sessions management
 
+// Whether client_ip may create one more session right now; counts it if so
+bool SessionManager::allowCreation(const std::string& client_ip) {
+	return rateLimiter.allow(inet_addr(client_ip.c_str()));
+}
+
 Session& SessionManager::createSession() {
-	std::string id = generateSessionId();
-	std::pair<std::map<std::string, Session>::iterator, bool> result = 
-		sessions.insert(std::make_pair(id, Session(id)));
-	return result.first->second;
+	uint64_t key[2];
+	std::string id;
+	if (stateless) {
+		holdCookieSession(new Session(generateSessionId(key)), "");
+		return *cookie_session;
+	}
+	do {
+		id = generateSessionId(key);
+	} while (slots[findSlot(key)].session);
+	Session* session = new Session(id);
+	evictOverLimits(1, footprint(*session));
+	if ((count + 1) * 2 > slots.size()) {
+		rehash(slots.size() * 2);
+	}
+	insertSlot(findSlot(key), key, session);
+	compactDeadlines();
+	if (session->getExpiry()) {
+		pushDeadline(session->getExpiry(), key);
+	}
+	return *session;
 }
 
+// A lookup is a use: it keeps the session from eviction
 Session* SessionManager::getSession(const std::string& session_id) {
-	std::map<std::string, Session>::iterator it = sessions.find(session_id);
-	if (it != sessions.end()) {
-		return &it->second;
+	uint64_t key[2];
+	if (stateless) {
+		return decodeToken(session_id);
+	}
+	if (!decodeId(session_id, key)) {
+		return NULL;
+	}
+	size_t index = findSlot(key);
+	if (slots[index].session) {
+		touch(index);
 	}
-	return NULL;
+	return slots[index].session;
 }
 
+// With the cookie backend there is nothing to revoke: a copy of the cookie
+// stays valid until it expires. Only the held session goes
 void SessionManager::destroySession(const std::string& session_id) {
-	sessions.erase(session_id);
+	uint64_t key[2];
+	if (stateless) {
+		if (cookie_session && cookie_session->getSessionId() == session_id) {
+			holdCookieSession(NULL, "");
+		}
+		return;
+	}
+	if (!decodeId(session_id, key)) {
+		return;
+	}
+	size_t index = findSlot(key);
+	if (slots[index].session) {
+		delete slots[index].session;
+		eraseSlot(index);
+	}
+}
+
+// The cookie value to send for session, or "" if the client's current_value
+// still does. A signed cookie is re-sent when the session changed, and when
+// half its max-age has passed, so an active session does not lapse; one 
+// grown past SESSION_COOKIE_MAX_SIZE is not sent at all
+std::string SessionManager::issueCookie(const Session& session, 
+const std::string& current_value) {
+	if (!stateless) {
+		return session.getSessionId() == current_value ? "" : session.getSessionId();
+	}
+	uint64_t key[2];
+	if (!decodeId(session.getSessionId(), key)) {
+		return "";
+	}
+	std::string payload;
+	if (&session == cookie_session && !cookie_payload.empty()) {
+		Session as_signed(session);
+		as_signed.restoreTimes(session.getCreatedAt(), cookie_issued);
+		encodeSession(payload, key, as_signed);
+		if (payload == cookie_payload && (session.getMaxAge() <= 0 
+		|| timeUtils::now() - cookie_issued < session.getMaxAge() / 2)) {
+			return "";
+		}
+		payload.clear();
+	}
+	encodeSession(payload, key, session);
+	std::string token = stringUtils::base64UrlEncode(payload 
+		+ cryptoUtils::hmacSha256(secret, payload));
+	return token.size() <= SESSION_COOKIE_MAX_SIZE ? token : "";
 }
 
-void SessionManager::cleanExpiredSessions() {
-	std::map<std::string, Session>::iterator it = sessions.begin();
-	while (it != sessions.end()) {
-		if (it->second.isExpired()) {
-			sessions.erase(it++);
-		} else {
-			++it;
+// Handles at most max_count due deadlines, so a burst of expiries is spread 
+// over several loop iterations. Entries of destroyed sessions are dropped
+size_t SessionManager::expireSessions(size_t max_count) {
+	time_t now = timeUtils::now();
+	size_t expired = 0;
+	for (size_t handled = 0; handled < max_count && !deadlines.empty() 
+	&& deadlines.front().at <= now; ++handled) {
+		Deadline due = deadlines.front();
+		std::pop_heap(deadlines.begin(), deadlines.end(), isLater);
+		deadlines.pop_back();
+		size_t index = findSlot(due.key);
+		Session* session = slots[index].session;
+		if (!session || !session->getExpiry()) {
+			continue;
 		}
+		if (session->getExpiry() > now) {
+			pushDeadline(session->getExpiry(), due.key);
+			continue;
+		}
+		delete session;
+		eraseSlot(index);
+		++expired;
 	}
+	return expired;
+}
+
+// 0 when no session can expire
+time_t SessionManager::getNextExpiry() const {
+	return deadlines.empty() ? 0 : deadlines.front().at;
+}
+
+// Persistence
+
+// Written beside path, then renamed over it: a reader sees the old snapshot 
+// or the new one, never half of one. Least recently used first, so loading
+// restores the recency order. The ids are taken now and the sessions read as
+// their batch comes: one destroyed meanwhile is left out, one used meanwhile
+// is saved as it is then. A snapshot in progress is dropped
+bool SessionManager::beginSnapshot(const std::string& path) {
+	abortSnapshot();
+	snapshot_path = path;
+	snapshot_fd = open((path + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (snapshot_fd < 0) {
+		return false;
+	}
+	snapshot_order.assign(lru.rbegin(), lru.rend());
+	snapshot_next = 0;
+	snapshot_count = 0;
+	// The record count is filled in by finishSnapshot
+	snapshot_buffer.assign("WSSNAP01", 8);
+	put<uint64_t>(snapshot_buffer, 0);
+	return true;
+}
+
+// Up to max_count sessions more; false once the snapshot is over, renamed 
+// into place or dropped on a write error
+bool SessionManager::continueSnapshot(size_t max_count) {
+	if (snapshot_fd < 0) {
+		return false;
+	}
+	if (!writeSnapshotBatch(max_count)) {
+		abortSnapshot();
+		return false;
+	}
+	if (snapshot_next < snapshot_order.size()) {
+		return true;
+	}
+	finishSnapshot();
+	return false;
+}
+
+bool SessionManager::isSnapshotting() const {
+	return snapshot_fd >= 0;
+}
+
+// All at once, for shutdown
+bool SessionManager::writeSnapshot(const std::string& path) {
+	if (!beginSnapshot(path)) {
+		return false;
+	}
+	if (!writeSnapshotBatch(snapshot_order.size())) {
+		abortSnapshot();
+		return false;
+	}
+	return finishSnapshot();
+}
+
+// Full buffers are handed to the kernel with their writeback started, so 
+// the final fsync finds little left to flush
+bool SessionManager::writeSnapshotBatch(size_t max_count) {
+	for (size_t handled = 0; handled < max_count 
+	&& snapshot_next < snapshot_order.size(); ++handled) {
+		const LruEntry& entry = snapshot_order[snapshot_next++];
+		const Session* session = slots[findSlot(entry.key)].session;
+		if (!session) {
+			continue;
+		}
+		encodeSession(snapshot_buffer, entry.key, *session);
+		++snapshot_count;
+		if (snapshot_buffer.size() >= SESSION_SNAPSHOT_BUFFER_SIZE) {
+			if (!writeAll(snapshot_fd, snapshot_buffer)) {
+				return false;
+			}
+			snapshot_buffer.clear();
+			sync_file_range(snapshot_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+		}
+	}
+	return true;
+}
+
+bool SessionManager::finishSnapshot() {
+	std::string tmp_path = snapshot_path + ".tmp";
+	bool written = writeAll(snapshot_fd, snapshot_buffer)
+		&& pwrite(snapshot_fd, &snapshot_count, sizeof(snapshot_count), 8) 
+			== static_cast<ssize_t>(sizeof(snapshot_count))
+		&& fsync(snapshot_fd) == 0;
+	written = close(snapshot_fd) == 0 && written 
+		&& std::rename(tmp_path.c_str(), snapshot_path.c_str()) == 0;
+	snapshot_fd = -1;
+	if (!written) {
+		unlink(tmp_path.c_str());
+	}
+	// Only the state is left to drop
+	abortSnapshot();
+	return written;
+}
+
+void SessionManager::abortSnapshot() {
+	if (snapshot_fd >= 0) {
+		close(snapshot_fd);
+		snapshot_fd = -1;
+		unlink((snapshot_path + ".tmp").c_str());
+	}
+	std::vector<LruEntry>().swap(snapshot_order);
+	std::string().swap(snapshot_buffer);
+	snapshot_next = 0;
+}
+
+// Sessions that expired meanwhile are skipped, and so is the rest of a 
+// damaged file. Returns how many sessions came back
+size_t SessionManager::loadSnapshot(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
+	}
+	struct stat info;
+	if (fstat(fd, &info) < 0 || info.st_size < 16) {
+		close(fd);
+		return 0;
+	}
+	// Read in one pass: prefaulted, rather than a page fault every 4K
+	void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return 0;
+	}
+	SnapshotReader reader;
+	reader.pos = static_cast<const char*>(map);
+	reader.end = reader.pos + info.st_size;
+	char magic[8];
+	uint64_t total = 0;
+	reader.takeBytes(magic, sizeof(magic));
+	reader.take(total);
+	if (std::memcmp(magic, "WSSNAP01", 8) != 0) {
+		munmap(map, info.st_size);
+		return 0;
+	}
+	// A record takes at least 100 bytes: a bogus count cannot blow the table up
+	if (total > static_cast<uint64_t>(info.st_size) / 100) {
+		total = info.st_size / 100;
+	}
+	reserve(count + total);
+	time_t now = timeUtils::now();
+	size_t loaded = 0;
+	size_t heap_size = deadlines.size();
+	Session scratch("");
+	for (uint64_t n = 0; n < total; ++n) {
+		uint64_t key[2];
+		time_t created_at;
+		time_t last_accessed;
+		int max_age;
+		if (!takeSessionHead(reader, key, created_at, last_accessed, max_age)) {
+			break;
+		}
+		// Skipped sessions are still read through, into scratch
+		bool expired = max_age > 0 && last_accessed + max_age + 1 <= now;
+		size_t index = findSlot(key);
+		bool keep = !expired && !slots[index].session;
+		Session* session = keep ? new Session(stringUtils::base64UrlEncode(
+			std::string(reinterpret_cast<char*>(key), 16))) : &scratch;
+		if (!takeSessionBody(reader, *session, keep)) {
+			if (keep) {
+				delete session;
+			}
+			break;
+		}
+		if (!keep) {
+			continue;
+		}
+		session->setMaxAge(max_age);
+		session->restoreTimes(created_at, last_accessed);
+		insertSlot(index, key, session);
+		++loaded;
+		if (session->getExpiry()) {
+			Deadline deadline;
+			deadline.at = session->getExpiry();
+			deadline.key[0] = key[0];
+			deadline.key[1] = key[1];
+			deadlines.push_back(deadline);
+		}
+	}
+	munmap(map, info.st_size);
+	// One heapify for everything loaded, not a sift per session
+	if (deadlines.size() != heap_size) {
+		std::make_heap(deadlines.begin(), deadlines.end(), isLater);
+	}
+	// Under tighter caps than when saved: the oldest go first
+	evictOverLimits(0, 0);
+	return loaded;
 }
 
 // Utility
 
 bool SessionManager::sessionExists(const std::string& session_id) const {
-	return sessions.find(session_id) != sessions.end();
+	uint64_t key[2];
+	std::string payload;
+	if (stateless) {
+		return openToken(session_id, payload);
+	}
+	return decodeId(session_id, key) && slots[findSlot(key)].session;
 }
 
 size_t SessionManager::getSessionCount() const {
-	return sessions.size();
+	return count;
+}
+
+size_t SessionManager::getMemoryUsage() const {
+	return used_bytes;
 }
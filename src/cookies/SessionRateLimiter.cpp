@@ -0,0 +1,91 @@
+#include "SessionRateLimiter.hpp"
+#include <sstream>
+
+// Other includes
+#include "timeUtils.hpp"
+#include "constants.hpp"
+
+SessionRateLimiter::SessionRateLimiter() :
+	limit(0),
+	window(60)
+{}
+
+SessionRateLimiter::SessionRateLimiter(const SessionRateLimiter& other) :
+	buckets(other.buckets),
+	limit(other.limit),
+	window(other.window)
+{}
+
+SessionRateLimiter& SessionRateLimiter::operator=(const SessionRateLimiter& other) {
+	if (this != &other) {
+		buckets = other.buckets;
+		limit = other.limit;
+		window = other.window;
+	}
+	return *this;
+}
+
+SessionRateLimiter::~SessionRateLimiter() {}
+
+// Debug
+
+std::string SessionRateLimiter::toString() const {
+	std::ostringstream oss;
+
+	oss << "SessionRateLimiter instance" << std::endl;
+	oss << "limit: " << limit << " per " << window << "s" << std::endl;
+	oss << "buckets: " << buckets.size() << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const SessionRateLimiter& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Setters
+
+// The table is only allocated once there is something to limit
+void SessionRateLimiter::setRate(unsigned int limit, int window) {
+	this->limit = limit;
+	this->window = window;
+	buckets.assign(limit ? SESSION_RATE_TABLE_SIZE : 0, Bucket());
+}
+
+// Core functionality
+
+bool SessionRateLimiter::allow(uint32_t ip) {
+	if (!limit) {
+		return true;
+	}
+	time_t now = timeUtils::now();
+	size_t mask = buckets.size() - 1;
+	// Addresses of one network differ in few bits: spread them first
+	size_t home = (ip * 2654435761u) & mask;
+	Bucket* victim = NULL;
+	bool victim_over = false;
+	for (size_t i = 0; i < SESSION_RATE_PROBE; ++i) {
+		Bucket& bucket = buckets[(home + i) & mask];
+		bool over = bucket.count == 0 || now - bucket.window_start >= window;
+		if (bucket.count && bucket.ip == ip) {
+			if (over) {
+				bucket.window_start = now;
+				bucket.count = 0;
+			}
+			if (bucket.count >= limit) {
+				return false;
+			}
+			++bucket.count;
+			return true;
+		}
+		if (!victim_over && (over || !victim 
+		|| bucket.window_start < victim->window_start)) {
+			victim = &bucket;
+			victim_over = over;
+		}
+	}
+	victim->ip = ip;
+	victim->count = 1;
+	victim->window_start = now;
+	return true;
+}
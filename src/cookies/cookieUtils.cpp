@@ -1,13 +1,23 @@
 #include "cookieUtils.hpp"
 
 // Other includes
-#include <cstdlib>
-#include "stringUtils.hpp"
+#include <sstream>
+#include <arpa/inet.h> // inet_addr
+#include "timeUtils.hpp"
 
 namespace cookieUtils {
 
+	// NULL when the client already created its share of sessions: the request
+	// is still served, only without one. The cookie is set by commitSession
+	Session* startSession(const HttpRequest& httpRequest, SessionManager& sessionManager) {
+		if (!sessionManager.allowCreation(httpRequest.getClientRemoteAddr())) {
+			return NULL;
+		}
+		return &sessionManager.createSession();
+	}
+
 	Session* getOrCreateSession(const HttpRequest& httpRequest, 
-	SessionManager& sessionManager, HttpResponse& httpResponse) {
+	SessionManager& sessionManager) {
 		std::string session_id = httpRequest.getCookieValue("WEBSERV_SESSION");
 		if (!session_id.empty()) {
 			Session* session = sessionManager.getSession(session_id);
@@ -19,93 +29,150 @@ namespace cookieUtils {
 				sessionManager.destroySession(session_id);
 			}
 		}
-		Session& new_session = sessionManager.createSession();
-		httpResponse.setCookie("WEBSERV_SESSION", new_session.getSessionId(), 
-				3600, "/");
-		return &new_session;
+		return startSession(httpRequest, sessionManager);
+	}
+
+	// Per the location's session directive: "off" skips the lookup, "on" 
+	// creates a session right away, "lazy" hands out pending, a stand-in 
+	// that commitSession turns into a real session once something is written
+	Session* openSession(const HttpRequest& httpRequest, 
+	const LocationConfig* locationConfig, SessionManager& sessionManager, 
+	HttpResponse& httpResponse, Session& pending) {
+		const std::string mode = locationConfig ? locationConfig->getSession() : "on";
+		if (mode == "off") {
+			return NULL;
+		}
+		Session* session = NULL;
+		if (mode == "on") {
+			session = getOrCreateSession(httpRequest, sessionManager);
+		} else {
+			std::string session_id = httpRequest.getCookieValue("WEBSERV_SESSION");
+			session = session_id.empty() ? NULL : sessionManager.getSession(session_id);
+			if (session && session->isExpired()) {
+				sessionManager.destroySession(session_id);
+				session = NULL;
+			}
+			if (session) {
+				session->updateLastAccessed();
+			}
+		}
+		if (session && !validateSessionUser(session, httpRequest)) {
+			sessionManager.destroySession(session->getSessionId());
+			httpResponse.expireCookie("WEBSERV_SESSION");
+			session = mode == "on" 
+				? startSession(httpRequest, sessionManager) : NULL;
+		}
+		return session ? session : (mode == "lazy" ? &pending : NULL);
+	}
+
+	// Counting a page view is no write: assets alone never create a session.
+	// Sets the cookie whenever its value is not the client's already
+	void commitSession(const HttpRequest& httpRequest, SessionManager& sessionManager, 
+	HttpResponse& httpResponse, Session* session, const Session& pending) {
+		if (session == &pending) {
+			session = pending.isChanged() ? startSession(httpRequest, sessionManager) : NULL;
+			if (!session) {
+				return;
+			}
+			session->getRecord() = pending.getRecord();
+			const std::vector<std::pair<std::string, std::string> >& data = pending.getDataEntries();
+			for (size_t i = 0; i < data.size(); ++i) {
+				session->setData(data[i].first, data[i].second);
+			}
+			validateSessionUser(session, httpRequest);
+		}
+		if (!session) {
+			return;
+		}
+		std::string value = sessionManager.issueCookie(*session, 
+			httpRequest.getCookieValue("WEBSERV_SESSION"));
+		if (!value.empty()) {
+			httpResponse.setCookie("WEBSERV_SESSION", value, 3600, "/");
+		}
 	}
 
 	void trackPageView(Session* session, const std::string& resource_path) {
 		if (!session) {
 			return;
 		}
-		std::string page_views = session->getData("page_views");
-		int views = page_views.empty() ? 0 : std::atoi(page_views.c_str());
-		views++;
-		session->setData("page_views", stringUtils::toString(views));
-		session->setData("last_page", resource_path);
-		session->setData("last_visit", stringUtils::toString(time(NULL)));
+		SessionRecord& record = session->getRecord();
+		++record.page_views;
+		record.last_page = resource_path;
+		record.last_page_time = timeUtils::now();
 	}
 
 	void trackFileUpload(Session* session, const std::string& filename) {
 		if (!session) {
 			return;
 		}
-		std::string upload_count = session->getData("upload_count");
-		int count = upload_count.empty() ? 0 : std::atoi(upload_count.c_str());
-		count++;
-		session->setData("upload_count", stringUtils::toString(count));
-		session->setData("last_upload", filename);
-		session->setData("last_upload_time", stringUtils::toString(time(NULL)));
+		session->markChanged();
+		SessionRecord& record = session->getRecord();
+		++record.upload_count;
+		record.last_upload = filename;
+		record.last_upload_time = timeUtils::now();
 	}
 
 	void trackFileDelete(Session* session, const std::string& resource_path) {
 		if (!session) {
 			return;
 		}
-		std::string delete_count = session->getData("delete_count");
-		int count = delete_count.empty() ? 0 : std::atoi(delete_count.c_str());
-		count++;
-		session->setData("delete_count", stringUtils::toString(count));
-		session->setData("last_delete", resource_path);
-		session->setData("last_delete_time", stringUtils::toString(time(NULL)));
+		session->markChanged();
+		SessionRecord& record = session->getRecord();
+		++record.delete_count;
+		record.last_delete = resource_path;
+		record.last_delete_time = timeUtils::now();
 	}
 
 	void trackCgiExecution(Session* session, const std::string& script_path) {
 		if (!session) {
 			return;
 		}
-		std::string cgi_count = session->getData("cgi_count");
-		int count = cgi_count.empty() ? 0 : std::atoi(cgi_count.c_str());
-		count++;
-		session->setData("cgi_count", stringUtils::toString(count));
-		session->setData("last_cgi", script_path);
-		session->setData("last_cgi_time", stringUtils::toString(time(NULL)));
+		session->markChanged();
+		SessionRecord& record = session->getRecord();
+		++record.cgi_count;
+		record.last_cgi = script_path;
+		record.last_cgi_time = timeUtils::now();
+	}
+
+	// 0 stands for no User-Agent at all
+	static uint64_t hashUserAgent(const std::string& user_agent) {
+		if (user_agent.empty()) {
+			return 0;
+		}
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < user_agent.size(); ++i) {
+			hash ^= static_cast<unsigned char>(user_agent[i]);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
 	}
 
+	// The first request binds the session to its client: IP and User-Agent
 	bool validateSessionUser(Session* session, const HttpRequest& HttpRequest) {
 		if (!session) {
 			return false;
 		}
-		std::string current_ip = HttpRequest.getClientRemoteAddr();
-		std::string current_ua = HttpRequest.getHeader("User-Agent");
-		std::string stored_ip = session->getData("client_ip");
-		std::string stored_ua = session->getData("user_agent");
-		if (stored_ip.empty()) {
-			session->setData("client_ip", current_ip);
-			session->setData("user_agent", current_ua);
+		SessionRecord& record = session->getRecord();
+		uint32_t current_ip = inet_addr(HttpRequest.getClientRemoteAddr().c_str());
+		uint64_t current_ua = hashUserAgent(HttpRequest.getHeader("User-Agent"));
+		if (!record.bound) {
+			record.bound = true;
+			record.client_ip = current_ip;
+			record.user_agent_hash = current_ua;
 			return true;
 		}
-		if (stored_ip != current_ip) {
-			return false;
-		}
-		if (!stored_ua.empty() && stored_ua != current_ua) {
-			return false;
-		}
-		return true;
+		return record.client_ip == current_ip 
+			&& (record.user_agent_hash == 0 || record.user_agent_hash == current_ua);
 	}
 
-	static std::string formatTimestamp(const std::string& timestamp_str) {
-		if (timestamp_str.empty()) {
-			return "never";
-		}
-		time_t timestamp = std::atoi(timestamp_str.c_str());
+	static std::string formatTimestamp(time_t timestamp) {
 		if (timestamp == 0) {
 			return "never";
 		}
-		struct tm* timeinfo = std::localtime(&timestamp);
+		struct tm timeinfo;
+		localtime_r(&timestamp, &timeinfo);
 		char buffer[20];
-		std::strftime(buffer, sizeof(buffer), "%H:%M:%S", timeinfo);
+		std::strftime(buffer, sizeof(buffer), "%H:%M:%S", &timeinfo);
 		return std::string(buffer);
 	}
 
@@ -144,51 +211,21 @@ namespace cookieUtils {
 			"\"last_page_name\":\"-\",\"last_upload_file\":\"-\","
 			"\"last_delete_file\":\"-\",\"last_cgi_script\":\"-\"}";
 		}
-		
-		std::string page_views = session->getData("page_views");
-		std::string upload_count = session->getData("upload_count");
-		std::string delete_count = session->getData("delete_count");
-		std::string cgi_count = session->getData("cgi_count");
-		
-		std::string last_page_time = session->getData("last_visit");
-		std::string last_upload_time = session->getData("last_upload_time");
-		std::string last_delete_time = session->getData("last_delete_time");
-		std::string last_cgi_time = session->getData("last_cgi_time");
-		
-		std::string last_page_name = session->getData("last_page");
-		std::string last_upload_file = session->getData("last_upload");
-		std::string last_delete_file = session->getData("last_delete");
-		std::string last_cgi_script = session->getData("last_cgi");
-		
-		int views = page_views.empty() ? 0 : std::atoi(page_views.c_str());
-		int uploads = upload_count.empty() ? 0 : std::atoi(upload_count.c_str());
-		int deletes = delete_count.empty() ? 0 : std::atoi(delete_count.c_str());
-		int cgis = cgi_count.empty() ? 0 : std::atoi(cgi_count.c_str());
-		
-		std::string last_page_formatted = formatTimestamp(last_page_time);
-		std::string last_upload_formatted = formatTimestamp(last_upload_time);
-		std::string last_delete_formatted = formatTimestamp(last_delete_time);
-		std::string last_cgi_formatted = formatTimestamp(last_cgi_time);
-		
-		std::string page_display = formatPathForDisplay(last_page_name);
-		std::string upload_display = formatFileForDisplay(last_upload_file);
-		std::string delete_display = formatFileForDisplay(last_delete_file);
-		std::string cgi_display = formatPathForDisplay(last_cgi_script);
-		
+		const SessionRecord& record = session->getRecord();
 		std::ostringstream json;
 		json << "{"
-			<< "\"page_views\":" << views << ","
-			<< "\"upload_count\":" << uploads << ","
-			<< "\"delete_count\":" << deletes << ","
-			<< "\"cgi_count\":" << cgis << ","
-			<< "\"last_page_view\":\"" << last_page_formatted << "\","
-			<< "\"last_upload\":\"" << last_upload_formatted << "\","
-			<< "\"last_delete\":\"" << last_delete_formatted << "\","
-			<< "\"last_cgi\":\"" << last_cgi_formatted << "\","
-			<< "\"last_page_name\":\"" << page_display << "\","
-			<< "\"last_upload_file\":\"" << upload_display << "\","
-			<< "\"last_delete_file\":\"" << delete_display << "\","
-			<< "\"last_cgi_script\":\"" << cgi_display << "\""
+			<< "\"page_views\":" << record.page_views << ","
+			<< "\"upload_count\":" << record.upload_count << ","
+			<< "\"delete_count\":" << record.delete_count << ","
+			<< "\"cgi_count\":" << record.cgi_count << ","
+			<< "\"last_page_view\":\"" << formatTimestamp(record.last_page_time) << "\","
+			<< "\"last_upload\":\"" << formatTimestamp(record.last_upload_time) << "\","
+			<< "\"last_delete\":\"" << formatTimestamp(record.last_delete_time) << "\","
+			<< "\"last_cgi\":\"" << formatTimestamp(record.last_cgi_time) << "\","
+			<< "\"last_page_name\":\"" << formatPathForDisplay(record.last_page) << "\","
+			<< "\"last_upload_file\":\"" << formatFileForDisplay(record.last_upload) << "\","
+			<< "\"last_delete_file\":\"" << formatFileForDisplay(record.last_delete) << "\","
+			<< "\"last_cgi_script\":\"" << formatPathForDisplay(record.last_cgi) << "\""
 			<< "}";
 		
 		return json.str();
@@ -0,0 +1,130 @@
+#include "Compressor.hpp"
+#include <sstream>
+
+// Other includes
+#include <cstring> // memset
+
+Compressor::Compressor() :
+	active(false),
+	level(Z_DEFAULT_COMPRESSION)
+{
+	std::memset(&stream, 0, sizeof(stream));
+}
+
+Compressor::Compressor(const Compressor& other) :
+	active(false),
+	coding(other.coding),
+	level(other.level)
+{
+	std::memset(&stream, 0, sizeof(stream));
+	if (other.active && deflateCopy(&stream,
+	const_cast<z_stream*>(&other.stream)) == Z_OK) {
+		active = true;
+	}
+}
+
+Compressor& Compressor::operator=(const Compressor& other) {
+	if (this != &other) {
+		end();
+		coding = other.coding;
+		level = other.level;
+		if (other.active && deflateCopy(&stream,
+		const_cast<z_stream*>(&other.stream)) == Z_OK) {
+			active = true;
+		}
+	}
+	return *this;
+}
+
+Compressor::~Compressor() {
+	end();
+}
+
+// Debug
+
+std::string Compressor::toString() const {
+	std::ostringstream oss;
+
+	oss << "Compressor instance" << std::endl;
+	oss << "active: " << (active ? "true" : "false")
+		<< ", coding: " << coding << ", level: " << level << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const Compressor& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Getters
+
+bool Compressor::isActive() const {
+	return active;
+}
+
+const std::string& Compressor::getCoding() const {
+	return coding;
+}
+
+// Core functionality
+
+bool Compressor::start(const std::string& coding, int level) {
+	end();
+	// 15 = 32K window, +16 asks zlib for a gzip wrapper instead of a zlib one
+	int window_bits = (coding == "gzip") ? 15 + 16 : 15;
+	std::memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, level, Z_DEFLATED, window_bits, 8,
+	Z_DEFAULT_STRATEGY) != Z_OK) {
+		return false;
+	}
+	this->coding = coding;
+	this->level = level;
+	active = true;
+	return true;
+}
+
+bool Compressor::compress(const char* data, size_t size, std::string& out,
+bool finish) {
+	if (!active) {
+		return false;
+	}
+	char buffer[16384];
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+	stream.avail_in = static_cast<uInt>(size);
+	int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+	int ret;
+	do {
+		stream.next_out = reinterpret_cast<Bytef*>(buffer);
+		stream.avail_out = sizeof(buffer);
+		ret = deflate(&stream, flush);
+		if (ret == Z_STREAM_ERROR) {
+			end();
+			return false;
+		}
+		out.append(buffer, sizeof(buffer) - stream.avail_out);
+	} while (stream.avail_out == 0 || (finish && ret != Z_STREAM_END));
+	if (finish) {
+		end();
+	}
+	return true;
+}
+
+void Compressor::end() {
+	if (active) {
+		deflateEnd(&stream);
+		active = false;
+	}
+}
+
+// One-shot helper for bodies already held in memory
+
+bool Compressor::compressString(const std::string& coding, int level,
+const std::string& in, std::string& out) {
+	Compressor compressor;
+	if (!compressor.start(coding, level)) {
+		return false;
+	}
+	out.clear();
+	out.reserve(in.size() / 2);
+	return compressor.compress(in.data(), in.size(), out, true);
+}
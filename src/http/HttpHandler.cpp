@@ -10,55 +10,34 @@
 #include <ctime>   // for time()
 #include "LocationConfig.hpp"
 #include "CgiHandler.hpp"
-#include <dirent.h> // DIR
-#include <iomanip> // setprecision()
 #include <sys/stat.h> // struct stat
 #include <map>
 #include "cookieUtils.hpp"
+#include "statCache.hpp"
+#include "httpCompression.hpp"
+#include "timeUtils.hpp"
+#include "constants.hpp"
+#include "errorResponses.hpp"
+#include "responseCache.hpp"
+#include "autoindex.hpp"
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
 
 namespace httpHandler {
 
-	static bool findCustomErrorPage(int error_code, const ServerConfig& serverConfig, 
-	const LocationConfig* locationConfig, std::string& errorContent) {
-		if (locationConfig) {
-			const std::map<int, std::string>& locErrorPages = locationConfig->getErrorPages();
-			std::map<int, std::string>::const_iterator it = locErrorPages.find(error_code);
-			if (it != locErrorPages.end() && fileUtils::isFileExisting("www" + it->second)) {
-				fileUtils::extractFileInString("www" + it->second, errorContent);
-				return true;
-			}
-		}
-		const std::map<int, std::string>& srvErrorPages = serverConfig.getErrorPages();
-		std::map<int, std::string>::const_iterator it = srvErrorPages.find(error_code);
-		if (it != srvErrorPages.end() && fileUtils::isFileExisting("www" + it->second)) {
-			fileUtils::extractFileInString("www" + it->second, errorContent);
-			return true;
-		}
-		return false;
-	}
-
+	// Location error_page, then server error_page, then the built-in page; all 
+	// of them were serialized at config load so nothing touches the disk here
 	void handleError(int error_code, const ServerConfig& serverConfig, 
 	const LocationConfig* locationConfig, HttpResponse& httpResponse) {
-		std::string errorContent;
-		if (error_code == 400)
-			httpResponse.buildBadRequest();
-		else if (error_code == 403)
-			httpResponse.buildForbidden();
-		else if (error_code == 404)
-			httpResponse.buildNotFound();
-		else if (error_code == 405)
-			httpResponse.buildMethodNotAllowed();
-		else if (error_code == 413)
-			httpResponse.buildPayloadTooLarge();
-		else
-			httpResponse.buildInternalServerError();
-		if (findCustomErrorPage(error_code, serverConfig, locationConfig, 
-		errorContent)) {
-			httpResponse.setVersion("HTTP/1.1");
-			httpResponse.setStatusCode(error_code);
-			httpResponse.setBody(errorContent);
-			httpResponse.setHeader("Content-Type", "text/html");
+		const PrebuiltResponse* response = NULL;
+		if (locationConfig) {
+			response = locationConfig->findErrorResponse(error_code);
+		}
+		if (!response) {
+			response = serverConfig.findErrorResponse(error_code);
 		}
+		httpResponse.setPrebuilt(response ? *response 
+			: errorResponses::getDefault(error_code));
 	}
 
 	static void handleDeleteRequest(const std::string& resource_path, 
@@ -73,6 +52,7 @@ namespace httpHandler {
 			handleError(500, serverConfig, locationConfig, httpResponse);
 			return;
 		}
+		statCache::invalidate(resource_path);
 		cookieUtils::trackFileDelete(session, resource_path);
 		httpResponse.buildNoContent();
 	}
@@ -90,10 +70,12 @@ namespace httpHandler {
 		// Create file
 		std::string file_body = httpUtils::extractFileContentFromMultipartBody(body);
 		if (!fileUtils::writeStringToFile(filepath, file_body)) {
-			std::cerr << "[info] This webserv only handles file uploads" << std::endl;
+			std::cerr << timeUtils::logTimestamp() 
+				<< " [info] This webserv only handles file uploads" << std::endl;
 			handleError(500, serverConfig, locationConfig, httpResponse);
 			return;
 		}
+		statCache::invalidate(filepath);
 		cookieUtils::trackFileUpload(session, filename);
 		httpResponse.buildCreated();
 	}
@@ -114,53 +96,35 @@ namespace httpHandler {
 		handleError(400, serverConfig, locationConfig, httpResponse);
 	}
 
-	std::string generateAutoindexHtml(const std::string& resource_path) {
-		DIR* dir = opendir(resource_path.c_str());
-		if (!dir) {
-			return "<html><body><h1>Cannot open directory</h1></body></html>";
+	static bool serveStaticFile(const std::string& path, const FileInfo& fileInfo, 
+	const std::string& mime, const HttpRequest& httpRequest, HttpResponse& httpResponse) {
+		// Revalidation is answered from cached stat data, the file is never read
+		if (httpUtils::checkNotModified(httpRequest, fileInfo)) {
+			httpResponse.buildNotModified();
+			httpResponse.setHeader("ETag", fileInfo.etag);
+			httpResponse.setHeader("Last-Modified", fileInfo.last_modified);
+			return true;
 		}
-		std::ostringstream html;
-		html << "<html><head><title>Index of " << resource_path 
-			<< "</title></head><body>";
-		html << "<h1>Index of " << resource_path << "</h1><ul>";
-		struct dirent* entry;
-		while ((entry = readdir(dir)) != NULL) {
-			std::string name = entry->d_name;
-			if (name == "." || name == "..") {
-				continue;
-			}
-			html << "<li><a href=\"" << name << "\">" << name << "</a>";
-			// Show size and date
-			std::string full_path = resource_path;
-			if (full_path[full_path.size() - 1] != '/') {
-				full_path += "/";
+		// The file is not read here: the connection streams it from the fd
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0) {
+				close(fd);
 			}
-			full_path += name;
-			struct stat st;
-			if (stat(full_path.c_str(), &st) == 0) {
-				html << " &nbsp; ";
-				if (S_ISDIR(st.st_mode)) {
-					html << "[DIR]";
-				} else {
-					html << std::fixed << std::setprecision(0) 
-						<< st.st_size << " bytes";
-				}
-				html << " &nbsp; ";
-				char timebuf[32];
-				std::strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M", 
-					std::localtime(&st.st_mtime));
-				html << timebuf;
-			}
-			html << "</li>";
+			return false;
 		}
-		closedir(dir);
-		html << "</ul></body></html>";
-		return html.str();
+		httpResponse.buildOk("", mime);
+		httpResponse.setBodyFile(fd, static_cast<size_t>(st.st_size));
+		httpResponse.setHeader("ETag", fileInfo.etag);
+		httpResponse.setHeader("Last-Modified", fileInfo.last_modified);
+		return true;
 	}
 
 	static void handleGetRequest(const std::string& resource_path, 
-	HttpResponse& httpResponse, const LocationConfig* locationConfig, 
-	const ServerConfig& serverConfig, Session* session) {
+	const HttpRequest& httpRequest, HttpResponse& httpResponse, 
+	const LocationConfig* locationConfig, const ServerConfig& serverConfig, 
+	Session* session) {
 		cookieUtils::trackPageView(session, resource_path);
 		if (resource_path.find("/api/session-stats") != std::string::npos) {
 			std::string stats_json = cookieUtils::getSessionStatsJson(session);
@@ -168,47 +132,67 @@ namespace httpHandler {
 			httpResponse.buildOk(stats_json, "application/json");
 			return;
 		}
-		if (fileUtils::isDirectory(resource_path)) {
+		const FileInfo fileInfo = statCache::lookup(resource_path);
+		if (fileInfo.is_dir) {
 			if (locationConfig && locationConfig->isAutoindexOn()) {
-				std::string listing = generateAutoindexHtml(resource_path);
-				httpResponse.buildOk(listing, "text/html");
+				if (!autoindex::serve(resource_path, 
+				locationConfig->getAutoindexFormat(), httpResponse)) {
+					handleError(500, serverConfig, locationConfig, httpResponse);
+				}
 				return;
 			} else {
 				handleError(403, serverConfig, locationConfig, httpResponse);
 				return;
 			}
 		}
-		if (!fileUtils::isFileExisting(resource_path)) {
+		std::string mime = httpUtils::getMimeType(resource_path);
+		// Precompressed sibling, its existence check is served by the stat cache.
+		// With one, the response depends on Accept-Encoding either way
+		bool has_gz_sibling = false;
+		if (locationConfig && locationConfig->isGzipStaticOn()) {
+			const std::string gz_path = resource_path + ".gz";
+			const FileInfo gzInfo = statCache::lookup(gz_path);
+			has_gz_sibling = gzInfo.exists && !gzInfo.is_dir;
+			if (has_gz_sibling 
+			&& httpCompression::acceptsCoding(httpRequest.getHeader("Accept-Encoding"), "gzip")
+			&& serveStaticFile(gz_path, gzInfo, mime, httpRequest, httpResponse)) {
+				httpResponse.setHeader("Content-Encoding", "gzip");
+				httpResponse.setHeader("Vary", "Accept-Encoding");
+				return;
+			}
+		}
+		if (!fileInfo.exists) {
 			handleError(404, serverConfig, locationConfig, httpResponse);
 			return;
 		}
-		std::string content;
-		if (!fileUtils::extractFileInString(resource_path, content)) {
+		if (!serveStaticFile(resource_path, fileInfo, mime, httpRequest, httpResponse)) {
 			handleError(500, serverConfig, locationConfig, httpResponse);
 			return;
 		}
-		std::string mime = httpUtils::getMimeType(resource_path);
-		httpResponse.buildOk(content, mime);
+		// Identity beside a gzip_static sibling, or a 304 compressResponse leaves
+		// alone: either still says what the response varies on
+		if (has_gz_sibling || (httpResponse.getStatusCode() == 304 
+		&& httpCompression::variesByEncoding(serverConfig, locationConfig, mime, 
+		static_cast<size_t>(fileInfo.size)))) {
+			httpResponse.setHeader("Vary", "Accept-Encoding");
+		}
 	}
 
 	static void handleCgiRequest(const ServerConfig& serverConfig, 
 	const LocationConfig* locationConfig, const HttpRequest& httpRequest, 
 	HttpResponse& httpResponse, const std::string& script_path, 
 	const std::string& cgiBin, Session* session, const std::string& path_info) {
-		CgiHandler cgi(script_path, cgiBin, httpRequest, serverConfig, path_info);
-		if (cgi.execute(httpResponse)) {
-			cookieUtils::trackCgiExecution(session, script_path);
-			return;
-		} else {
-			if (httpResponse.getStatusCode() != 504) {
-				handleError(500, serverConfig, locationConfig, httpResponse);
-			}
-		}
+		// The script runs alongside other connections; the event loop owns it 
+		// now, and starts it once cgi_max_processes leaves room
+		CgiHandler* cgi = new CgiHandler(script_path, cgiBin, httpRequest, 
+			serverConfig, locationConfig, path_info);
+		cookieUtils::trackCgiExecution(session, script_path);
+		httpResponse.setCgi(cgi);
 	}
 
 	static bool checkConfig(const ServerConfig& serverConfig, 
 	const LocationConfig* locationConfig, const HttpRequest& httpRequest, 
-	HttpResponse& httpResponse, const std::string& resource_path, Session* session) {
+	HttpResponse& httpResponse) {
 		if (!httpUtils::checkMethodAllowed(serverConfig, locationConfig, httpRequest)) {
 			handleError(405, serverConfig, locationConfig, httpResponse);
 			return false;
@@ -222,6 +206,14 @@ namespace httpHandler {
 				locationConfig->getReturnTarget());
 			return false;
 		}
+		return true;
+	}
+
+	// True when the request is for a script: it is then handed over, or 
+	// refused for its method
+	static bool dispatchCgiRequest(const ServerConfig& serverConfig, 
+	const LocationConfig* locationConfig, const HttpRequest& httpRequest, 
+	HttpResponse& httpResponse, const std::string& resource_path, Session* session) {
 		std::string cgi_ext = locationConfig ? locationConfig->getCgiExtension() : "";
 		std::string cgi_bin = locationConfig ? locationConfig->getCgiPath() : "";
 		std::string path_info = httpUtils::extractCgiPathInfo(httpRequest.getPath(), cgi_ext);
@@ -233,44 +225,133 @@ namespace httpHandler {
 			}
 			handleCgiRequest(serverConfig, locationConfig, httpRequest, 
 				httpResponse, script_path, cgi_bin, session, path_info);
+			return true;
+		}
+		return false;
+	}
+
+	// Responses shared between clients must not depend on who asks: a 
+	// request carrying a session (which scripts also see, in HTTP_COOKIE) and 
+	// the session stats always go through
+	static bool isCacheable(const HttpRequest& httpRequest, 
+	const LocationConfig* locationConfig, const std::string& resource_path) {
+		return locationConfig && locationConfig->isResponseCacheOn() 
+			&& httpRequest.getMethod() == "GET"
+			&& !httpRequest.hasCookie("WEBSERV_SESSION")
+			&& resource_path.find("/api/session-stats") == std::string::npos;
+	}
+
+	// Last stage of every handled request: compression, then the microcache
+	static bool finishResponse(const HttpRequest& httpRequest, 
+	const ServerConfig& serverConfig, const LocationConfig* locationConfig, 
+	HttpResponse& httpResponse, const std::string& cache_key) {
+		httpCompression::compressResponse(httpRequest, serverConfig, 
+			locationConfig, httpResponse);
+		if (cache_key.empty()) {
 			return false;
 		}
-		return true;
+		return responseCache::store(cache_key, httpResponse, 
+			locationConfig->getResponseCacheValid());
 	}
 
-	std::string processHttpRequest(const std::string& raw_request, 
-	const ServerConfig& serverConfig, const std::string& client_remote_addr, 
-	SessionManager& sessionManager) {
-		HttpRequest httpRequest;
-		HttpResponse httpResponse;
-		if (!httpRequest.parse(raw_request, client_remote_addr)) {
-			httpResponse.buildBadRequest();
-			return httpResponse.toStringResponse();
+	// Called by the event loop once the script headers are complete, for 
+	// responses that are not cached: the head goes out at once and the body 
+	// follows as the script writes it
+	void beginCgiStream(CgiHandler& cgi, HttpResponse& httpResponse) {
+		httpResponse.buildOk("", "text/html");
+		cgi.applyHeaders(httpResponse);
+		// A length that is not a number cannot frame the body; chunks can
+		const std::string& announced = httpResponse.getHeader("Content-Length");
+		if (announced.find_first_not_of("0123456789") != std::string::npos) {
+			httpResponse.removeHeader("Content-Length");
 		}
-		// Define resource_path
-		const LocationConfig* locationConfig = httpUtils::findLocationForPathRequest(serverConfig, 
-			httpRequest.getPath());
-		const std::string resource_path = httpUtils::buildResourcePath(serverConfig, 
-			locationConfig, httpRequest);
+		httpResponse.setStreamed(true);
+		httpCompression::compressResponse(cgi.getHttpRequest(), cgi.getServerConfig(), 
+			cgi.getLocationConfig(), httpResponse);
+		// HTTP/1.0 has no chunks: the body ends when the connection closes
+		int status = httpResponse.getStatusCode();
+		if (httpResponse.getHeader("Content-Length").empty() 
+		&& httpResponse.getHeader("Transfer-Encoding").empty()
+		&& cgi.getHttpRequest().getVersion() != "HTTP/1.0"
+		&& status != 204 && status != 304) {
+			httpResponse.setHeader("Transfer-Encoding", "chunked");
+		}
+	}
 
-		Session* session = cookieUtils::getOrCreateSession(httpRequest, 
-			sessionManager, httpResponse);
-		if (session && !cookieUtils::validateSessionUser(session, httpRequest)) {
-			sessionManager.destroySession(session->getSessionId());
-			httpResponse.expireCookie("WEBSERVER_SESSION");
-			session = &sessionManager.createSession();
-			httpResponse.setCookie("WEBSERV_SESSION", 
-				session->getSessionId(), 3600, "/");
+	// Called by the event loop once the script closed its stdout, or with the 
+	// error that ended it: 504 timed out, 503 no room in the queue, 500/502 
+	// could not be started
+	void completeCgiRequest(CgiHandler& cgi, int error_code, HttpResponse& httpResponse) {
+		const ServerConfig& serverConfig = cgi.getServerConfig();
+		const LocationConfig* locationConfig = cgi.getLocationConfig();
+		httpResponse.setCgi(NULL);
+		if (error_code) {
+			handleError(error_code, serverConfig, locationConfig, httpResponse);
+			if (error_code == 503) {
+				// Every running script is done by then, one way or another
+				httpResponse.setHeader("Retry-After", 
+					stringUtils::toString(TIMEOUT_SECONDS));
+			}
+		} else if (!cgi.buildResponse(httpResponse)) {
+			handleError(cgi.isFastCgi() ? 502 : 500, serverConfig, 
+				locationConfig, httpResponse);
+		}
+		bool stored = finishResponse(cgi.getHttpRequest(), serverConfig, 
+			locationConfig, httpResponse, cgi.getCacheKey());
+		if (!cgi.getCacheKey().empty()) {
+			responseCache::endFill(cgi.getCacheKey(), stored, 
+				locationConfig->getResponseCacheValid());
 		}
+	}
 
+	// Everything after the session is settled: cache, config checks, methods
+	static void dispatchHttpRequest(const HttpRequest& httpRequest, 
+	const ServerConfig& serverConfig, const LocationConfig* locationConfig, 
+	const std::string& resource_path, Session* session, HttpResponse& httpResponse) {
 		// Make verifications between httpRequest & config
-		if (!checkConfig(serverConfig, locationConfig, httpRequest, 
+		if (!checkConfig(serverConfig, locationConfig, httpRequest, httpResponse)) {
+			finishResponse(httpRequest, serverConfig, locationConfig, httpResponse, "");
+			return;
+		}
+
+		// A burst on an uncached URL is coalesced: while one request fills the 
+		// entry, the others wait for it instead of running the same script
+		std::string cache_key;
+		if (isCacheable(httpRequest, locationConfig, resource_path)) {
+			cache_key = responseCache::buildKey(httpRequest, serverConfig);
+			if (responseCache::lookup(cache_key, httpResponse)) {
+				cookieUtils::trackPageView(session, resource_path);
+				// Revalidation gets the 304 the uncached path would send
+				if (httpUtils::checkNotModified(httpRequest, httpResponse)) {
+					httpResponse.buildNotModified();
+				}
+				return;
+			}
+			if (responseCache::isFilling(cache_key)) {
+				httpResponse.setAwaitedCacheKey(cache_key);
+				return;
+			}
+		}
+
+		if (dispatchCgiRequest(serverConfig, locationConfig, httpRequest, 
 		httpResponse, resource_path, session)) {
-			return httpResponse.toStringResponse();
+			if (httpResponse.getCgi()) {
+				// Compression and caching happen in completeCgiRequest; NPH 
+				// responses never pass through the server
+				if (!cache_key.empty() && !httpResponse.getCgi()->isNph()) {
+					httpResponse.getCgi()->setCacheKey(cache_key);
+					responseCache::beginFill(cache_key);
+				}
+				return;
+			}
+			finishResponse(httpRequest, serverConfig, locationConfig, 
+				httpResponse, cache_key);
+			return;
 		}
 		// handle Methods
 		if (httpRequest.getMethod() == "GET") {
-			handleGetRequest(resource_path, httpResponse, locationConfig, serverConfig, session);
+			handleGetRequest(resource_path, httpRequest, httpResponse, locationConfig, 
+				serverConfig, session);
 		} else if (httpRequest.getMethod() == "POST") {
 			handlePostRequest(locationConfig, serverConfig, httpRequest, httpResponse, session);
 		} else if (httpRequest.getMethod() == "DELETE") {
@@ -278,7 +359,32 @@ namespace httpHandler {
 		} else {
 			handleError(405, serverConfig, locationConfig, httpResponse);
 		}
-		return httpResponse.toStringResponse();
+		finishResponse(httpRequest, serverConfig, locationConfig, 
+			httpResponse, cache_key);
+	}
+
+	void processHttpRequest(const std::string& raw_request, 
+	const VirtualHosts& virtualHosts, const std::string& client_remote_addr, 
+	SessionManager& sessionManager, HttpResponse& httpResponse) {
+		HttpRequest httpRequest;
+		if (!httpRequest.parse(raw_request, client_remote_addr)) {
+			handleError(400, virtualHosts.getDefault(), NULL, httpResponse);
+			return;
+		}
+		const ServerConfig& serverConfig = virtualHosts.find(httpRequest.getHeader("Host"));
+		// Define resource_path
+		const LocationConfig* locationConfig = httpUtils::findLocationForPathRequest(serverConfig, 
+			httpRequest.getPath());
+		const std::string resource_path = httpUtils::buildResourcePath(serverConfig, 
+			locationConfig, httpRequest);
+
+		Session pending("");
+		Session* session = cookieUtils::openSession(httpRequest, locationConfig, 
+			sessionManager, httpResponse, pending);
+		dispatchHttpRequest(httpRequest, serverConfig, locationConfig, resource_path, 
+			session, httpResponse);
+		cookieUtils::commitSession(httpRequest, sessionManager, httpResponse, 
+			session, pending);
 	}
 
 }
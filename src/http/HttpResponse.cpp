@@ -3,11 +3,19 @@
 
 // Other includes
 #include "stringUtils.hpp"
+#include "timeUtils.hpp"
+#include "errorResponses.hpp"
 
 HttpResponse::HttpResponse() :
 	version("HTTP/1.1"),	
 	status_code(200),
-	reason_phrase("OK")
+	reason_phrase("OK"),
+	body_fd(-1),
+	body_fd_length(0),
+	compression_level(0),
+	prebuilt(NULL),
+	streamed(false),
+	cgi(NULL)
 {}
 
 HttpResponse::HttpResponse(const HttpResponse& other) :
@@ -16,7 +24,15 @@ HttpResponse::HttpResponse(const HttpResponse& other) :
 	reason_phrase(other.reason_phrase),
 	headers(other.headers),
 	body(other.body),
-	cookies_to_set(other.cookies_to_set)
+	cookies_to_set(other.cookies_to_set),
+	body_fd(other.body_fd),
+	body_fd_length(other.body_fd_length),
+	content_coding(other.content_coding),
+	compression_level(other.compression_level),
+	prebuilt(other.prebuilt),
+	streamed(other.streamed),
+	cgi(other.cgi),
+	awaited_cache_key(other.awaited_cache_key)
 {}
 
 HttpResponse& HttpResponse::operator=(const HttpResponse& other) {
@@ -27,6 +43,14 @@ HttpResponse& HttpResponse::operator=(const HttpResponse& other) {
 		headers = other.headers;
 		body = other.body;
 		cookies_to_set = other.cookies_to_set;
+		body_fd = other.body_fd;
+		body_fd_length = other.body_fd_length;
+		content_coding = other.content_coding;
+		compression_level = other.compression_level;
+		prebuilt = other.prebuilt;
+		streamed = other.streamed;
+		cgi = other.cgi;
+		awaited_cache_key = other.awaited_cache_key;
 	}
 	return *this;
 }
@@ -75,6 +99,46 @@ int HttpResponse::getStatusCode() const {
 	return status_code;
 }
 
+const std::string& HttpResponse::getBody() const {
+	return prebuilt ? prebuilt->getBody() : body;
+}
+
+int HttpResponse::getBodyFd() const {
+	return body_fd;
+}
+
+size_t HttpResponse::getBodyFdLength() const {
+	return body_fd_length;
+}
+
+const std::string& HttpResponse::getContentCoding() const {
+	return content_coding;
+}
+
+int HttpResponse::getCompressionLevel() const {
+	return compression_level;
+}
+
+const PrebuiltResponse* HttpResponse::getPrebuilt() const {
+	return prebuilt;
+}
+
+CgiHandler* HttpResponse::getCgi() const {
+	return cgi;
+}
+
+const std::string& HttpResponse::getAwaitedCacheKey() const {
+	return awaited_cache_key;
+}
+
+bool HttpResponse::isDeferred() const {
+	return cgi || !awaited_cache_key.empty();
+}
+
+bool HttpResponse::isStreamed() const {
+	return streamed;
+}
+
 // Setters
 
 void HttpResponse::setVersion(const std::string& version) {
@@ -94,45 +158,78 @@ void HttpResponse::setHeader(const std::string& key, const std::string& value) {
 }
 
 void HttpResponse::setBody(const std::string& body) {
+	prebuilt = NULL;
 	this->body = body;
 }
 
+// The connection takes ownership of fd and streams it after the headers
+void HttpResponse::setBodyFile(int fd, size_t length) {
+	prebuilt = NULL;
+	body.clear();
+	body_fd = fd;
+	body_fd_length = length;
+}
+
+void HttpResponse::setContentCoding(const std::string& coding, int level) {
+	content_coding = coding;
+	compression_level = level;
+}
+
+void HttpResponse::removeHeader(const std::string& key) {
+	headers.erase(key);
+}
+
+// Status line, Content-Type/Length and body come from prebuilt; only cookies 
+// and headers added afterwards are serialized per request
+void HttpResponse::setPrebuilt(const PrebuiltResponse& prebuilt) {
+	this->prebuilt = &prebuilt;
+	status_code = prebuilt.getStatusCode();
+	headers.clear();
+	body.clear();
+}
+
+// The response is owned by the script until it is complete
+void HttpResponse::setCgi(CgiHandler* cgi) {
+	this->cgi = cgi;
+}
+
+void HttpResponse::setAwaitedCacheKey(const std::string& cache_key) {
+	awaited_cache_key = cache_key;
+}
+
+void HttpResponse::setStreamed(bool streamed) {
+	this->streamed = streamed;
+}
+
+// Everything but the cookies, which were already set for this client
+void HttpResponse::loadCached(const HttpResponse& cached) {
+	std::vector<std::string> cookies;
+	cookies.swap(cookies_to_set);
+	*this = cached;
+	cookies_to_set.swap(cookies);
+}
+
 // Builders
 
 void HttpResponse::buildBadRequest() {
-	version = "HTTP/1.1";
-	status_code = 400;
-	reason_phrase = "Bad Request";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>400 Bad Request</body></html>";
+	setPrebuilt(errorResponses::getDefault(400));
 }
 
 void HttpResponse::buildMethodNotAllowed() {
-	version = "HTTP/1.1";
-	status_code = 405;
-	reason_phrase = "Method Not Allowed";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>405 Method Not Allowed</body></html>";
+	setPrebuilt(errorResponses::getDefault(405));
 }
 
 void HttpResponse::buildNotFound() {
-	version = "HTTP/1.1";
-	status_code = 404;
-	reason_phrase = "Not Found";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>404 Not Found</body></html>";
+	setPrebuilt(errorResponses::getDefault(404));
 }
 
 void HttpResponse::buildInternalServerError() {
-	version = "HTTP/1.1";
-	status_code = 500;
-	reason_phrase = "Internal Server Error";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>500 Internal Server Error</body></html>";
+	setPrebuilt(errorResponses::getDefault(500));
 }
 
 void HttpResponse::buildOk(const std::string& content, 
 const std::string& mime_type) {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
 	status_code = 200;
 	reason_phrase = "OK";
@@ -141,6 +238,7 @@ const std::string& mime_type) {
 }
 
 void HttpResponse::buildCreated() {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
 	status_code = 201;
 	reason_phrase = "Created";
@@ -149,6 +247,7 @@ void HttpResponse::buildCreated() {
 }
 
 void HttpResponse::buildNoContent() {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
 	status_code = 204;
 	reason_phrase = "No Content";
@@ -156,16 +255,23 @@ void HttpResponse::buildNoContent() {
 	body = "<html><body>204 No Content</body></html>";
 }
 
-void HttpResponse::buildPayloadTooLarge() {
+// No body: the client revalidated and already holds the representation
+void HttpResponse::buildNotModified() {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
-	status_code = 413;
-	reason_phrase = "Payload Too Large";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>413 Payload Too Large</body></html>";
+	status_code = 304;
+	reason_phrase = "Not Modified";
+	headers.erase("Content-Type");
+	body.clear();
+}
+
+void HttpResponse::buildPayloadTooLarge() {
+	setPrebuilt(errorResponses::getDefault(413));
 }
 
 void HttpResponse::buildRedirect(int return_code, 
 const std::string& return_target) {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
 	status_code = return_code;
 	reason_phrase = (return_code == 301) ? "Moved Permanently" : "Found";
@@ -176,15 +282,12 @@ const std::string& return_target) {
 }
 
 void HttpResponse::buildForbidden() {
-	version = "HTTP/1.1";
-	status_code = 403;
-	reason_phrase = "Forbidden";
-	headers["Content-Type"] = "text/html";
-	body = "<html><body>403 Forbidden</body></html>";
+	setPrebuilt(errorResponses::getDefault(403));
 }
 
 void HttpResponse::buildError(int return_code, 
 const std::string& reason_phrase) {
+	prebuilt = NULL;
 	version = "HTTP/1.1";
 	status_code = return_code;
 	this->reason_phrase = reason_phrase;
@@ -195,17 +298,33 @@ const std::string& reason_phrase) {
 
 // Convert
 
-std::string HttpResponse::toStringResponse() const {
+std::string HttpResponse::toStringHeaders() const {
 	std::ostringstream oss;
 
+	if (prebuilt) {
+		oss << prebuilt->getHead();
+		oss << "Date: " << timeUtils::httpDate() << "\r\n";
+		appendHeaderFields(oss);
+		return oss.str();
+	}
 	oss << version << " "
 		<< status_code << " "
 		<< reason_phrase << "\r\n";
 
-	if (getHeader("Content-Length").empty()) {
-		oss << "Content-Length: " << body.size() << "\r\n";
+	oss << "Date: " << timeUtils::httpDate() << "\r\n";
+	// A streamed body with neither header ends when the connection closes
+	if (getHeader("Content-Length").empty() && getHeader("Transfer-Encoding").empty()
+	&& status_code != 304 && !streamed) {
+		oss << "Content-Length: " 
+			<< (body_fd >= 0 ? body_fd_length : body.size()) << "\r\n";
 	}
 	
+	appendHeaderFields(oss);
+	return oss.str();
+}
+
+// Headers, cookies and the blank line closing the header section
+void HttpResponse::appendHeaderFields(std::ostringstream& oss) const {
 	for (std::map<std::string, std::string>::const_iterator it = headers.begin();
 	it != headers.end(); ++it) {
 		oss << it->first << ": " << it->second << "\r\n";
@@ -215,8 +334,10 @@ std::string HttpResponse::toStringResponse() const {
 		oss << "Set-Cookie: " << *it << "\r\n";
 	}
 	oss << "\r\n";
-	oss << body;
-	return oss.str();
+}
+
+std::string HttpResponse::toStringResponse() const {
+	return toStringHeaders() + getBody();
 }
 
 // Cookies
@@ -237,3 +358,12 @@ void HttpResponse::expireCookie(const std::string& name) {
 	cookie << name << "=; Path=/; Max-Age=0";
 	cookies_to_set.push_back(cookie.str());
 }
+
+// Set-Cookie value produced elsewhere (a CGI script), passed through as is
+void HttpResponse::addSetCookie(const std::string& set_cookie) {
+	cookies_to_set.push_back(set_cookie);
+}
+
+void HttpResponse::clearCookies() {
+	cookies_to_set.clear();
+}
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include "fileUtils.hpp"
 #include <map>
+#include "stringUtils.hpp"
+#include "timeUtils.hpp"
 
 namespace httpUtils {
 
@@ -85,17 +87,7 @@ namespace httpUtils {
 
 	const LocationConfig* findLocationForPathRequest(const ServerConfig& serverConfig,
 	const std::string& path) {
-		const std::vector<LocationConfig>& locations = serverConfig.getLocations();
-		const LocationConfig* bestMatch = NULL;
-		size_t bestLen = 0;
-		for (size_t i = 0; i < locations.size(); ++i) {
-			const std::string& loc = locations[i].getLocation();
-			if (path.find(loc) == 0 && loc.length() > bestLen) {
-				bestMatch = &locations[i];
-				bestLen = loc.length();
-			}
-		}
-		return bestMatch;
+		return serverConfig.findLocation(path);
 	}
 
 	static std::string urlDecode(const std::string& str) {
@@ -121,7 +113,9 @@ namespace httpUtils {
 	const LocationConfig* locationConfig, const HttpRequest& httpRequest) {
 		std::string root = (locationConfig && !locationConfig->getRoot().empty()) 
 			? locationConfig->getRoot() : serverConfig.getRoot();
-		std::string locationPrefix = locationConfig ? locationConfig->getLocation() : "/";
+		// A regex location has no prefix to delete: the whole path goes under root
+		std::string locationPrefix = !locationConfig ? "/" 
+			: (locationConfig->isRegex() ? "" : locationConfig->getLocation());
 		std::string httpRequestPath = urlDecode(httpRequest.getPath());
 		// Delete prefix from location URL
 		if (httpRequestPath.find(locationPrefix) == 0) {
@@ -146,6 +140,23 @@ namespace httpUtils {
 		return root + httpRequestPath;
 	}
 
+	// Static URI (no index lookup) to a file path, with the same root rules
+	std::string resolveUriToPath(const ServerConfig& serverConfig, const std::string& uri) {
+		const LocationConfig* locationConfig = findLocationForPathRequest(serverConfig, uri);
+		std::string root = (locationConfig && !locationConfig->getRoot().empty()) 
+			? locationConfig->getRoot() : serverConfig.getRoot();
+		std::string path = uri;
+		if (locationConfig && !locationConfig->isRegex() 
+		&& path.find(locationConfig->getLocation()) == 0) {
+			path = path.substr(locationConfig->getLocation().length());
+		}
+		if (!root.empty() && root[root.size() - 1] == '/' 
+		&& !path.empty() && path[0] == '/') {
+			path = path.substr(1);
+		}
+		return root + path;
+	}
+
 	const std::string extractFilenameFromPath(const std::string& path) {
 		size_t lastSlash = path.find_last_of('/');
 		if (lastSlash != std::string::npos && lastSlash + 1 < path.size()) {
@@ -222,4 +233,59 @@ namespace httpUtils {
 		return resource_path;
 	}
 
+	// Weak comparison (RFC 9110 13.1.2): "W/" prefixes are ignored
+	static bool matchEntityTag(const std::string& if_none_match, std::string etag) {
+		if (etag.compare(0, 2, "W/") == 0) {
+			etag = etag.substr(2);
+		}
+		std::vector<std::string> candidates = stringUtils::split(if_none_match, ',');
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			std::string candidate = candidates[i];
+			if (candidate == "*") {
+				return true;
+			}
+			if (candidate.compare(0, 2, "W/") == 0) {
+				candidate = candidate.substr(2);
+			}
+			if (candidate == etag) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// mtime is ignored when has_mtime is false; an empty etag never matches
+	static bool matchValidators(const HttpRequest& httpRequest, const std::string& etag, 
+	bool has_mtime, time_t mtime) {
+		const std::string& if_none_match = httpRequest.getHeader("If-None-Match");
+		if (!if_none_match.empty()) {
+			// If-None-Match takes precedence, If-Modified-Since is then ignored
+			return !etag.empty() && matchEntityTag(if_none_match, etag);
+		}
+		const std::string& if_modified_since = httpRequest.getHeader("If-Modified-Since");
+		time_t since = 0;
+		if (has_mtime && !if_modified_since.empty()
+		&& timeUtils::parseHttpDate(if_modified_since, since)) {
+			return mtime <= since;
+		}
+		return false;
+	}
+
+	bool checkNotModified(const HttpRequest& httpRequest, const FileInfo& fileInfo) {
+		if (!fileInfo.exists || fileInfo.etag.empty()) {
+			return false;
+		}
+		return matchValidators(httpRequest, fileInfo.etag, true, fileInfo.mtime);
+	}
+
+	// A response replayed from the microcache, against the validators it was 
+	// stored with (those of the file, or whatever the script sent)
+	bool checkNotModified(const HttpRequest& httpRequest, const HttpResponse& cached) {
+		time_t mtime = 0;
+		const std::string& last_modified = cached.getHeader("Last-Modified");
+		bool has_mtime = !last_modified.empty() 
+			&& timeUtils::parseHttpDate(last_modified, mtime);
+		return matchValidators(httpRequest, cached.getHeader("ETag"), has_mtime, mtime);
+	}
+
 }
@@ -0,0 +1,68 @@
+#include "PrebuiltResponse.hpp"
+#include <sstream>
+
+// Other includes
+
+
+PrebuiltResponse::PrebuiltResponse() :
+	status_code(0)
+{}
+
+PrebuiltResponse::PrebuiltResponse(int status_code, const std::string& reason_phrase, 
+const std::string& content_type, const std::string& body) :
+	status_code(status_code),
+	body(body)
+{
+	std::ostringstream oss;
+
+	oss << "HTTP/1.1 " << status_code << " " << reason_phrase << "\r\n"
+		<< "Content-Type: " << content_type << "\r\n"
+		<< "Content-Length: " << body.size() << "\r\n";
+	head = oss.str();
+}
+
+PrebuiltResponse::PrebuiltResponse(const PrebuiltResponse& other) :
+	status_code(other.status_code),
+	head(other.head),
+	body(other.body)
+{}
+
+PrebuiltResponse& PrebuiltResponse::operator=(const PrebuiltResponse& other) {
+	if (this != &other) {
+		status_code = other.status_code;
+		head = other.head;
+		body = other.body;
+	}
+	return *this;
+}
+
+PrebuiltResponse::~PrebuiltResponse() {}
+
+// Debug
+
+std::string PrebuiltResponse::toString() const {
+	std::ostringstream oss;
+
+	oss << "PrebuiltResponse instance" << std::endl;
+	oss << "status_code: " << status_code << ", body size: " << body.size() << std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const PrebuiltResponse& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Getters
+
+int PrebuiltResponse::getStatusCode() const {
+	return status_code;
+}
+
+const std::string& PrebuiltResponse::getHead() const {
+	return head;
+}
+
+const std::string& PrebuiltResponse::getBody() const {
+	return body;
+}
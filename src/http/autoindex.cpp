@@ -0,0 +1,263 @@
+#include "autoindex.hpp"
+
+// Other includes
+#include <map>
+#include <vector>
+#include <algorithm> // sort
+#include <sstream>
+#include <cstdio> // snprintf
+#include <cstdlib> // mkstemp
+#include <ctime> // strftime, localtime_r
+#include <dirent.h> // opendir, readdir, dirfd
+#include <fcntl.h> // fstatat
+#include <sys/stat.h> // struct stat
+#include <unistd.h> // write, close, dup, unlink
+#include "constants.hpp"
+#include "timeUtils.hpp"
+
+namespace autoindex {
+
+	struct DirEntry {
+		std::string name;
+		bool is_dir;
+		bool has_stat;
+		off_t size;
+		time_t mtime;
+	};
+
+	// Small listings stay in body; large ones spill to an unlinked temp file
+	// that every response streams from through its own dup()
+	struct Listing {
+		time_t mtime_sec;
+		long mtime_nsec;
+		std::string body;
+		int fd;
+		size_t length;
+	};
+
+	static std::map<std::string, Listing>& listings() {
+		static std::map<std::string, Listing> cache;
+		return cache;
+	}
+
+	static void release(Listing& listing) {
+		if (listing.fd >= 0) {
+			close(listing.fd);
+			listing.fd = -1;
+		}
+	}
+
+	// Directories first, then names in byte order
+	static bool compareEntries(const DirEntry& a, const DirEntry& b) {
+		if (a.is_dir != b.is_dir) {
+			return a.is_dir;
+		}
+		return a.name < b.name;
+	}
+
+	static bool readEntries(const std::string& dir_path, std::vector<DirEntry>& entries) {
+		DIR* dir = opendir(dir_path.c_str());
+		if (!dir) {
+			return false;
+		}
+		int dir_fd = dirfd(dir);
+		struct dirent* dirent;
+		while ((dirent = readdir(dir)) != NULL) {
+			DirEntry entry;
+			entry.name = dirent->d_name;
+			if (entry.name == "." || entry.name == "..") {
+				continue;
+			}
+			// fstatat resolves the name against the open directory, no path joins
+			struct stat st;
+			entry.has_stat = (fstatat(dir_fd, dirent->d_name, &st, 0) == 0);
+			entry.is_dir = entry.has_stat && S_ISDIR(st.st_mode);
+			entry.size = entry.has_stat ? st.st_size : 0;
+			entry.mtime = entry.has_stat ? st.st_mtime : 0;
+			entries.push_back(entry);
+		}
+		closedir(dir);
+		std::sort(entries.begin(), entries.end(), compareEntries);
+		return true;
+	}
+
+	static bool spill(Listing& listing) {
+		if (listing.fd < 0) {
+			char path[] = AUTOINDEX_TMP_TEMPLATE;
+			listing.fd = mkstemp(path);
+			if (listing.fd < 0) {
+				return false;
+			}
+			unlink(path);
+		}
+		size_t written = 0;
+		while (written < listing.body.size()) {
+			ssize_t bytes_written = write(listing.fd, listing.body.data() + written, 
+				listing.body.size() - written);
+			if (bytes_written <= 0) {
+				return false;
+			}
+			written += bytes_written;
+		}
+		listing.body.clear();
+		return true;
+	}
+
+	static bool append(Listing& listing, const std::string& data) {
+		listing.body += data;
+		listing.length += data.size();
+		if (listing.body.size() < AUTOINDEX_SPILL_SIZE) {
+			return true;
+		}
+		return spill(listing);
+	}
+
+	static std::string escapeHtml(const std::string& str) {
+		std::string escaped;
+		for (size_t i = 0; i < str.size(); ++i) {
+			switch (str[i]) {
+				case '&': escaped += "&amp;"; break;
+				case '<': escaped += "&lt;"; break;
+				case '>': escaped += "&gt;"; break;
+				case '"': escaped += "&quot;"; break;
+				default: escaped += str[i];
+			}
+		}
+		return escaped;
+	}
+
+	static std::string escapeJson(const std::string& str) {
+		std::string escaped;
+		for (size_t i = 0; i < str.size(); ++i) {
+			unsigned char c = str[i];
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+				escaped += c;
+			} else if (c < 0x20) {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+				escaped += buffer;
+			} else {
+				escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	static std::string renderHtmlEntry(const DirEntry& entry) {
+		std::ostringstream html;
+		std::string name = escapeHtml(entry.name);
+		html << "<li><a href=\"" << name << "\">" << name << "</a>";
+		if (entry.has_stat) {
+			html << " &nbsp; ";
+			if (entry.is_dir) {
+				html << "[DIR]";
+			} else {
+				html << entry.size << " bytes";
+			}
+			html << " &nbsp; ";
+			struct tm tm;
+			char timebuf[32];
+			localtime_r(&entry.mtime, &tm);
+			std::strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M", &tm);
+			html << timebuf;
+		}
+		html << "</li>";
+		return html.str();
+	}
+
+	// Same shape as nginx: name, type, mtime (HTTP-date) and size for files
+	static std::string renderJsonEntry(const DirEntry& entry, bool first) {
+		std::ostringstream json;
+		json << (first ? "\n" : ",\n") << "{ \"name\":\"" << escapeJson(entry.name) 
+			<< "\", \"type\":\"" << (entry.is_dir ? "directory" : "file") << "\"";
+		if (entry.has_stat) {
+			json << ", \"mtime\":\"" << timeUtils::formatHttpDate(entry.mtime) << "\"";
+			if (!entry.is_dir) {
+				json << ", \"size\":" << entry.size;
+			}
+		}
+		json << " }";
+		return json.str();
+	}
+
+	static bool render(const std::string& dir_path, const std::string& format, 
+	Listing& listing) {
+		std::vector<DirEntry> entries;
+		if (!readEntries(dir_path, entries)) {
+			return false;
+		}
+		bool json = (format == "json");
+		std::string title = escapeHtml(dir_path);
+		if (!append(listing, json ? std::string("[") : "<html><head><title>Index of " 
+		+ title + "</title></head><body><h1>Index of " + title + "</h1><ul>")) {
+			return false;
+		}
+		for (size_t i = 0; i < entries.size(); ++i) {
+			if (!append(listing, json ? renderJsonEntry(entries[i], i == 0) 
+			: renderHtmlEntry(entries[i]))) {
+				return false;
+			}
+		}
+		if (!append(listing, json ? "\n]\n" : "</ul></body></html>")) {
+			return false;
+		}
+		return listing.fd < 0 || spill(listing);
+	}
+
+	// A miss reads and renders the directory right here, in the event loop: 
+	// while a very large directory is listed, every other connection waits.
+	// Only the first request after each change pays for it
+	bool serve(const std::string& dir_path, const std::string& format, 
+	HttpResponse& httpResponse) {
+		struct stat st;
+		if (stat(dir_path.c_str(), &st) != 0) {
+			return false;
+		}
+		std::map<std::string, Listing>& cache = listings();
+		const std::string key = format + ":" + dir_path;
+		std::map<std::string, Listing>::iterator it = cache.find(key);
+		// Any create, delete or rename in the directory bumps its mtime
+		if (it == cache.end() || it->second.mtime_sec != st.st_mtim.tv_sec 
+		|| it->second.mtime_nsec != st.st_mtim.tv_nsec) {
+			if (it != cache.end()) {
+				release(it->second);
+				cache.erase(it);
+			} else if (cache.size() >= AUTOINDEX_CACHE_MAX_ENTRIES) {
+				clear();
+			}
+			Listing listing;
+			listing.mtime_sec = st.st_mtim.tv_sec;
+			listing.mtime_nsec = st.st_mtim.tv_nsec;
+			listing.fd = -1;
+			listing.length = 0;
+			if (!render(dir_path, format, listing)) {
+				release(listing);
+				return false;
+			}
+			it = cache.insert(std::make_pair(key, listing)).first;
+		}
+		const std::string mime = (format == "json") ? "application/json" : "text/html";
+		if (it->second.fd < 0) {
+			httpResponse.buildOk(it->second.body, mime);
+			return true;
+		}
+		int fd = dup(it->second.fd);
+		if (fd < 0) {
+			return false;
+		}
+		httpResponse.buildOk("", mime);
+		httpResponse.setBodyFile(fd, it->second.length);
+		return true;
+	}
+
+	void clear() {
+		std::map<std::string, Listing>& cache = listings();
+		for (std::map<std::string, Listing>::iterator it = cache.begin();
+		it != cache.end(); ++it) {
+			release(it->second);
+		}
+		cache.clear();
+	}
+
+}
@@ -0,0 +1,107 @@
+#include "errorResponses.hpp"
+
+// Other includes
+#include <map>
+#include "httpUtils.hpp"
+#include "fileUtils.hpp"
+#include "stringUtils.hpp"
+#include "timeUtils.hpp"
+
+namespace errorResponses {
+
+	const char* getReasonPhrase(int status_code) {
+		switch (status_code) {
+			case 200: return "OK";
+			case 201: return "Created";
+			case 202: return "Accepted";
+			case 204: return "No Content";
+			case 301: return "Moved Permanently";
+			case 302: return "Found";
+			case 303: return "See Other";
+			case 304: return "Not Modified";
+			case 307: return "Temporary Redirect";
+			case 308: return "Permanent Redirect";
+			case 400: return "Bad Request";
+			case 403: return "Forbidden";
+			case 404: return "Not Found";
+			case 405: return "Method Not Allowed";
+			case 408: return "Request Timeout";
+			case 411: return "Length Required";
+			case 413: return "Payload Too Large";
+			case 414: return "URI Too Long";
+			case 415: return "Unsupported Media Type";
+			case 429: return "Too Many Requests";
+			case 500: return "Internal Server Error";
+			case 501: return "Not Implemented";
+			case 502: return "Bad Gateway";
+			case 503: return "Service Unavailable";
+			case 504: return "Gateway Timeout";
+			case 505: return "HTTP Version Not Supported";
+			default: return "Error";
+		}
+	}
+
+	static std::map<int, PrebuiltResponse>& defaults() {
+		static std::map<int, PrebuiltResponse> responses;
+		if (responses.empty()) {
+			static const int codes[] = { 400, 403, 404, 405, 408, 411, 413, 414, 
+				415, 429, 500, 501, 502, 503, 504, 505 };
+			for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i) {
+				std::string status = stringUtils::toString(codes[i]) + " " 
+					+ getReasonPhrase(codes[i]);
+				responses[codes[i]] = PrebuiltResponse(codes[i], 
+					getReasonPhrase(codes[i]), "text/html", 
+					"<html><body>" + status + "</body></html>");
+			}
+		}
+		return responses;
+	}
+
+	const PrebuiltResponse& getDefault(int status_code) {
+		std::map<int, PrebuiltResponse>& responses = defaults();
+		std::map<int, PrebuiltResponse>::const_iterator it = responses.find(status_code);
+		if (it == responses.end()) {
+			return responses[500];
+		}
+		return it->second;
+	}
+
+	// error_page targets are URIs, resolved like a request to that URI would be
+	static bool loadErrorPage(const ServerConfig& serverConfig, int status_code, 
+	const std::string& uri, PrebuiltResponse& out) {
+		std::string path = httpUtils::resolveUriToPath(serverConfig, uri);
+		std::string content;
+		if (!fileUtils::extractFileInString(path, content)) {
+			std::cerr << timeUtils::logTimestamp() << " [warn] error_page " << status_code 
+				<< " \"" << path << "\" cannot be read, using the default page" << std::endl;
+			return false;
+		}
+		out = PrebuiltResponse(status_code, getReasonPhrase(status_code), 
+			httpUtils::getMimeType(path), content);
+		return true;
+	}
+
+	void preload(ServerConfig& serverConfig) {
+		defaults();
+		const std::map<int, std::string>& srvErrorPages = serverConfig.getErrorPages();
+		for (std::map<int, std::string>::const_iterator it = srvErrorPages.begin();
+		it != srvErrorPages.end(); ++it) {
+			PrebuiltResponse response;
+			if (loadErrorPage(serverConfig, it->first, it->second, response)) {
+				serverConfig.addErrorResponse(it->first, response);
+			}
+		}
+		std::vector<LocationConfig>& locations = serverConfig.getLocations();
+		for (size_t i = 0; i < locations.size(); ++i) {
+			const std::map<int, std::string>& locErrorPages = locations[i].getErrorPages();
+			for (std::map<int, std::string>::const_iterator it = locErrorPages.begin();
+			it != locErrorPages.end(); ++it) {
+				PrebuiltResponse response;
+				if (loadErrorPage(serverConfig, it->first, it->second, response)) {
+					locations[i].addErrorResponse(it->first, response);
+				}
+			}
+		}
+	}
+
+}
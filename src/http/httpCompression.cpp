@@ -0,0 +1,152 @@
+#include "httpCompression.hpp"
+
+// Other includes
+#include "Compressor.hpp"
+#include "stringUtils.hpp"
+#include <cstdlib> // strtod, strtoul
+#include <cctype> // tolower
+
+namespace httpCompression {
+
+	static std::string toLower(const std::string& str) {
+		std::string lower = str;
+		for (size_t i = 0; i < lower.size(); ++i) {
+			lower[i] = static_cast<char>(std::tolower(lower[i]));
+		}
+		return lower;
+	}
+
+	// q-value of coding in an Accept-Encoding header, -1 when not listed
+	static double codingQuality(const std::string& accept_encoding, 
+	const std::string& wanted) {
+		double wanted_q = -1;
+		double star_q = -1;
+		std::vector<std::string> codings = stringUtils::split(accept_encoding, ',');
+		for (size_t i = 0; i < codings.size(); ++i) {
+			std::string coding = codings[i];
+			double q = 1;
+			size_t semicolon = coding.find(';');
+			if (semicolon != std::string::npos) {
+				std::string params = stringUtils::trim(coding.substr(semicolon + 1));
+				if (params.compare(0, 2, "q=") == 0 || params.compare(0, 2, "Q=") == 0) {
+					q = std::strtod(params.c_str() + 2, NULL);
+				}
+				coding = coding.substr(0, semicolon);
+			}
+			coding = toLower(stringUtils::trim(coding));
+			if (coding == "x-gzip") {
+				coding = "gzip";
+			}
+			if (coding == wanted) {
+				wanted_q = q;
+			} else if (coding == "*") {
+				star_q = q;
+			}
+		}
+		return wanted_q < 0 ? star_q : wanted_q;
+	}
+
+	bool acceptsCoding(const std::string& accept_encoding, const std::string& coding) {
+		return codingQuality(accept_encoding, coding) > 0;
+	}
+
+	// "gzip;q=0.8, deflate, *;q=0" -> gzip is preferred, q=0 refuses a coding
+	std::string negotiateContentCoding(const std::string& accept_encoding) {
+		double gzip_q = codingQuality(accept_encoding, "gzip");
+		double deflate_q = codingQuality(accept_encoding, "deflate");
+		if (gzip_q > 0 && gzip_q >= deflate_q) {
+			return "gzip";
+		}
+		if (deflate_q > 0) {
+			return "deflate";
+		}
+		return "";
+	}
+
+	bool isCompressibleType(const std::vector<std::string>& gzip_types, 
+	const std::string& content_type) {
+		std::string mime = toLower(stringUtils::trim(
+			content_type.substr(0, content_type.find(';'))));
+		for (size_t i = 0; i < gzip_types.size(); ++i) {
+			if (gzip_types[i] == "*" || gzip_types[i] == mime) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static size_t getMinLength(const ServerConfig& serverConfig, 
+	const LocationConfig* locationConfig) {
+		return (locationConfig && locationConfig->getGzipMinLength() >= 0) 
+			? static_cast<size_t>(locationConfig->getGzipMinLength()) 
+			: serverConfig.getGzipMinLength();
+	}
+
+	// Whether a 200 of this type and length is compressed for the clients that
+	// accept it: shared caches must then key on Accept-Encoding, whatever this
+	// client gets, and so must a 304 standing for that 200
+	bool variesByEncoding(const ServerConfig& serverConfig, 
+	const LocationConfig* locationConfig, const std::string& content_type, 
+	size_t length) {
+		bool gzip_on = (locationConfig && locationConfig->getGzip() != -1) 
+			? locationConfig->getGzip() == 1 : serverConfig.isGzipOn();
+		const std::vector<std::string>& gzip_types = 
+			(locationConfig && !locationConfig->getGzipTypes().empty()) 
+			? locationConfig->getGzipTypes() : serverConfig.getGzipTypes();
+		return gzip_on && length >= getMinLength(serverConfig, locationConfig)
+			&& isCompressibleType(gzip_types, content_type);
+	}
+
+	void compressResponse(const HttpRequest& httpRequest, const ServerConfig& serverConfig, 
+	const LocationConfig* locationConfig, HttpResponse& httpResponse) {
+		if (httpResponse.getStatusCode() != 200 
+		|| !httpResponse.getHeader("Content-Encoding").empty()) {
+			return;
+		}
+		size_t min_length = getMinLength(serverConfig, locationConfig);
+		int level = (locationConfig && locationConfig->getGzipCompLevel() > 0) 
+			? locationConfig->getGzipCompLevel() : serverConfig.getGzipCompLevel();
+		bool from_file = httpResponse.getBodyFd() >= 0;
+		size_t length = from_file ? httpResponse.getBodyFdLength() 
+			: httpResponse.getBody().size();
+		if (httpResponse.isStreamed()) {
+			// Only known when the script announced it; otherwise assume enough
+			const std::string& announced = httpResponse.getHeader("Content-Length");
+			length = announced.empty() ? min_length 
+				: static_cast<size_t>(std::strtoul(announced.c_str(), NULL, 10));
+		}
+		if (!variesByEncoding(serverConfig, locationConfig, 
+		httpResponse.getHeader("Content-Type"), length)) {
+			return;
+		}
+		httpResponse.setHeader("Vary", "Accept-Encoding");
+		std::string coding = negotiateContentCoding(httpRequest.getHeader("Accept-Encoding"));
+		if (coding.empty()) {
+			return;
+		}
+		if (from_file || httpResponse.isStreamed()) {
+			// Compressed by the connection while the file (or script output) is 
+			// streamed: the length is unknown, and HTTP/1.0 has no chunks
+			if (httpRequest.getVersion() == "HTTP/1.0") {
+				return;
+			}
+			httpResponse.setContentCoding(coding, level);
+			httpResponse.removeHeader("Content-Length");
+			httpResponse.setHeader("Transfer-Encoding", "chunked");
+		} else {
+			std::string compressed;
+			if (!Compressor::compressString(coding, level, httpResponse.getBody(), 
+			compressed)) {
+				return;
+			}
+			httpResponse.setBody(compressed);
+		}
+		httpResponse.setHeader("Content-Encoding", coding);
+		// The encoded bytes differ from the file, the strong validator must go weak
+		const std::string& etag = httpResponse.getHeader("ETag");
+		if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+			httpResponse.setHeader("ETag", "W/" + etag);
+		}
+	}
+
+}
@@ -0,0 +1,280 @@
+#include "responseCache.hpp"
+
+// Other includes
+#include <map>
+#include <list>
+#include <vector>
+#include <sstream>
+#include <cctype> // tolower
+#include <cstdlib> // atoi
+#include <unistd.h> // pread, close
+#include "constants.hpp"
+#include "stringUtils.hpp"
+#include "timeUtils.hpp"
+#include "Compressor.hpp"
+#include "httpCompression.hpp"
+
+namespace responseCache {
+
+	struct Entry {
+		HttpResponse response;
+		time_t expires;
+		size_t bytes;
+		std::list<std::string>::iterator lru_position;
+	};
+
+	static std::map<std::string, Entry>& entries() {
+		static std::map<std::string, Entry> cache;
+		return cache;
+	}
+
+	// Most recently used keys first, so eviction pops from the back
+	static std::list<std::string>& lru() {
+		static std::list<std::string> order;
+		return order;
+	}
+
+	// Keys a running request is filling right now
+	static std::map<std::string, bool>& fills() {
+		static std::map<std::string, bool> filling;
+		return filling;
+	}
+
+	// Keys whose last fill was not cacheable: no waiting on them until expiry
+	static std::map<std::string, time_t>& passes() {
+		static std::map<std::string, time_t> pass_until;
+		return pass_until;
+	}
+
+	static size_t& usedBytes() {
+		static size_t used = 0;
+		return used;
+	}
+
+	static void erase(std::map<std::string, Entry>::iterator it) {
+		usedBytes() -= it->second.bytes;
+		lru().erase(it->second.lru_position);
+		entries().erase(it);
+	}
+
+	// "/a//b/./c/../d" -> "/a/b/d", so equivalent spellings share one entry
+	static std::string normalizePath(const std::string& path) {
+		std::vector<std::string> segments;
+		size_t start = 0;
+		while (start <= path.size()) {
+			size_t end = path.find('/', start);
+			if (end == std::string::npos) {
+				end = path.size();
+			}
+			std::string segment = path.substr(start, end - start);
+			if (segment == "..") {
+				if (!segments.empty()) {
+					segments.pop_back();
+				}
+			} else if (!segment.empty() && segment != ".") {
+				segments.push_back(segment);
+			}
+			start = end + 1;
+		}
+		std::string normalized;
+		for (size_t i = 0; i < segments.size(); ++i) {
+			normalized += "/" + segments[i];
+		}
+		if (normalized.empty() || (path.size() > 1 && path[path.size() - 1] == '/')) {
+			normalized += "/";
+		}
+		return normalized;
+	}
+
+	// Honours no-store/private/no-cache, s-maxage/max-age, then Expires
+	static int computeTtl(const HttpResponse& httpResponse, int default_ttl) {
+		std::string cache_control = httpResponse.getHeader("Cache-Control");
+		for (size_t i = 0; i < cache_control.size(); ++i) {
+			cache_control[i] = std::tolower(cache_control[i]);
+		}
+		if (cache_control.find("no-store") != std::string::npos 
+		|| cache_control.find("private") != std::string::npos 
+		|| cache_control.find("no-cache") != std::string::npos) {
+			return 0;
+		}
+		size_t pos = cache_control.find("s-maxage=");
+		if (pos != std::string::npos) {
+			return std::atoi(cache_control.c_str() + pos + 9);
+		}
+		pos = cache_control.find("max-age=");
+		if (pos != std::string::npos) {
+			return std::atoi(cache_control.c_str() + pos + 8);
+		}
+		const std::string& expires = httpResponse.getHeader("Expires");
+		if (!expires.empty()) {
+			time_t expires_at;
+			if (!timeUtils::parseHttpDate(expires, expires_at)) {
+				return 0;
+			}
+			return static_cast<int>(expires_at - timeUtils::now());
+		}
+		return default_ttl;
+	}
+
+	// Reads a file body (and applies its pending content coding) into memory, 
+	// so the same bytes can be sent now and replayed from the cache later
+	static bool materializeBody(HttpResponse& httpResponse) {
+		int fd = httpResponse.getBodyFd();
+		if (fd < 0) {
+			return true;
+		}
+		if (httpResponse.getBodyFdLength() > RESPONSE_CACHE_MAX_ENTRY_BYTES) {
+			return false;
+		}
+		// pread leaves the offset alone: on failure the file is still streamed
+		std::string content;
+		content.reserve(httpResponse.getBodyFdLength());
+		char buffer[CLIENT_READ_REQUEST_BUFFER_SIZE * 4];
+		ssize_t bytes_read;
+		while ((bytes_read = pread(fd, buffer, sizeof(buffer), content.size())) > 0) {
+			content.append(buffer, bytes_read);
+		}
+		if (bytes_read < 0 || content.size() != httpResponse.getBodyFdLength()) {
+			return false;
+		}
+		if (!httpResponse.getContentCoding().empty()) {
+			std::string compressed;
+			if (!Compressor::compressString(httpResponse.getContentCoding(), 
+			httpResponse.getCompressionLevel(), content, compressed)) {
+				return false;
+			}
+			content.swap(compressed);
+			httpResponse.setContentCoding("", 0);
+			httpResponse.removeHeader("Transfer-Encoding");
+		}
+		close(fd);
+		httpResponse.setBodyFile(-1, 0);
+		httpResponse.setBody(content);
+		return true;
+	}
+
+	// The server block that answered is part of the key: without a Host 
+	// header, two listen sockets would otherwise share their entries
+	std::string buildKey(const HttpRequest& httpRequest, const ServerConfig& serverConfig) {
+		std::string host = httpRequest.getHeader("Host");
+		for (size_t i = 0; i < host.size(); ++i) {
+			host[i] = std::tolower(host[i]);
+		}
+		std::ostringstream server;
+		server << static_cast<const void*>(&serverConfig) << " ";
+		// Representations differ per coding, so the negotiated one is part of the key
+		return server.str() + host + normalizePath(httpRequest.getPath()) + "?" 
+			+ httpRequest.getQueryString() + " " 
+			+ httpCompression::negotiateContentCoding(httpRequest.getHeader("Accept-Encoding"));
+	}
+
+	bool lookup(const std::string& key, HttpResponse& httpResponse) {
+		std::map<std::string, Entry>::iterator it = entries().find(key);
+		if (it == entries().end()) {
+			return false;
+		}
+		if (it->second.expires <= timeUtils::now()) {
+			erase(it);
+			return false;
+		}
+		lru().splice(lru().begin(), lru(), it->second.lru_position);
+		httpResponse.loadCached(it->second.response);
+		return true;
+	}
+
+	bool store(const std::string& key, HttpResponse& httpResponse, int default_ttl) {
+		if (httpResponse.getStatusCode() != 200 || httpResponse.getPrebuilt()) {
+			return false;
+		}
+		int ttl = computeTtl(httpResponse, default_ttl);
+		if (ttl <= 0 || !materializeBody(httpResponse)) {
+			return false;
+		}
+		size_t bytes = key.size() + httpResponse.getBody().size();
+		if (bytes > RESPONSE_CACHE_MAX_ENTRY_BYTES) {
+			return false;
+		}
+		std::map<std::string, Entry>::iterator it = entries().find(key);
+		if (it != entries().end()) {
+			erase(it);
+		}
+		while (!lru().empty() && usedBytes() + bytes > RESPONSE_CACHE_MAX_BYTES) {
+			erase(entries().find(lru().back()));
+		}
+		lru().push_front(key);
+		Entry& entry = entries()[key];
+		entry.response = httpResponse;
+		entry.response.clearCookies(); // Session cookies belong to one client
+		entry.expires = timeUtils::now() + ttl;
+		entry.bytes = bytes;
+		entry.lru_position = lru().begin();
+		usedBytes() += bytes;
+		passes().erase(key);
+		return true;
+	}
+
+	bool isFilling(const std::string& key) {
+		if (fills().find(key) == fills().end()) {
+			return false;
+		}
+		std::map<std::string, time_t>::iterator it = passes().find(key);
+		if (it == passes().end()) {
+			return true;
+		}
+		if (it->second <= timeUtils::now()) {
+			passes().erase(it);
+			return true;
+		}
+		return false;
+	}
+
+	void beginFill(const std::string& key) {
+		fills()[key] = true;
+	}
+
+	static void pruneExpiredPasses() {
+		time_t now = timeUtils::now();
+		std::map<std::string, time_t>::iterator it = passes().begin();
+		while (it != passes().end()) {
+			if (it->second <= now) {
+				passes().erase(it++);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// A pass is only looked at again for its own key, so URLs that vary by 
+	// query would pile them up: expired ones go once the map is full, and a 
+	// pass with no room is not recorded (its waiters just queue next time)
+	void endFill(const std::string& key, bool stored, int default_ttl) {
+		fills().erase(key);
+		if (stored) {
+			return;
+		}
+		if (passes().size() >= RESPONSE_CACHE_MAX_PASSES) {
+			pruneExpiredPasses();
+		}
+		if (passes().size() < RESPONSE_CACHE_MAX_PASSES) {
+			passes()[key] = timeUtils::now() + default_ttl;
+		}
+	}
+
+	// Fills in flight keep their markers: each ends with its own endFill, 
+	// which must not find the marker of a later fill in its place
+	void clear() {
+		entries().clear();
+		passes().clear();
+		lru().clear();
+		usedBytes() = 0;
+	}
+
+	size_t getUsedBytes() {
+		return usedBytes();
+	}
+
+	size_t getPassCount() {
+		return passes().size();
+	}
+
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <WebServer.hpp>
 #include "fileUtils.hpp"
+#include "cgiSpawner.hpp"
 
 int main(int ac, char **av) {
 	if (ac != 2) {
@@ -13,6 +14,9 @@ int main(int ac, char **av) {
 		std::cerr << "[error] config file doesn't exist" << std::endl;
 		return 1;
 	}
+	// Before any config or cache makes the process big; without the helper,
+	// scripts are launched from the server itself
+	cgiSpawner::start();
 	try {
 		WebServer webServer(av[1]);
 		webServer.runServers();
@@ -5,11 +5,15 @@
 #include "constants.hpp"
 #include <unistd.h>
 #include <cstdlib>
+#include <cerrno> // errno
+#include <sys/sendfile.h> // sendfile()
+#include <fcntl.h> // splice()
 
-Client::Client(int client_fd, const ServerConfig& serverConfig, 
+Client::Client(int client_fd, ConfigSnapshot* config, const VirtualHosts& virtualHosts, 
 const std::string& remote_addr) :
 	client_fd(client_fd),
-	serverConfig(serverConfig),
+	config(config),
+	virtualHosts(virtualHosts),
 	request_buffer(""),
 	response_buffer(""),
 	request_complete(false),
@@ -17,12 +21,24 @@ const std::string& remote_addr) :
 	response_sent(false),
 	remote_addr(remote_addr),
 	content_length(0),
-	content_parsed(false)
+	content_parsed(false),
+	body_ref(NULL),
+	body_ref_offset(0),
+	body_fd(-1),
+	body_offset(0),
+	body_remaining(0),
+	streaming(false),
+	stream_chunked(false),
+	stream_ended(false),
+	stream_blocked(false),
+	stream_sized(false),
+	stream_remaining(0)
 {}
 
 Client::Client(const Client& other) :
 	client_fd(other.client_fd),
-	serverConfig(other.serverConfig),
+	config(other.config),
+	virtualHosts(other.virtualHosts),
 	request_buffer(other.request_buffer),
 	response_buffer(other.response_buffer),
 	request_complete(other.request_complete),
@@ -30,7 +46,21 @@ Client::Client(const Client& other) :
 	response_sent(other.response_sent),
 	remote_addr(other.remote_addr),
 	content_length(other.content_length),
-	content_parsed(other.content_parsed)
+	content_parsed(other.content_parsed),
+	body_ref(other.body_ref),
+	body_ref_offset(other.body_ref_offset),
+	body_fd(other.body_fd),
+	body_offset(other.body_offset),
+	body_remaining(other.body_remaining),
+	compressor(other.compressor),
+	streaming(other.streaming),
+	stream_chunked(other.stream_chunked),
+	stream_ended(other.stream_ended),
+	stream_blocked(other.stream_blocked),
+	stream_sized(other.stream_sized),
+	stream_remaining(other.stream_remaining),
+	deferred_response(other.deferred_response),
+	deferred_request(other.deferred_request)
 {}
 
 Client::~Client() {}
@@ -93,8 +123,12 @@ int Client::getClientFd() const {
 	return client_fd;
 }
 
-const ServerConfig& Client::getServerConfig() const {
-	return serverConfig;
+ConfigSnapshot* Client::getConfig() const {
+	return config;
+}
+
+const VirtualHosts& Client::getVirtualHosts() const {
+	return virtualHosts;
 }
 
 std::string& Client::getRequestBuffer() {
@@ -113,9 +147,50 @@ bool Client::isResponseSent() const {
 	return response_sent;
 }
 
+bool Client::hasResponse() const {
+	return !response_buffer.empty() || body_ref || body_fd >= 0 || streaming;
+}
+
 const std::string& Client::getRemoteAddr() const {
 	return remote_addr;
 }
+
+HttpResponse& Client::getDeferredResponse() {
+	return deferred_response;
+}
+
+const std::string& Client::getDeferredRequest() const {
+	return deferred_request;
+}
+
+bool Client::isDeferred() const {
+	return deferred_response.isDeferred();
+}
+
+bool Client::isStreaming() const {
+	return streaming;
+}
+
+// Bytes can go from the pipe to the socket as they are: no chunk framing
+// (the script announced its Content-Length) and no compression
+bool Client::isStreamSpliceable() const {
+	return streaming && !stream_chunked && !compressor.isActive();
+}
+
+bool Client::isStreamBlocked() const {
+	return stream_blocked;
+}
+
+// All the bytes the script announced are forwarded: anything more it writes
+// would be read by the client as the start of another response
+bool Client::isStreamFilled() const {
+	return streaming && stream_sized && stream_remaining == 0;
+}
+
+bool Client::hasPendingOutput() const {
+	return response_offset < response_buffer.size();
+}
+
 // Setters
 
 void Client::setRequestComplete(bool value) {
@@ -130,6 +205,54 @@ void Client::setResponseBuffer(const std::string& response_buffer) {
 	this->response_buffer = response_buffer;
 }
 
+void Client::setResponse(const HttpResponse& httpResponse) {
+	closeBody();
+	response_offset = 0;
+	response_sent = false;
+	streaming = false;
+	if (httpResponse.getPrebuilt()) {
+		response_buffer = httpResponse.toStringHeaders();
+		body_ref = &httpResponse.getPrebuilt()->getBody();
+		return;
+	}
+	if (httpResponse.getBodyFd() < 0) {
+		response_buffer = httpResponse.toStringResponse();
+		return;
+	}
+	response_buffer = httpResponse.toStringHeaders();
+	body_fd = httpResponse.getBodyFd();
+	body_offset = 0;
+	body_remaining = httpResponse.getBodyFdLength();
+	if (!httpResponse.getContentCoding().empty()) {
+		compressor.start(httpResponse.getContentCoding(), 
+			httpResponse.getCompressionLevel());
+	}
+}
+
+void Client::closeBody() {
+	body_ref = NULL;
+	body_ref_offset = 0;
+	if (body_fd >= 0) {
+		close(body_fd);
+		body_fd = -1;
+	}
+	body_offset = 0;
+	body_remaining = 0;
+	compressor.end();
+}
+
+// Only a request waiting for a cache fill needs its raw bytes to be replayed
+void Client::setDeferred(const HttpResponse& httpResponse, 
+const std::string& raw_request) {
+	deferred_response = httpResponse;
+	deferred_request = httpResponse.getAwaitedCacheKey().empty() ? "" : raw_request;
+}
+
+void Client::clearDeferred() {
+	deferred_response = HttpResponse();
+	deferred_request.clear();
+}
+
 // readRequest sub functions
 
 size_t Client::parseContentLength(const std::string& headers) const {
@@ -198,23 +321,232 @@ bool Client::readRequest() {
 	return true;
 }
 
-bool Client::writeResponse(pollfd& pollClient) {
-	if (response_sent || response_buffer.empty()) {
+// A full socket buffer is not an error: the next POLLOUT tries again
+static bool wouldBlock() {
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+bool Client::sendBodyRef() {
+	ssize_t bytes_written = write(client_fd, body_ref->c_str() + body_ref_offset, 
+		body_ref->size() - body_ref_offset);
+	if (bytes_written < 0) {
+		return wouldBlock();
+	}
+	body_ref_offset += bytes_written;
+	if (body_ref_offset >= body_ref->size()) {
+		closeBody();
+	}
+	return true;
+}
+
+// Zero-copy path: the kernel moves file pages straight to the socket
+bool Client::sendBodyFile() {
+	size_t to_send = body_remaining < CLIENT_SENDFILE_CHUNK_SIZE 
+		? body_remaining : CLIENT_SENDFILE_CHUNK_SIZE;
+	ssize_t bytes_sent = sendfile(client_fd, body_fd, &body_offset, to_send);
+	if (bytes_sent < 0) {
+		return wouldBlock();
+	}
+	if (bytes_sent == 0) {
+		return false; // The file got shorter than announced
+	}
+	body_remaining -= bytes_sent;
+	if (body_remaining == 0) {
+		closeBody();
+	}
+	return true;
+}
+
+// Reads one block of the file, deflates it and frames the output as a chunk
+bool Client::fillCompressedChunk() {
+	char buffer[CLIENT_READ_REQUEST_BUFFER_SIZE * 4];
+	size_t to_read = body_remaining < sizeof(buffer) ? body_remaining : sizeof(buffer);
+	// pread: the fd may be a dup() sharing its file offset with other responses
+	ssize_t bytes_read = to_read ? pread(body_fd, buffer, to_read, body_offset) : 0;
+	if (bytes_read < 0) {
+		return false;
+	}
+	body_offset += bytes_read;
+	bool finish = (bytes_read == 0 || static_cast<size_t>(bytes_read) == body_remaining);
+	std::string compressed;
+	if (!compressor.compress(buffer, bytes_read, compressed, finish)) {
+		return false;
+	}
+	body_remaining -= bytes_read;
+	response_buffer.clear();
+	response_offset = 0;
+	if (!compressed.empty()) {
+		std::ostringstream chunk_size;
+		chunk_size << std::hex << compressed.size() << "\r\n";
+		response_buffer = chunk_size.str() + compressed + "\r\n";
+	}
+	if (finish) {
+		response_buffer += "0\r\n\r\n";
+		closeBody();
+	}
+	return true;
+}
+
+// One write per POLLOUT; returns true once the whole response left (or failed)
+bool Client::writeResponse() {
+	if (response_sent) {
 		return true;
 	}
-	size_t to_write = response_buffer.size() - response_offset;
-	// write response on client socket
-	if (pollClient.revents & POLLOUT)
-	{
+	if (streaming) {
+		return writeStream();
+	}
+	if (response_offset >= response_buffer.size() && body_ref) {
+		if (!sendBodyRef()) {
+			closeBody();
+			response_sent = true;
+		}
+		if (!body_ref) {
+			response_sent = true;
+		}
+		return response_sent;
+	}
+	if (response_offset >= response_buffer.size() && body_fd >= 0) {
+		if (!compressor.isActive()) {
+			if (!sendBodyFile()) {
+				closeBody();
+				response_sent = true;
+			}
+			return response_sent;
+		}
+		if (!fillCompressedChunk()) {
+			closeBody();
+			response_sent = true;
+			return true;
+		}
+	}
+	if (response_offset < response_buffer.size()) {
 		ssize_t bytes_written = write(client_fd, 
-			response_buffer.c_str() + response_offset, to_write);
-		if (bytes_written < 0) {
+			response_buffer.c_str() + response_offset, 
+			response_buffer.size() - response_offset);
+		if (bytes_written < 0 && !wouldBlock()) {
+			closeBody();
+			response_sent = true;
 			return true;
 		}
-		response_offset += bytes_written;
-		if (response_offset == response_buffer.size()) {
+		if (bytes_written > 0) {
+			response_offset += bytes_written;
+		}
+	}
+	if (response_offset >= response_buffer.size() && !body_ref && body_fd < 0) {
+		response_sent = true;
+		response_offset = 0;
+	}
+	return response_sent;
+}
+
+// Streamed CGI responses
+
+void Client::startStream(const HttpResponse& httpResponse) {
+	closeBody();
+	response_buffer = httpResponse.toStringHeaders();
+	response_offset = 0;
+	response_sent = false;
+	streaming = true;
+	stream_chunked = (httpResponse.getHeader("Transfer-Encoding") == "chunked");
+	stream_ended = false;
+	stream_blocked = false;
+	const std::string& announced = httpResponse.getHeader("Content-Length");
+	stream_sized = !stream_chunked && !announced.empty() 
+		&& httpResponse.getContentCoding().empty();
+	stream_remaining = stream_sized 
+		? static_cast<size_t>(std::strtoul(announced.c_str(), NULL, 10)) : 0;
+	if (!httpResponse.getContentCoding().empty()) {
+		compressor.start(httpResponse.getContentCoding(), 
+			httpResponse.getCompressionLevel());
+	}
+}
+
+void Client::frameStreamBody(const std::string& data) {
+	if (data.empty()) {
+		return;
+	}
+	if (response_offset > 0) {
+		response_buffer.erase(0, response_offset);
+		response_offset = 0;
+	}
+	if (!stream_chunked) {
+		if (!stream_sized) {
+			response_buffer += data;
+			return;
+		}
+		size_t length = data.size() < stream_remaining ? data.size() : stream_remaining;
+		response_buffer.append(data, 0, length);
+		stream_remaining -= length;
+		return;
+	}
+	std::ostringstream chunk_size;
+	chunk_size << std::hex << data.size() << "\r\n";
+	response_buffer += chunk_size.str() + data + "\r\n";
+}
+
+void Client::appendStreamBody(const std::string& data) {
+	if (!compressor.isActive()) {
+		frameStreamBody(data);
+		return;
+	}
+	std::string compressed;
+	if (!data.empty() && compressor.compress(data.data(), data.size(), compressed, false)) {
+		frameStreamBody(compressed);
+	}
+}
+
+void Client::endStream() {
+	if (compressor.isActive()) {
+		std::string compressed;
+		if (compressor.compress("", 0, compressed, true)) {
+			frameStreamBody(compressed);
+		}
+		compressor.end();
+	}
+	if (stream_chunked) {
+		response_buffer += "0\r\n\r\n";
+	}
+	stream_ended = true;
+}
+
+// Zero-copy path for script output: pipe pages move straight to the socket,
+// never past the announced length
+ssize_t Client::spliceStreamBody(int pipe_fd) {
+	size_t to_send = CLIENT_SENDFILE_CHUNK_SIZE;
+	if (stream_sized && stream_remaining < to_send) {
+		to_send = stream_remaining;
+	}
+	ssize_t bytes_sent = splice(pipe_fd, NULL, client_fd, NULL, to_send, 
+		SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	stream_blocked = (bytes_sent < 0);
+	if (stream_sized && bytes_sent > 0) {
+		stream_remaining -= bytes_sent;
+	}
+	return bytes_sent;
+}
+
+bool Client::writeStream() {
+	stream_blocked = false;
+	if (response_offset < response_buffer.size()) {
+		ssize_t bytes_written = write(client_fd, 
+			response_buffer.c_str() + response_offset, 
+			response_buffer.size() - response_offset);
+		if (bytes_written < 0 && !wouldBlock()) {
+			streaming = false;
+			closeBody();
+			response_sent = true;
+			return true;
+		}
+		if (bytes_written > 0) {
+			response_offset += bytes_written;
+		}
+	}
+	if (response_offset >= response_buffer.size()) {
+		response_buffer.clear();
+		response_offset = 0;
+		if (stream_ended) {
+			streaming = false;
 			response_sent = true;
-			response_offset = 0;
 		}
 	}
 	return response_sent;
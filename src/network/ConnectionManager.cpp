@@ -43,13 +43,23 @@ Client& ConnectionManager::getClient(int client_fd) {
 	return it->second;
 }
 
+bool ConnectionManager::hasClient(int client_fd) const {
+	return clients.find(client_fd) != clients.end();
+}
+
 // Core functionality
 
-void ConnectionManager::addClient(int client_fd, const ServerConfig& serverConfig, 
-const std::string& remote_addr) {
-	clients.insert(std::make_pair(client_fd, Client(client_fd, serverConfig, remote_addr)));
+void ConnectionManager::addClient(int client_fd, ConfigSnapshot* config, 
+const VirtualHosts& virtualHosts, const std::string& remote_addr) {
+	clients.insert(std::make_pair(client_fd, 
+		Client(client_fd, config, virtualHosts, remote_addr)));
 }
 
 void ConnectionManager::removeClient(int client_fd) {
-	clients.erase(client_fd);
+	std::map<int, Client>::iterator it = clients.find(client_fd);
+	if (it == clients.end()) {
+		return;
+	}
+	it->second.closeBody();
+	clients.erase(it);
 }
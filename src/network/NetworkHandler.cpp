@@ -3,46 +3,88 @@
 
 // Other includes
 #include <unistd.h> // close()
+#include <fcntl.h> // fcntl
 #include <sys/socket.h> // accept()
 #include <netinet/in.h> // sockaddr_in
 #include <arpa/inet.h> // inet_ntoa
 #include "httpHandler.hpp"
+#include "responseCache.hpp"
+#include "autoindex.hpp"
+#include "statCache.hpp"
+#include "fastcgi.hpp"
+#include "cgiSpawner.hpp"
 #include <stdexcept>
+#include <algorithm> // find
 #include <signal.h>
 #include "constants.hpp"
+#include "timeUtils.hpp"
+#include <sys/wait.h> // waitpid
+#include <sys/signalfd.h> // signalfd
 
 static volatile sig_atomic_t g_running = 1;
+static volatile sig_atomic_t g_reload = 0;
 
+// SIGHUP only comes here without a signalfd
 static void signalHandler(int signal) {
 	if (signal == SIGINT) {
 		g_running = 0;
+	} else if (signal == SIGHUP) {
+		g_reload = 1;
 	}
 }
 
 NetworkHandler::NetworkHandler() :
-	servers(NULL)
+	config(NULL),
+	signal_fd(-1),
+	next_snapshot(0)
 {
 	signal(SIGINT, signalHandler);
+	signal(SIGHUP, signalHandler);
+	// A peer closing mid-response must not kill the server on write()/sendfile()
+	signal(SIGPIPE, SIG_IGN);
 }
 
+// Retired configurations stay with other, along with their connections
 NetworkHandler::NetworkHandler(const NetworkHandler& other) :
-	servers(other.servers),
+	config(other.config ? new ConfigSnapshot(*other.config) : NULL),
+	config_filename(other.config_filename),
 	poller(other.poller),
 	connectionManager(other.connectionManager),
-	sessionManager(other.sessionManager)
+	sessionManager(other.sessionManager),
+	cgi_fds(other.cgi_fds),
+	cache_waiters(other.cache_waiters),
+	unreaped(other.unreaped),
+	cgi_running(other.cgi_running),
+	cgi_queues(other.cgi_queues),
+	signal_fd(other.signal_fd),
+	next_snapshot(other.next_snapshot)
 {}
 
 NetworkHandler& NetworkHandler::operator=(const NetworkHandler& other) {
 	if (this != &other) {
-		servers = other.servers;
+		delete config;
+		config = other.config ? new ConfigSnapshot(*other.config) : NULL;
+		config_filename = other.config_filename;
 		poller = other.poller;
 		connectionManager = other.connectionManager;
 		sessionManager = other.sessionManager;
+		cgi_fds = other.cgi_fds;
+		cache_waiters = other.cache_waiters;
+		unreaped = other.unreaped;
+		cgi_running = other.cgi_running;
+		cgi_queues = other.cgi_queues;
+		signal_fd = other.signal_fd;
+		next_snapshot = other.next_snapshot;
 	}
 	return *this;
 }
 
-NetworkHandler::~NetworkHandler() {}
+NetworkHandler::~NetworkHandler() {
+	delete config;
+	for (size_t i = 0; i < retired.size(); ++i) {
+		delete retired[i];
+	}
+}
 
 // Debug
 
@@ -58,34 +100,38 @@ std::ostream& operator<<(std::ostream& os, const NetworkHandler& obj) {
 	return os;
 }
 
+// Getters
+
+const ConfigSnapshot& NetworkHandler::getConfig() const {
+	return *config;
+}
+
 // Setters
 
-void NetworkHandler::setServers(const std::vector<Server>* servers) {
-	this->servers = servers;
+// Binds the listen sockets; throws on a bad file
+void NetworkHandler::loadConfig(const std::string& configFilename) {
+	ConfigSnapshot* loaded = new ConfigSnapshot(configFilename, config);
+	delete config;
+	config = loaded;
+	config_filename = configFilename;
 }
 
 // Handle listen sockets
 
+// Server blocks on the same address share their socket: it is polled once
 void NetworkHandler::addListeningSocketsToPoller() {
-	if (!servers) {
+	if (!config) {
 		return;
 	}
-	for (size_t i = 0; i < servers->size(); ++i) {
-		int server_fd = (*servers)[i].getSocket().getFd();
-		poller.addFd(server_fd, POLLIN);
+	const std::map<int, VirtualHosts>& listeners = config->getVirtualHosts();
+	for (std::map<int, VirtualHosts>::const_iterator it = listeners.begin();
+	it != listeners.end(); ++it) {
+		poller.addFd(it->first, POLLIN);
 	}
 }
 
 bool NetworkHandler::isListeningSocket(int fd) const {
-	if (!servers) {
-		return false;
-	}
-	for (size_t i = 0; i < servers->size(); ++i) {
-		if (fd == (*servers)[i].getSocket().getFd()) {
-			return true;
-		}
-	}
-	return false;
+	return config && config->findVirtualHosts(fd);
 }
 
 void NetworkHandler::acceptNewConnection(int server_fd) {
@@ -95,55 +141,93 @@ void NetworkHandler::acceptNewConnection(int server_fd) {
 	if (client_fd < 0) {
 		return;
 	}
+	// Only the NPH script it is handed to may keep a connection open
+	fcntl(client_fd, F_SETFD, FD_CLOEXEC);
 	std::string remote_addr = inet_ntoa(client_addr.sin_addr);
-	poller.addFd(client_fd, POLLIN | POLLOUT);
-	connectionManager.addClient(client_fd, findServerConfigForServerFd(server_fd), remote_addr);
+	poller.addFd(client_fd, POLLIN);
+	config->acquire();
+	connectionManager.addClient(client_fd, config, findVirtualHostsForServerFd(server_fd), 
+		remote_addr);
 }
 
-const ServerConfig& NetworkHandler::findServerConfigForServerFd(int server_fd) {
-	for (size_t i = 0; i < servers->size(); ++i) {
-		if ((*servers)[i].getSocket().getFd() == server_fd) {
-			return (*servers)[i].getConfig();
-		}
+const VirtualHosts& NetworkHandler::findVirtualHostsForServerFd(int server_fd) {
+	const VirtualHosts* virtualHosts = config->findVirtualHosts(server_fd);
+	if (!virtualHosts) {
+		throw std::runtime_error("VirtualHosts not found for given server_fd");
 	}
-	throw std::runtime_error("ServerConfig not found for given server_fd");
+	return *virtualHosts;
 }
 
 // Handle life cycle of a client (read, process, write)
 
 bool NetworkHandler::readClientRequest(Client& client, int client_fd) {
 	if (!client.readRequest()) {
-		poller.removeFd(client_fd);
-		close(client_fd);
-		connectionManager.removeClient(client_fd);
+		closeClientConnection(client_fd);
 		return false;
 	}
 	return true;
 }
 
-void NetworkHandler::generateClientResponse(Client& client) {
-	std::string response = httpHandler::processHttpRequest(client.getRequestBuffer(), 
-		client.getServerConfig(), client.getRemoteAddr(), sessionManager);
-	client.setResponseBuffer(response);
+void NetworkHandler::generateClientResponse(Client& client, 
+const std::string& raw_request) {
+	HttpResponse httpResponse;
+	httpHandler::processHttpRequest(raw_request, 
+		client.getVirtualHosts(), client.getRemoteAddr(), sessionManager, 
+		httpResponse);
+	if (httpResponse.isDeferred()) {
+		client.setDeferred(httpResponse, raw_request);
+		// Only hangups matter until the response exists
+		poller.setEvents(client.getClientFd(), 0);
+		if (httpResponse.getCgi()) {
+			launchCgi(client);
+		} else {
+			cache_waiters[httpResponse.getAwaitedCacheKey()].push_back(client.getClientFd());
+		}
+		return;
+	}
+	client.clearDeferred();
+	client.setResponse(httpResponse);
+	// Nothing left to read until the response is out
+	poller.setEvents(client.getClientFd(), POLLOUT);
+}
+
+void NetworkHandler::writeClientResponse(Client& client) {
+	if (client.writeResponse()) {
+		closeClientConnection(client.getClientFd());
+		return;
+	}
+	if (client.isStreaming() && client.isDeferred()) {
+		updateStreamEvents(client);
+	}
 }
 
-void NetworkHandler::writeClientResponse(Client& client, pollfd& pollClient) {
-	if (client.writeResponse(pollClient)) {
-		client.setResponseSent(true);
-		poller.removeFd(client.getClientFd());
-		close(client.getClientFd());
-		connectionManager.removeClient(client.getClientFd());
+void NetworkHandler::closeClientConnection(int client_fd) {
+	if (connectionManager.hasClient(client_fd)) {
+		Client& client = connectionManager.getClient(client_fd);
+		if (client.getDeferredResponse().getCgi()) {
+			abortCgi(client);
+		}
+		client.getConfig()->release();
 	}
+	poller.removeFd(client_fd);
+	close(client_fd);
+	connectionManager.removeClient(client_fd);
+	releaseRetiredConfigs();
 }
 
 void NetworkHandler::processClientEvent(pollfd pollClient) {
 	Client& client = connectionManager.getClient(pollClient.fd);
-	if (!client.isRequestComplete()) {
+	if ((pollClient.revents & (POLLERR | POLLNVAL))
+	|| ((pollClient.revents & POLLHUP) && !(pollClient.revents & POLLIN))) {
+		closeClientConnection(pollClient.fd);
+		return;
+	}
+	if ((pollClient.revents & POLLIN) && !client.isRequestComplete()) {
 		if (!readClientRequest(client, client.getClientFd()))
 			return;
 	}
-	if (client.isRequestComplete() && client.getResponseBuffer().empty()) {
-		generateClientResponse(client);
+	if (client.isRequestComplete() && !client.hasResponse() && !client.isDeferred()) {
+		generateClientResponse(client, client.getRequestBuffer());
 		size_t headers_end = client.getRequestBuffer().find("\r\n\r\n");
 		std::string headers = client.getRequestBuffer().substr(0, headers_end + 4);
 		// Keep rest of buffer
@@ -158,25 +242,484 @@ void NetworkHandler::processClientEvent(pollfd pollClient) {
 			client.getRequestBuffer().erase(0, total_expected);
 		}
 		client.setRequestComplete(false);
+		return;
+	}
+	if ((pollClient.revents & POLLOUT) && client.hasResponse()) {
+		writeClientResponse(client);
+	}
+}
+
+// Handle CGI scripts and cache waiters running alongside the clients
+
+// Past cgi_max_processes the request waits its turn in the location queue; 
+// when that is full too it is turned away with a 503
+void NetworkHandler::launchCgi(Client& client) {
+	CgiHandler& cgi = *client.getDeferredResponse().getCgi();
+	const LocationConfig* location = cgi.getLocationConfig();
+	int max_processes = location->getCgiMaxProcesses();
+	if (max_processes > 0 && cgi_running[location] >= max_processes) {
+		std::deque<int>& queue = cgi_queues[location];
+		if (queue.size() < static_cast<size_t>(location->getCgiQueueSize())) {
+			queue.push_back(client.getClientFd());
+		} else {
+			respondCgi(client, 503);
+		}
+		return;
 	}
-	if (!client.isResponseSent() && !client.getResponseBuffer().empty()) {
-		writeClientResponse(client, pollClient);
+	if (!cgi.start(client.getClientFd())) {
+		respondCgi(client, cgi.isFastCgi() ? 502 : 500);
+		return;
+	}
+	++cgi_running[cgi.getLocationConfig()];
+	attachCgi(client);
+	if (cgi.isNph() && cgi.getOutputFd() < 0) {
+		// Its exit cannot be watched: the script keeps the connection open 
+		// on its own, and the kernel closes it when the script exits
+		endNphCgi(client, false);
+	}
+}
+
+void NetworkHandler::attachCgi(Client& client) {
+	CgiHandler& cgi = *client.getDeferredResponse().getCgi();
+	if (cgi.getInputFd() >= 0) {
+		poller.addFd(cgi.getInputFd(), POLLOUT);
+		cgi_fds[cgi.getInputFd()] = client.getClientFd();
+	}
+	if (cgi.getOutputFd() >= 0) {
+		poller.addFd(cgi.getOutputFd(), POLLIN);
+		cgi_fds[cgi.getOutputFd()] = client.getClientFd();
+	}
+}
+
+// Pipes leave the poller before the handler closes them
+void NetworkHandler::detachCgi(CgiHandler& cgi, bool kill_script) {
+	int fds[2] = { cgi.getInputFd(), cgi.getOutputFd() };
+	for (size_t i = 0; i < 2; ++i) {
+		if (fds[i] >= 0) {
+			poller.removeFd(fds[i]);
+			cgi_fds.erase(fds[i]);
+		}
+	}
+	if (kill_script) {
+		cgi.abort();
+	}
+	cgi.closeInput();
+	cgi.closeOutput();
+	if (!cgi.reap()) {
+		unreaped.push_back(cgi.getPid());
+	}
+	--cgi_running[cgi.getLocationConfig()];
+}
+
+void NetworkHandler::processCgiEvent(pollfd pollCgi) {
+	Client& client = connectionManager.getClient(cgi_fds[pollCgi.fd]);
+	CgiHandler& cgi = *client.getDeferredResponse().getCgi();
+	if (pollCgi.fd == cgi.getInputFd()) {
+		if (!cgi.writeInput()) {
+			// Body fully written (or the script stopped reading): stdin is done
+			poller.removeFd(pollCgi.fd);
+			cgi_fds.erase(pollCgi.fd);
+			cgi.closeInput();
+		}
+		return;
+	}
+	if (cgi.isNph()) {
+		endNphCgi(client, false);
+		return;
+	}
+	if (client.isStreaming()) {
+		pumpCgiStream(client);
+		return;
+	}
+	if (!cgi.readOutput()) {
+		finishCgi(client, 0);
+		return;
+	}
+	// Cache fills need the whole body; anything else goes out as it comes
+	if (cgi.getCacheKey().empty() && cgi.hasHeaders()) {
+		startCgiStream(client);
+	}
+}
+
+// The response of a script that ran, or of one that never will
+void NetworkHandler::respondCgi(Client& client, int error_code) {
+	HttpResponse& httpResponse = client.getDeferredResponse();
+	CgiHandler* cgi = httpResponse.getCgi();
+	httpHandler::completeCgiRequest(*cgi, error_code, httpResponse);
+	client.setResponse(httpResponse);
+	client.clearDeferred();
+	poller.setEvents(client.getClientFd(), POLLOUT);
+	std::string cache_key = cgi->getCacheKey();
+	delete cgi;
+	if (!cache_key.empty()) {
+		releaseCacheWaiters(cache_key);
+	}
+}
+
+void NetworkHandler::finishCgi(Client& client, int error_code) {
+	CgiHandler* cgi = client.getDeferredResponse().getCgi();
+	const LocationConfig* location = cgi->getLocationConfig();
+	detachCgi(*cgi, error_code != 0);
+	respondCgi(client, error_code);
+	launchQueuedCgi(location);
+}
+
+// The client went away: the script is killed (or leaves the queue) and its 
+// fill given up
+void NetworkHandler::abortCgi(Client& client) {
+	CgiHandler* cgi = client.getDeferredResponse().getCgi();
+	const LocationConfig* location = cgi->getLocationConfig();
+	bool started = cgi->isStarted();
+	if (started) {
+		detachCgi(*cgi, true);
+	} else {
+		std::deque<int>& queue = cgi_queues[location];
+		queue.erase(std::find(queue.begin(), queue.end(), client.getClientFd()));
+	}
+	client.clearDeferred();
+	std::string cache_key = cgi->getCacheKey();
+	delete cgi;
+	if (!cache_key.empty()) {
+		responseCache::endFill(cache_key, false, 0);
+		releaseCacheWaiters(cache_key);
+	}
+	if (started) {
+		launchQueuedCgi(location);
+	}
+}
+
+// Slots freed by finished scripts go to the oldest waiting requests
+void NetworkHandler::launchQueuedCgi(const LocationConfig* location) {
+	std::map<const LocationConfig*, std::deque<int> >::iterator it = cgi_queues.find(location);
+	if (it == cgi_queues.end()) {
+		return;
+	}
+	std::deque<int>& queue = it->second;
+	while (!queue.empty() && cgi_running[location] < location->getCgiMaxProcesses()) {
+		int client_fd = queue.front();
+		queue.pop_front();
+		launchCgi(connectionManager.getClient(client_fd));
+	}
+}
+
+// Poll no longer than the nearest script deadline or session expiry; not at
+// all while a snapshot has batches left
+int NetworkHandler::nextTimeout() {
+	if (sessionManager.isSnapshotting()) {
+		return 0;
+	}
+	long deadline = 0;
+	for (std::map<int, int>::iterator it = cgi_fds.begin(); it != cgi_fds.end(); ++it) {
+		CgiHandler* cgi = connectionManager.getClient(it->second).getDeferredResponse().getCgi();
+		if (deadline == 0 || cgi->getDeadlineMs() < deadline) {
+			deadline = cgi->getDeadlineMs();
+		}
+	}
+	long expiry_ms = sessionManager.getNextExpiry() * 1000L;
+	if (expiry_ms && (deadline == 0 || expiry_ms < deadline)) {
+		deadline = expiry_ms;
+	}
+	long snapshot_ms = next_snapshot * 1000L;
+	if (snapshot_ms && (deadline == 0 || snapshot_ms < deadline)) {
+		deadline = snapshot_ms;
+	}
+	if (deadline == 0) {
+		return -1;
+	}
+	long wait = deadline - timeUtils::nowMs();
+	return wait > 0 ? static_cast<int>(wait) : 0;
+}
+
+// The head of a streamed response is already out: a stalled stream can only 
+// be cut, everything else gets its 504
+void NetworkHandler::checkCgiTimeouts() {
+	std::vector<int> timed_out;
+	for (std::map<int, int>::iterator it = cgi_fds.begin(); it != cgi_fds.end(); ++it) {
+		Client& client = connectionManager.getClient(it->second);
+		CgiHandler* cgi = client.getDeferredResponse().getCgi();
+		if (it->first != cgi->getOutputFd() || !cgi->hasTimedOut(timeUtils::nowMs())) {
+			continue;
+		}
+		if (cgi->isNph() && cgi->isClientReceiving()) {
+			cgi->markActivity();
+		} else {
+			timed_out.push_back(it->second);
+		}
+	}
+	for (size_t i = 0; i < timed_out.size(); ++i) {
+		Client& client = connectionManager.getClient(timed_out[i]);
+		if (client.getDeferredResponse().getCgi()->isNph()) {
+			endNphCgi(client, true);
+		} else if (client.isStreaming()) {
+			closeClientConnection(timed_out[i]);
+		} else {
+			finishCgi(client, 504);
+		}
+	}
+}
+
+// Streamed CGI responses: the script stdout is only polled while the client 
+// has nothing left to send, so a slow client slows the script down instead 
+// of growing a buffer
+
+void NetworkHandler::startCgiStream(Client& client) {
+	HttpResponse& httpResponse = client.getDeferredResponse();
+	CgiHandler& cgi = *httpResponse.getCgi();
+	httpHandler::beginCgiStream(cgi, httpResponse);
+	client.startStream(httpResponse);
+	client.appendStreamBody(cgi.takeBody());
+	if (client.isStreamFilled()) {
+		endCgiStream(client);
+		return;
+	}
+	updateStreamEvents(client);
+}
+
+// The body ends at the script's Content-Length: extra output is dropped. A
+// body cut short is flushed as is, and the connection closes after it like
+// after any response, so the client sees it end early
+void NetworkHandler::pumpCgiStream(Client& client) {
+	CgiHandler& cgi = *client.getDeferredResponse().getCgi();
+	// FastCGI output is framed in records, it always goes through memory
+	if (!cgi.isFastCgi() && client.isStreamSpliceable()) {
+		if (client.spliceStreamBody(cgi.getOutputFd()) == 0) {
+			endCgiStream(client);
+			return;
+		}
+	} else {
+		bool open = cgi.readOutput();
+		client.appendStreamBody(cgi.takeBody());
+		if (!open) {
+			endCgiStream(client);
+			return;
+		}
+	}
+	if (client.isStreamFilled()) {
+		endCgiStream(client);
+		return;
+	}
+	updateStreamEvents(client);
+}
+
+void NetworkHandler::endCgiStream(Client& client) {
+	CgiHandler* cgi = client.getDeferredResponse().getCgi();
+	const LocationConfig* location = cgi->getLocationConfig();
+	detachCgi(*cgi, false);
+	delete cgi;
+	client.clearDeferred();
+	client.endStream();
+	poller.setEvents(client.getClientFd(), POLLOUT);
+	launchQueuedCgi(location);
+}
+
+// NPH scripts answer on the socket themselves; once they exit (or are cut 
+// off) the connection is closed, as after any response
+void NetworkHandler::endNphCgi(Client& client, bool kill_script) {
+	CgiHandler* cgi = client.getDeferredResponse().getCgi();
+	const LocationConfig* location = cgi->getLocationConfig();
+	int client_fd = client.getClientFd();
+	detachCgi(*cgi, kill_script);
+	delete cgi;
+	client.clearDeferred();
+	closeClientConnection(client_fd);
+	launchQueuedCgi(location);
+}
+
+void NetworkHandler::updateStreamEvents(Client& client) {
+	CgiHandler& cgi = *client.getDeferredResponse().getCgi();
+	int output_fd = cgi.getOutputFd();
+	cgi.markActivity();
+	if (client.hasPendingOutput() || client.isStreamBlocked()) {
+		poller.setEvents(client.getClientFd(), POLLOUT);
+		// Out of the poller, not just silenced: a hung-up pipe would still 
+		// report POLLHUP on every poll
+		poller.removeFd(output_fd);
+	} else {
+		poller.setEvents(client.getClientFd(), 0);
+		if (!poller.hasFd(output_fd)) {
+			poller.addFd(output_fd, POLLIN);
+		}
+	}
+}
+
+// Waiters replay their request: now a cache hit, or their turn to run it
+void NetworkHandler::releaseCacheWaiters(const std::string& cache_key) {
+	std::map<std::string, std::vector<int> >::iterator it = cache_waiters.find(cache_key);
+	if (it == cache_waiters.end()) {
+		return;
+	}
+	std::vector<int> waiters;
+	waiters.swap(it->second);
+	cache_waiters.erase(it);
+	for (size_t i = 0; i < waiters.size(); ++i) {
+		if (!connectionManager.hasClient(waiters[i])) {
+			continue;
+		}
+		Client& client = connectionManager.getClient(waiters[i]);
+		// The fd may have been reused by a connection that is not waiting
+		if (client.getDeferredResponse().getAwaitedCacheKey() != cache_key) {
+			continue;
+		}
+		std::string raw_request = client.getDeferredRequest();
+		client.clearDeferred();
+		generateClientResponse(client, raw_request);
+	}
+}
+
+// SIGCHLD arrives as a readable fd instead of a handler, so exited scripts 
+// are collected as soon as they exit, from inside the loop
+void NetworkHandler::watchSignals() {
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGHUP);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+		return;
+	}
+	signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd < 0) {
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		return;
+	}
+	poller.addFd(signal_fd, POLLIN);
+}
+
+// Signals of the same kind merge: one read may stand for many exits. The
+// reload waits for the end of the iteration, when no poll entry is in use
+void NetworkHandler::processSignalEvent() {
+	signalfd_siginfo info;
+	while (read(signal_fd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+		if (info.ssi_signo == SIGHUP) {
+			g_reload = 1;
+		}
+	}
+	reapChildren();
+}
+
+void NetworkHandler::reapChildren() {
+	for (size_t i = 0; i < unreaped.size(); ) {
+		if (waitpid(unreaped[i], NULL, WNOHANG) != 0) {
+			unreaped.erase(unreaped.begin() + i);
+		} else {
+			++i;
+		}
+	}
+}
+
+// Persist sessions across restarts
+
+bool NetworkHandler::isPersistingSessions() const {
+	return config && !config->getSessionConfig().getStorePath().empty();
+}
+
+// SESSION_SNAPSHOT_BATCH sessions per loop iteration, rather than a fork()
+// of the whole server or a pause for the whole table. One at a time: a 
+// snapshot still running when the next is due pushes it back an interval
+void NetworkHandler::snapshotSessions() {
+	sessionManager.continueSnapshot(SESSION_SNAPSHOT_BATCH);
+	if (!next_snapshot || timeUtils::now() < next_snapshot) {
+		return;
+	}
+	const SessionConfig& sessionConfig = config->getSessionConfig();
+	next_snapshot = timeUtils::now() + sessionConfig.getSnapshotInterval();
+	if (!sessionManager.isSnapshotting() 
+	&& !sessionManager.beginSnapshot(sessionConfig.getStorePath())) {
+		std::cerr << timeUtils::logTimestamp() << " [warn] session snapshot to " 
+			<< sessionConfig.getStorePath() << " failed" << std::endl;
+	}
+}
+
+// Reload the configuration on SIGHUP
+
+// The file is parsed and checked in full first: if it is bad, nothing 
+// changes. Connections already open finish under the configuration they 
+// were accepted with; listen sockets of unchanged addresses carry over, 
+// the others are closed or bound
+void NetworkHandler::reloadConfig() {
+	ConfigSnapshot* next;
+	try {
+		next = new ConfigSnapshot(config_filename, config);
+	} catch (std::exception& e) {
+		std::cerr << timeUtils::logTimestamp() << " " << e.what() << std::endl 
+			<< timeUtils::logTimestamp() << " [warn] reload of " << config_filename 
+			<< " failed, keeping the running configuration" << std::endl;
+		return;
+	}
+	const std::map<int, VirtualHosts>& old_listeners = config->getVirtualHosts();
+	for (std::map<int, VirtualHosts>::const_iterator it = old_listeners.begin();
+	it != old_listeners.end(); ++it) {
+		if (!next->findVirtualHosts(it->first)) {
+			poller.removeFd(it->first);
+			close(it->first);
+		}
+	}
+	const std::map<int, VirtualHosts>& new_listeners = next->getVirtualHosts();
+	for (std::map<int, VirtualHosts>::const_iterator it = new_listeners.begin();
+	it != new_listeners.end(); ++it) {
+		if (!config->findVirtualHosts(it->first)) {
+			poller.addFd(it->first, POLLIN);
+		}
+	}
+	retired.push_back(config);
+	config = next;
+	releaseRetiredConfigs();
+	// Cached responses and pooled backends may belong to the old settings
+	responseCache::clear();
+	autoindex::clear();
+	statCache::clear();
+	fastcgi::clear();
+	const SessionConfig& sessionConfig = config->getSessionConfig();
+	sessionManager.setConfig(sessionConfig);
+	next_snapshot = (isPersistingSessions() && sessionConfig.getSnapshotInterval() > 0)
+		? timeUtils::now() + sessionConfig.getSnapshotInterval() : 0;
+}
+
+void NetworkHandler::releaseRetiredConfigs() {
+	for (size_t i = 0; i < retired.size(); ) {
+		if (retired[i]->isReferenced()) {
+			++i;
+			continue;
+		}
+		delete retired[i];
+		retired.erase(retired.begin() + i);
 	}
 }
 
 // Cleanup
 
 void NetworkHandler::cleanup() {
+	// Queued requests go first, or aborting a script would start one
+	for (std::map<const LocationConfig*, std::deque<int> >::iterator it = cgi_queues.begin();
+	it != cgi_queues.end(); ++it) {
+		for (size_t i = 0; i < it->second.size(); ++i) {
+			Client& client = connectionManager.getClient(it->second[i]);
+			delete client.getDeferredResponse().getCgi();
+			client.clearDeferred();
+		}
+	}
+	cgi_queues.clear();
+	while (!cgi_fds.empty()) {
+		abortCgi(connectionManager.getClient(cgi_fds.begin()->second));
+	}
+	fastcgi::clear();
+	cgiSpawner::stop();
 	std::vector<struct pollfd>& poller_fds = poller.getPollFds();
 	for (size_t i = 0; i < poller_fds.size(); ++i) {
 		if (!isListeningSocket(poller_fds[i].fd)) {
 			close(poller_fds[i].fd);
 		}
 	}
-	if (servers) {
-		for (size_t i = 0; i < servers->size(); ++i) {
-			int server_fd = (*servers)[i].getSocket().getFd();
-			close(server_fd);
+	const std::map<int, VirtualHosts>& listeners = config->getVirtualHosts();
+	for (std::map<int, VirtualHosts>::const_iterator it = listeners.begin();
+	it != listeners.end(); ++it) {
+		close(it->first);
+	}
+	if (isPersistingSessions()) {
+		const std::string& store_path = config->getSessionConfig().getStorePath();
+		// Replaces a snapshot still in progress
+		if (!sessionManager.writeSnapshot(store_path)) {
+			std::cerr << timeUtils::logTimestamp() << " [warn] session snapshot to " 
+				<< store_path << " failed" << std::endl;
 		}
 	}
 }
@@ -185,23 +728,50 @@ void NetworkHandler::cleanup() {
 
 void NetworkHandler::run() {
 	addListeningSocketsToPoller();
-	time_t last_session_cleanup = time(NULL);
+	watchSignals();
+	timeUtils::updateClock();
+	if (config) {
+		sessionManager.setConfig(config->getSessionConfig());
+	}
+	if (isPersistingSessions()) {
+		const SessionConfig& sessionConfig = config->getSessionConfig();
+		sessionManager.loadSnapshot(sessionConfig.getStorePath());
+		if (sessionConfig.getSnapshotInterval() > 0) {
+			next_snapshot = timeUtils::now() + sessionConfig.getSnapshotInterval();
+		}
+	}
 	while (g_running) {
-		poller.poll(-1);
+		// Running scripts are timed out, and sessions expired, even when 
+		// nothing else happens; exits and SIGHUP wake the loop through signal_fd
+		poller.poll(nextTimeout());
+		// The only clock read of the iteration, everyone else uses the cache
+		timeUtils::updateClock();
 		std::vector<struct pollfd>& poller_fds = poller.getPollFds();
 		for (size_t i = 0; i < poller_fds.size(); ++i) {
-			if (poller_fds[i].revents & POLLIN) {
-				if (isListeningSocket(poller_fds[i].fd)) {
+			if (!poller_fds[i].revents) {
+				continue;
+			}
+			if (isListeningSocket(poller_fds[i].fd)) {
+				if (poller_fds[i].revents & POLLIN) {
 					acceptNewConnection(poller_fds[i].fd);
-				} else {
-					processClientEvent(poller_fds[i]);
 				}
+			} else if (poller_fds[i].fd == signal_fd) {
+				processSignalEvent();
+			} else if (cgi_fds.find(poller_fds[i].fd) != cgi_fds.end()) {
+				processCgiEvent(poller_fds[i]);
+			} else {
+				processClientEvent(poller_fds[i]);
 			}
 		}
-		time_t current_time = time(NULL);
-		if (current_time - last_session_cleanup > FIVE_MIN_IN_SECONDS) {
-			sessionManager.cleanExpiredSessions();
-			last_session_cleanup = current_time;
+		checkCgiTimeouts();
+		if (signal_fd < 0) {
+			reapChildren();
+		}
+		sessionManager.expireSessions(SESSION_EXPIRY_BATCH);
+		snapshotSessions();
+		if (g_reload) {
+			g_reload = 0;
+			reloadConfig();
 		}
 	}
 	cleanup();
@@ -79,6 +79,15 @@ void Poller::removeFd(int fd) {
 // 	}
 // }
 
+bool Poller::hasFd(int fd) const {
+	for (size_t i = 0; i < fds.size(); ++i) {
+		if (fds[i].fd == fd) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void Poller::setEvents(int fd, short events) {
 	for (size_t i = 0; i < fds.size(); ++i) {
 		if (fds[i].fd == fd) {
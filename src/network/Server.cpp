@@ -60,3 +60,8 @@ const ServerSocket& Server::getSocket() const {
 void Server::initSocket() {
 	socket.initSocketFd(config.getHost(), config.getListen());
 }
+
+// Another block on the same address: one socket for both, told apart by Host
+void Server::shareSocket(const Server& other) {
+	socket = other.socket;
+}
@@ -0,0 +1,125 @@
+#include "VirtualHosts.hpp"
+#include <sstream>
+
+// Other includes
+#include <cctype> // tolower
+
+VirtualHosts::VirtualHosts() :
+	default_server(NULL)
+{}
+
+VirtualHosts::VirtualHosts(const VirtualHosts& other) :
+	default_server(other.default_server),
+	exact_names(other.exact_names),
+	leading_wildcards(other.leading_wildcards),
+	trailing_wildcards(other.trailing_wildcards)
+{}
+
+VirtualHosts& VirtualHosts::operator=(const VirtualHosts& other) {
+	if (this != &other) {
+		default_server = other.default_server;
+		exact_names = other.exact_names;
+		leading_wildcards = other.leading_wildcards;
+		trailing_wildcards = other.trailing_wildcards;
+	}
+	return *this;
+}
+
+VirtualHosts::~VirtualHosts() {}
+
+// Debug
+
+std::string VirtualHosts::toString() const {
+	std::ostringstream oss;
+
+	oss << "VirtualHosts instance" << std::endl;
+	oss << "names: " << exact_names.size() << " exact, " << leading_wildcards.size() 
+		<< " leading wildcards, " << trailing_wildcards.size() << " trailing wildcards" 
+		<< std::endl;
+	return oss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const VirtualHosts& obj) {
+	os << obj.toString();
+	return os;
+}
+
+// Private methods
+
+// Lowercase, without the port or a final dot
+std::string VirtualHosts::normalizeHost(const std::string& host) {
+	size_t end = host.size();
+	if (!host.empty() && host[0] == '[') {
+		size_t bracket = host.find(']');
+		end = (bracket == std::string::npos) ? host.size() : bracket + 1;
+	} else if (host.find(':') != std::string::npos) {
+		end = host.find(':');
+	}
+	if (end > 0 && host[end - 1] == '.') {
+		--end;
+	}
+	std::string name(host, 0, end);
+	for (size_t i = 0; i < name.size(); ++i) {
+		name[i] = std::tolower(static_cast<unsigned char>(name[i]));
+	}
+	return name;
+}
+
+// Getters
+
+const ServerConfig& VirtualHosts::getDefault() const {
+	return *default_server;
+}
+
+// Core functionality
+
+void VirtualHosts::add(const ServerConfig* serverConfig) {
+	if (!default_server 
+	|| (serverConfig->isDefaultServer() && !default_server->isDefaultServer())) {
+		default_server = serverConfig;
+	}
+	const std::vector<std::string>& names = serverConfig->getServerNames();
+	for (size_t i = 0; i < names.size(); ++i) {
+		std::string name = normalizeHost(names[i]);
+		if (name.size() > 2 && name.compare(0, 2, "*.") == 0) {
+			leading_wildcards.insert(std::make_pair(name.substr(1), serverConfig));
+		} else if (name.size() > 2 && name.compare(name.size() - 2, 2, ".*") == 0) {
+			trailing_wildcards.insert(std::make_pair(name.substr(0, name.size() - 1), 
+				serverConfig));
+		} else {
+			exact_names.insert(std::make_pair(name, serverConfig));
+		}
+	}
+}
+
+// The server block for a request's Host header (empty: the default one)
+const ServerConfig& VirtualHosts::find(const std::string& host) const {
+	std::string name = normalizeHost(host);
+	if (name.empty()) {
+		return *default_server;
+	}
+	std::map<std::string, const ServerConfig*>::const_iterator it = exact_names.find(name);
+	if (it != exact_names.end()) {
+		return *it->second;
+	}
+	// Longest first: from the first dot for "*.", from the last for ".*"
+	if (!leading_wildcards.empty()) {
+		for (size_t dot = name.find('.'); dot != std::string::npos; 
+		dot = name.find('.', dot + 1)) {
+			it = leading_wildcards.find(name.substr(dot));
+			if (it != leading_wildcards.end()) {
+				return *it->second;
+			}
+		}
+	}
+	if (!trailing_wildcards.empty()) {
+		for (size_t dot = name.rfind('.'); dot != std::string::npos && dot > 0; 
+		dot = name.rfind('.', dot - 1)) {
+			it = trailing_wildcards.find(name.substr(0, dot + 1));
+			if (it != trailing_wildcards.end()) {
+				return *it->second;
+			}
+		}
+	}
+	return *default_server;
+}
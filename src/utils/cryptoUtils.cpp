@@ -0,0 +1,130 @@
+#include "cryptoUtils.hpp"
+
+// Other includes
+#include <stdint.h> // uint32_t, uint64_t
+
+namespace cryptoUtils {
+
+	static const uint32_t ROUND_CONSTANTS[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 
+		0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 
+		0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 
+		0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 
+		0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 
+		0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b, 
+		0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 
+		0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 
+		0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+	static uint32_t rotateRight(uint32_t value, int bits) {
+		return (value >> bits) | (value << (32 - bits));
+	}
+
+	// One 64-byte block into the running state
+	static void compress(uint32_t state[8], const unsigned char* block) {
+		uint32_t w[64];
+		for (int i = 0; i < 16; ++i) {
+			w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) 
+				| (static_cast<uint32_t>(block[i * 4 + 1]) << 16)
+				| (static_cast<uint32_t>(block[i * 4 + 2]) << 8) 
+				| static_cast<uint32_t>(block[i * 4 + 3]);
+		}
+		for (int i = 16; i < 64; ++i) {
+			uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) 
+				^ (w[i - 15] >> 3);
+			uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) 
+				^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i) {
+			uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+			uint32_t choice = (e & f) ^ (~e & g);
+			uint32_t t1 = h + s1 + choice + ROUND_CONSTANTS[i] + w[i];
+			uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+			uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+			uint32_t t2 = s0 + majority;
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+
+	std::string sha256(const std::string& message) {
+		uint32_t state[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+		};
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(message.data());
+		size_t full_blocks = message.size() / 64;
+		for (size_t i = 0; i < full_blocks; ++i) {
+			compress(state, data + i * 64);
+		}
+		// The tail, a 1 bit, zeros, then the length in bits: one or two blocks
+		unsigned char tail[128] = { 0 };
+		size_t rest = message.size() - full_blocks * 64;
+		for (size_t i = 0; i < rest; ++i) {
+			tail[i] = data[full_blocks * 64 + i];
+		}
+		tail[rest] = 0x80;
+		size_t tail_size = rest < 56 ? 64 : 128;
+		uint64_t bit_length = static_cast<uint64_t>(message.size()) * 8;
+		for (int i = 0; i < 8; ++i) {
+			tail[tail_size - 1 - i] = static_cast<unsigned char>(bit_length >> (i * 8));
+		}
+		for (size_t offset = 0; offset < tail_size; offset += 64) {
+			compress(state, tail + offset);
+		}
+		std::string digest(32, '\0');
+		for (int i = 0; i < 8; ++i) {
+			digest[i * 4] = static_cast<char>(state[i] >> 24);
+			digest[i * 4 + 1] = static_cast<char>(state[i] >> 16);
+			digest[i * 4 + 2] = static_cast<char>(state[i] >> 8);
+			digest[i * 4 + 3] = static_cast<char>(state[i]);
+		}
+		return digest;
+	}
+
+	std::string hmacSha256(const std::string& key, const std::string& message) {
+		std::string block_key = key.size() > 64 ? sha256(key) : key;
+		block_key.resize(64, '\0');
+		std::string inner(64, '\0');
+		std::string outer(64, '\0');
+		for (size_t i = 0; i < 64; ++i) {
+			inner[i] = static_cast<char>(block_key[i] ^ 0x36);
+			outer[i] = static_cast<char>(block_key[i] ^ 0x5c);
+		}
+		return sha256(outer + sha256(inner + message));
+	}
+
+	// Takes as long wherever the first difference is, so a forged signature
+	// cannot be guessed a byte at a time
+	bool constantTimeEquals(const std::string& a, const std::string& b) {
+		if (a.size() != b.size()) {
+			return false;
+		}
+		unsigned char difference = 0;
+		for (size_t i = 0; i < a.size(); ++i) {
+			difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+		}
+		return difference == 0;
+	}
+
+}
@@ -0,0 +1,96 @@
+#include "statCache.hpp"
+
+// Other includes
+#include <map>
+#include <cstdio> // snprintf
+#include <sys/stat.h> // struct stat
+#include "constants.hpp"
+#include "timeUtils.hpp"
+
+namespace statCache {
+
+	static std::map<std::string, FileInfo>& entries() {
+		static std::map<std::string, FileInfo> cache;
+		return cache;
+	}
+
+	static void fillFileInfo(const std::string& path, FileInfo& info, time_t now) {
+		struct stat st;
+		info.cached_at = now;
+		info.etag.clear();
+		info.last_modified.clear();
+		if (stat(path.c_str(), &st) != 0) {
+			info.exists = false;
+			info.is_dir = false;
+			info.size = 0;
+			info.mtime = 0;
+			info.ino = 0;
+			return;
+		}
+		info.exists = true;
+		info.is_dir = S_ISDIR(st.st_mode);
+		info.size = st.st_size;
+		info.mtime = st.st_mtime;
+		info.ino = st.st_ino;
+		// "inode-size-mtime" in hex, quoted as a strong entity-tag
+		char etag[64];
+		snprintf(etag, sizeof(etag), "\"%lx-%lx-%lx\"",
+			static_cast<unsigned long>(st.st_ino),
+			static_cast<unsigned long>(st.st_size),
+			static_cast<unsigned long>(st.st_mtime));
+		info.etag = etag;
+		info.last_modified = timeUtils::formatHttpDate(st.st_mtime);
+	}
+
+	// Full: entries past their TTL go first, swept at most once a second; 
+	// when all are fresh, the one next to the new path makes room
+	static void makeRoom(std::map<std::string, FileInfo>& cache, 
+	const std::string& path, time_t now) {
+		static time_t swept_at = 0;
+		if (swept_at != now) {
+			swept_at = now;
+			for (std::map<std::string, FileInfo>::iterator it = cache.begin(); 
+			it != cache.end(); ) {
+				if (now - it->second.cached_at >= STAT_CACHE_TTL_SECONDS) {
+					cache.erase(it++);
+				} else {
+					++it;
+				}
+			}
+		}
+		if (cache.size() >= STAT_CACHE_MAX_ENTRIES) {
+			std::map<std::string, FileInfo>::iterator victim = cache.lower_bound(path);
+			cache.erase(victim == cache.end() ? cache.begin() : victim);
+		}
+	}
+
+	FileInfo lookup(const std::string& path) {
+		std::map<std::string, FileInfo>& cache = entries();
+		time_t now = timeUtils::now();
+		std::map<std::string, FileInfo>::iterator it = cache.find(path);
+		if (it != cache.end() && now - it->second.cached_at < STAT_CACHE_TTL_SECONDS) {
+			return it->second;
+		}
+		if (it == cache.end()) {
+			if (cache.size() >= STAT_CACHE_MAX_ENTRIES) {
+				makeRoom(cache, path, now);
+			}
+			it = cache.insert(std::make_pair(path, FileInfo())).first;
+		}
+		fillFileInfo(path, it->second, now);
+		return it->second;
+	}
+
+	void invalidate(const std::string& path) {
+		entries().erase(path);
+	}
+
+	void clear() {
+		entries().clear();
+	}
+
+	size_t getEntryCount() {
+		return entries().size();
+	}
+
+}
@@ -2,6 +2,7 @@
 #include <sstream> // std::stringstream, std::getline
 #include <climits> // INT_MIN, INT_MAX
 #include <cstdlib>
+#include <cstring> // strchr
 
 namespace stringUtils {
 
@@ -68,4 +69,47 @@ namespace stringUtils {
 		return oss.str();
 	}
 
+	// RFC 4648 section 5 alphabet, without padding: safe in cookies and URLs
+	static const char BASE64URL[] = 
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+	std::string base64UrlEncode(const std::string& bytes) {
+		std::string text;
+		text.reserve((bytes.size() * 4 + 2) / 3);
+		unsigned int bits = 0;
+		int bit_count = 0;
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			bits = (bits << 8) | static_cast<unsigned char>(bytes[i]);
+			bit_count += 8;
+			while (bit_count >= 6) {
+				bit_count -= 6;
+				text += BASE64URL[(bits >> bit_count) & 0x3f];
+			}
+		}
+		if (bit_count > 0) {
+			text += BASE64URL[(bits << (6 - bit_count)) & 0x3f];
+		}
+		return text;
+	}
+
+	bool base64UrlDecode(const std::string& text, std::string& bytes) {
+		bytes.clear();
+		unsigned int bits = 0;
+		int bit_count = 0;
+		for (size_t i = 0; i < text.size(); ++i) {
+			const char* digit = std::strchr(BASE64URL, text[i]);
+			if (!digit || text[i] == '\0') {
+				return false;
+			}
+			bits = (bits << 6) | static_cast<unsigned int>(digit - BASE64URL);
+			bit_count += 6;
+			if (bit_count >= 8) {
+				bit_count -= 8;
+				bytes += static_cast<char>((bits >> bit_count) & 0xff);
+			}
+		}
+		// A lone trailing digit cannot carry a whole byte
+		return bit_count < 6;
+	}
+
 }
@@ -59,6 +59,12 @@ namespace throwError {
 			filename);
 	}
 
+	void throwMissingDirectiveError(const std::string& filename, 
+	const std::string& directive, const std::string& required_by) {
+		throw std::runtime_error("[error] \"" + directive + "\" directive is required by \"" 
+			+ required_by + "\" in " + filename);
+	}
+
 	// Ports/addresses config errors
 
 	void throwDuplicateListenOptionsError(const std::string& filename, 
@@ -0,0 +1,99 @@
+#include "timeUtils.hpp"
+#include <cstring> // memset
+#include <sys/time.h> // gettimeofday()
+
+namespace timeUtils {
+
+	// Cached clock
+
+	static time_t cached_sec = 0;
+	static long cached_msec = 0;
+	static time_t formatted_sec = 0;
+	static std::string cached_http_date;
+	static std::string cached_log_timestamp;
+
+	static void refreshStrings() {
+		if (formatted_sec == cached_sec && !cached_http_date.empty()) {
+			return;
+		}
+		// Strings only change once per second, whatever the request rate
+		struct tm tm_local;
+		char buffer[32];
+		cached_http_date = formatHttpDate(cached_sec);
+		localtime_r(&cached_sec, &tm_local);
+		std::strftime(buffer, sizeof(buffer), "%Y/%m/%d %H:%M:%S", &tm_local);
+		cached_log_timestamp = buffer;
+		formatted_sec = cached_sec;
+	}
+
+	void updateClock() {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		cached_sec = tv.tv_sec;
+		cached_msec = static_cast<long>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+	}
+
+	// Until the next updateClock; lets tests step past max-ages and deadlines
+	void advanceClock(time_t seconds) {
+		now();
+		cached_sec += seconds;
+		cached_msec += static_cast<long>(seconds) * 1000;
+	}
+
+	time_t now() {
+		if (cached_sec == 0) {
+			updateClock();
+		}
+		return cached_sec;
+	}
+
+	long nowMs() {
+		if (cached_sec == 0) {
+			updateClock();
+		}
+		return cached_msec;
+	}
+
+	const std::string& httpDate() {
+		now();
+		refreshStrings();
+		return cached_http_date;
+	}
+
+	const std::string& logTimestamp() {
+		now();
+		refreshStrings();
+		return cached_log_timestamp;
+	}
+
+	// Formatting
+
+	// IMF-fixdate, the only format we emit: "Sun, 06 Nov 1994 08:49:37 GMT"
+	std::string formatHttpDate(time_t timestamp) {
+		struct tm tm_utc;
+		char buffer[32];
+		gmtime_r(&timestamp, &tm_utc);
+		std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+		return std::string(buffer);
+	}
+
+	bool parseHttpDate(const std::string& date, time_t& out) {
+		// IMF-fixdate, RFC 850 and asctime formats, as required by RFC 9110
+		static const char* formats[] = {
+			"%a, %d %b %Y %H:%M:%S GMT",
+			"%A, %d-%b-%y %H:%M:%S GMT",
+			"%a %b %e %H:%M:%S %Y"
+		};
+		for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+			struct tm tm_utc;
+			std::memset(&tm_utc, 0, sizeof(tm_utc));
+			const char* end = strptime(date.c_str(), formats[i], &tm_utc);
+			if (end && *end == '\0') {
+				out = timegm(&tm_utc);
+				return out != static_cast<time_t>(-1);
+			}
+		}
+		return false;
+	}
+
+}
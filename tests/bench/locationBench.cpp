@@ -0,0 +1,85 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include "ServerConfig.hpp"
+
+/*
+ * Location lookup time, the linear scan the server used to do against the
+ * radix trie ServerConfig::findLocation walks now:
+ *   ./bench_location [locations] [lookups]
+ * Locations look like /api/vN/resourceM/, request paths like real ones 
+ * below them, plus a share that matches nothing but "/".
+ */
+
+static double nowUs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const LocationConfig* linearScan(const ServerConfig& serverConfig,
+const std::string& path) {
+	const std::vector<LocationConfig>& locations = serverConfig.getLocations();
+	const LocationConfig* bestMatch = NULL;
+	size_t bestLen = 0;
+	for (size_t i = 0; i < locations.size(); ++i) {
+		const std::string& loc = locations[i].getLocation();
+		if (path.find(loc) == 0 && loc.length() > bestLen) {
+			bestMatch = &locations[i];
+			bestLen = loc.length();
+		}
+	}
+	return bestMatch;
+}
+
+static std::string locationPath(int n) {
+	std::ostringstream oss;
+	oss << "/api/v" << n % 4 << "/resource" << n << "/";
+	return oss.str();
+}
+
+int main(int ac, char** av) {
+	int location_count = (ac > 1) ? std::atoi(av[1]) : 500;
+	int lookups = (ac > 2) ? std::atoi(av[2]) : 1000000;
+	if (location_count <= 0 || lookups <= 0) {
+		std::cerr << "[usage] ./bench_location [locations] [lookups]" << std::endl;
+		return 1;
+	}
+	ServerConfig serverConfig;
+	serverConfig.addLocation(LocationConfig("/", serverConfig.getClientMaxBodySize()));
+	for (int i = 0; i < location_count; ++i) {
+		serverConfig.addLocation(LocationConfig(locationPath(i), 
+			serverConfig.getClientMaxBodySize()));
+	}
+	std::vector<std::string> paths;
+	std::srand(42);
+	for (int i = 0; i < 1024; ++i) {
+		int n = std::rand() % (location_count * 5 / 4);
+		paths.push_back(locationPath(n) + "items/12345/detail.json");
+	}
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (linearScan(serverConfig, paths[i]) != serverConfig.findLocation(paths[i])) {
+			std::cerr << "mismatch on " << paths[i] << std::endl;
+			return 1;
+		}
+	}
+	std::cout << lookups << " lookups, " << location_count + 1 << " locations" 
+		<< std::endl;
+	size_t found = 0;
+	double start = nowUs();
+	for (int i = 0; i < lookups; ++i) {
+		found += linearScan(serverConfig, paths[i & 1023]) != NULL;
+	}
+	double linear = nowUs() - start;
+	start = nowUs();
+	for (int i = 0; i < lookups; ++i) {
+		found += serverConfig.findLocation(paths[i & 1023]) != NULL;
+	}
+	double trie = nowUs() - start;
+	std::cout << "linear scan: " << linear * 1000 / lookups << " ns per lookup" << std::endl;
+	std::cout << "radix trie: " << trie * 1000 / lookups << " ns per lookup" << std::endl;
+	return found == static_cast<size_t>(lookups) * 2 ? 0 : 1;
+}
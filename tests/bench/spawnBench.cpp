@@ -0,0 +1,113 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "cgiSpawner.hpp"
+
+/*
+ * Launch latency of one CGI-like child (/bin/true, stdout on a pipe) until
+ * its stdout closes, for each way the server could start it:
+ *   ./bench_spawn [launches] [ballast MiB]
+ * The ballast stands in for the caches a long-running server accumulates.
+ */
+
+static const char* const g_argv[] = { "/bin/true", NULL };
+static const char* const g_envp[] = { "GATEWAY_INTERFACE=CGI/1.1", NULL };
+
+static double nowUs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void waitForEof(int fd) {
+	char buffer[64];
+	while (read(fd, buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+static pid_t launchFork(int in_fd, int out_fd) {
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(in_fd, STDIN_FILENO);
+		dup2(out_fd, STDOUT_FILENO);
+		execve(g_argv[0], const_cast<char* const*>(g_argv), const_cast<char* const*>(g_envp));
+		_exit(1);
+	}
+	return pid;
+}
+
+static pid_t launchVfork(int in_fd, int out_fd) {
+	return cgiSpawner::spawnLocal(".", const_cast<char* const*>(g_argv),
+		const_cast<char* const*>(g_envp), CgiLimits(), in_fd, out_fd);
+}
+
+static pid_t launchPosixSpawn(int in_fd, int out_fd) {
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+	pid_t pid = -1;
+	if (posix_spawn(&pid, g_argv[0], &actions, NULL, const_cast<char* const*>(g_argv),
+	const_cast<char* const*>(g_envp)) != 0) {
+		pid = -1;
+	}
+	posix_spawn_file_actions_destroy(&actions);
+	return pid;
+}
+
+static pid_t launchHelper(int in_fd, int out_fd) {
+	return cgiSpawner::spawn(".", const_cast<char* const*>(g_argv),
+		const_cast<char* const*>(g_envp), CgiLimits(), in_fd, out_fd);
+}
+
+static void run(const std::string& name, pid_t (*launch)(int, int), int launches) {
+	double total = 0;
+	for (int i = 0; i < launches; ++i) {
+		int in_pipe[2];
+		int out_pipe[2];
+		if (pipe(in_pipe) < 0 || pipe(out_pipe) < 0) {
+			std::cerr << "pipe failed" << std::endl;
+			return;
+		}
+		fcntl(in_pipe[1], F_SETFD, FD_CLOEXEC);
+		fcntl(out_pipe[0], F_SETFD, FD_CLOEXEC);
+		double start = nowUs();
+		pid_t pid = launch(in_pipe[0], out_pipe[1]);
+		close(in_pipe[0]);
+		close(out_pipe[1]);
+		close(in_pipe[1]);
+		waitForEof(out_pipe[0]);
+		total += nowUs() - start;
+		close(out_pipe[0]);
+		if (pid > 0) {
+			waitpid(pid, NULL, 0); // Fails at once for the helper's children
+		}
+	}
+	std::cout << name << ": " << total / launches << " us per launch" << std::endl;
+}
+
+int main(int ac, char** av) {
+	int launches = (ac > 1) ? std::atoi(av[1]) : 200;
+	size_t ballast_mib = (ac > 2) ? std::atoi(av[2]) : 512;
+	if (launches <= 0) {
+		std::cerr << "[usage] ./bench_spawn [launches] [ballast MiB]" << std::endl;
+		return 1;
+	}
+	// Like the server: the helper is forked while the process is still small
+	cgiSpawner::start();
+	std::vector<char> ballast(ballast_mib * 1024 * 1024, 1);
+	std::cout << launches << " launches of /bin/true, " << ballast_mib
+		<< " MiB resident" << std::endl;
+	run("fork + execve", launchFork, launches);
+	run("vfork + execve", launchVfork, launches);
+	run("posix_spawn", launchPosixSpawn, launches);
+	run("spawner helper", launchHelper, launches);
+	cgiSpawner::stop();
+	return ballast[0] == 1 ? 0 : 1;
+}
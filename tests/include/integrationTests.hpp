@@ -2,3 +2,4 @@
 #include "WebServer.hpp"
 
 void testConfigParsing();
+void testConfigReload();
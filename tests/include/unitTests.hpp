@@ -1,3 +1,25 @@
 #pragma once
 
 void testSplit();
+void testHttpDate();
+void testContentNegotiation();
+void testPrebuiltErrorResponses();
+void testCachedRevalidation();
+void testResponseCacheKeys();
+void testFastCgiRecords();
+void testLocationMatcher();
+void testVirtualHosts();
+void testSessionTable();
+void testSessionExpiry();
+void testSessionExpiryBatches();
+void testSessionSnapshot();
+void testSessionLimits();
+void testSessionCookieBackend();
+void testSessionModes();
+void testSessionTracking();
+void testCgiLimits();
+void testCgiHeaders();
+void testCgiStreamCap();
+void testCgiRunCap();
+void testCgiNph();
+void testStatCacheEviction();
@@ -1,5 +1,18 @@
 #include "integrationTests.hpp"
 #include "utilTests.hpp"
+#include "ConfigSnapshot.hpp"
+#include "constants.hpp"
+#include <fcntl.h> // fcntl
+#include <unistd.h> // close
+
+static bool parseFails(const std::string& configFilename) {
+	try {
+		WebServer webServer(configFilename);
+	} catch (const std::exception& e) {
+		return true;
+	}
+	return false;
+}
 
 void testConfigParsing() {
 	try {
@@ -23,6 +36,7 @@ void testConfigParsing() {
 		expectEqual(loc0.getRoot() == "/var/www/html", "First server location / root");
 		expectEqual(loc0.getIndex() == "index.html", "First server location / index");
 		expectEqual(loc0.isAutoindexOn() == false, "First server location / autoindex off");
+		expectEqual(loc0.isGzipStaticOn() == true, "First server location / gzip_static on");
 		std::vector<std::string> expected_methods0;
 		expected_methods0.push_back("GET");
 		expected_methods0.push_back("POST");
@@ -54,11 +68,33 @@ void testConfigParsing() {
 		expectEqual(loc2.getRoot() == "/var/www/testsite", "Second server location / root");
 		expectEqual(loc2.getIndex() == "home.html", "Second server location / index");
 		expectEqual(loc2.isAutoindexOn() == true, "Second server location / autoindex on");
+		expectEqual(loc2.getAutoindexFormat() == "json", "Second server location / autoindex_format json");
+		expectEqual(loc0.getAutoindexFormat() == "html", "First server location / autoindex_format html by default");
 		std::vector<std::string> expected_methods2;
 		expected_methods2.push_back("GET");
 		expectEqual(loc2.getAllowedMethods() == expected_methods2, "Second server location / allowed_methods");
 		expectEqual(loc2.getCgiExtension() == ".py", "Second server location / cgi_extension");
 		expectEqual(loc2.getCgiPath() == "/usr/bin/python3", "Second server location / cgi_path");
+		expectEqual(loc2.getCgiMaxProcesses() == 2, "Second server location / cgi_max_processes");
+		expectEqual(loc2.getCgiQueueSize() == 4, "Second server location / cgi_queue_size");
+		expectEqual(loc0.getCgiMaxProcesses() == CGI_DEFAULT_MAX_PROCESSES, "First server location / cgi_max_processes capped by default");
+		expectEqual(loc0.getCgiQueueSize() == CGI_DEFAULT_QUEUE_SIZE, "First server location / cgi_queue_size default");
+		expectEqual(loc2.getCgiRlimitCpu() == 10, "Second server location / cgi_rlimit_cpu");
+		expectEqual(loc2.getCgiRlimitAs() == 256 * 1024 * 1024, "Second server location / cgi_rlimit_as");
+		expectEqual(loc2.getCgiRlimitNofile() == 64, "Second server location / cgi_rlimit_nofile");
+		expectEqual(loc2.getCgiNice() == 5, "Second server location / cgi_nice");
+		expectEqual(loc2.isCgiNphOn() == true, "Second server location / cgi_nph on");
+		expectEqual(loc0.isCgiNphOn() == false, "First server location / cgi_nph off by default");
+		expectEqual(loc0.getCgiRlimitCpu() == 0 && loc0.getCgiRlimitAs() == 0 
+			&& loc0.getCgiRlimitNofile() == 0 && loc0.getCgiNice() == 0 
+			&& loc0.getCgiCgroup().empty(), "First server location / no CGI limits by default");
+		expectEqual(loc2.getGzip() == 1, "Second server location / gzip on");
+		expectEqual(loc2.getGzipCompLevel() == 6, "Second server location / gzip_comp_level");
+		expectEqual(loc2.getGzipMinLength() == -1, "Second server location / gzip_min_length inherited");
+		expectEqual(config1.isGzipOn() == false, "Second server gzip off by default");
+		expectEqual(loc2.isResponseCacheOn() == true, "Second server location / response_cache on");
+		expectEqual(loc2.getResponseCacheValid() == 30, "Second server location / response_cache_valid");
+		expectEqual(loc0.isResponseCacheOn() == false, "First server location / response_cache off by default");
 
 		// Second server, location /redirect
 		const LocationConfig& loc3 = config1.getLocations()[1];
@@ -71,4 +107,81 @@ void testConfigParsing() {
 		expectEqual(false, "Parsing should not throw an exception");
 		return;
 	}
+	expectEqual(parseFails("tests/fixtures/cgi_nice_negative.conf"), 
+		"Negative cgi_nice is rejected at config load");
+	expectEqual(parseFails("tests/fixtures/cgi_cgroup_missing.conf"), 
+		"cgi_cgroup without a writable cgroup.procs is rejected at config load");
+
+	std::vector<std::string> gzip_types;
+	gzip_types.push_back("text/css");
+	ServerConfig serverConfig;
+	LocationConfig locationConfig("/", 1024);
+	expectEqual(serverConfig.setGzipTypes(gzip_types) && locationConfig.setGzipTypes(gzip_types)
+		&& serverConfig.getGzipTypes() == locationConfig.getGzipTypes()
+		&& locationConfig.getGzipTypes().size() == 2 
+		&& locationConfig.getGzipTypes()[1] == "text/html",
+		"Server and location gzip_types both add text/html");
+	gzip_types.push_back("css");
+	expectEqual(!serverConfig.setGzipTypes(gzip_types) && !locationConfig.setGzipTypes(gzip_types)
+		&& locationConfig.getGzipTypes().size() == 2,
+		"Server and location gzip_types both reject a type without a slash");
+}
+
+static int listenFd(const ConfigSnapshot& snapshot, int port) {
+	const std::vector<Server>& servers = snapshot.getServers();
+	for (size_t i = 0; i < servers.size(); ++i) {
+		if (servers[i].getConfig().getListen() == port) {
+			return servers[i].getSocket().getFd();
+		}
+	}
+	return -1;
+}
+
+static bool reloadFails(const std::string& configFilename, const ConfigSnapshot& previous) {
+	try {
+		ConfigSnapshot next(configFilename, &previous);
+	} catch (const std::exception& e) {
+		return true;
+	}
+	return false;
+}
+
+// The listen sockets are closed by hand: in the server, NetworkHandler does it
+void testConfigReload() {
+	try {
+		ConfigSnapshot first("tests/fixtures/reload.conf", NULL);
+		int kept_fd = listenFd(first, 18090);
+		int dropped_fd = listenFd(first, 18091);
+
+		expectEqual(reloadFails("tests/fixtures/reload_bad.conf", first),
+			"Reload with an invalid file throws");
+		// Host changes on a bound port cannot take over its socket
+		expectEqual(reloadFails("tests/fixtures/reload_rehost.conf", first),
+			"Reload moving a bound port to another host throws");
+		expectEqual(fcntl(kept_fd, F_GETFD) != -1 && fcntl(dropped_fd, F_GETFD) != -1,
+			"Failed reloads leave the running sockets open");
+
+		// 18092 was bound, then closed again, by the failed rehost
+		ConfigSnapshot second("tests/fixtures/reload2.conf", &first);
+		expectEqual(listenFd(second, 18090) == kept_fd,
+			"Reload takes over the socket of an unchanged address");
+		expectEqual(listenFd(second, 18092) >= 0 && listenFd(second, 18092) != dropped_fd,
+			"Reload binds a new address");
+		expectEqual(second.findVirtualHosts(kept_fd)->find("reloaded.local").getServerName() 
+			== "reloaded.local", "Carried-over socket serves the new server blocks");
+
+		first.acquire();
+		first.acquire();
+		first.release();
+		expectEqual(first.isReferenced(), "Snapshot stays referenced by its last connection");
+		first.release();
+		expectEqual(!first.isReferenced(), "Snapshot is released with its last connection");
+
+		close(kept_fd);
+		close(dropped_fd);
+		close(listenFd(second, 18092));
+	} catch (const std::exception& e) {
+		std::cerr << "Reload failed: " << e.what() << std::endl;
+		expectEqual(false, "Reload should not throw an exception");
+	}
 }
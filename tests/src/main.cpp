@@ -3,5 +3,28 @@
 
 int main() {
 	testConfigParsing();
+	testConfigReload();
+	testHttpDate();
+	testContentNegotiation();
+	testPrebuiltErrorResponses();
+	testCachedRevalidation();
+	testResponseCacheKeys();
+	testFastCgiRecords();
+	testLocationMatcher();
+	testVirtualHosts();
+	testSessionTable();
+	testSessionExpiry();
+	testSessionExpiryBatches();
+	testSessionSnapshot();
+	testSessionLimits();
+	testSessionCookieBackend();
+	testSessionModes();
+	testSessionTracking();
+	testCgiLimits();
+	testCgiHeaders();
+	testCgiStreamCap();
+	testCgiRunCap();
+	testCgiNph();
+	testStatCacheEviction();
 	return 0;
 }
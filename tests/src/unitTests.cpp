@@ -3,6 +3,31 @@
 #include <vector>
 #include <iostream>
 #include "stringUtils.hpp"
+#include "timeUtils.hpp"
+#include "utilTests.hpp"
+#include "httpCompression.hpp"
+#include "errorResponses.hpp"
+#include "HttpResponse.hpp"
+#include "HttpRequest.hpp"
+#include "httpUtils.hpp"
+#include "responseCache.hpp"
+#include "fastcgi.hpp"
+#include "SessionManager.hpp"
+#include "cookieUtils.hpp"
+#include "ServerConfig.hpp"
+#include "VirtualHosts.hpp"
+#include "constants.hpp"
+#include "statCache.hpp"
+#include "cgiSpawner.hpp"
+#include "CgiHandler.hpp"
+#include "httpHandler.hpp"
+#include "Client.hpp"
+#include <fstream>
+#include <sys/stat.h> // chmod
+#include <sys/socket.h> // socketpair
+#include <unistd.h> // unlink, pipe, read
+#include <fcntl.h> // open
+#include <sys/wait.h> // waitpid
 
 void testSplit() {
 	std::string str = "foo   bar  ";
@@ -13,3 +38,646 @@ void testSplit() {
 		std::cout << *it << std::endl;
 	}
 }
+
+void testHttpDate() {
+	time_t parsed = 0;
+	expectEqual(timeUtils::formatHttpDate(784111777) == "Sun, 06 Nov 1994 08:49:37 GMT",
+		"HTTP-date is formatted as IMF-fixdate");
+	expectEqual(timeUtils::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", parsed)
+		&& parsed == 784111777, "IMF-fixdate is parsed");
+	expectEqual(timeUtils::parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", parsed)
+		&& parsed == 784111777, "RFC 850 date is parsed");
+	expectEqual(timeUtils::parseHttpDate("Sun Nov  6 08:49:37 1994", parsed)
+		&& parsed == 784111777, "asctime date is parsed");
+	expectEqual(!timeUtils::parseHttpDate("yesterday", parsed), 
+		"Invalid HTTP-date is rejected");
+	timeUtils::updateClock();
+	expectEqual(timeUtils::httpDate() == timeUtils::formatHttpDate(timeUtils::now()),
+		"Cached HTTP-date matches the cached clock");
+	expectEqual(timeUtils::nowMs() / 1000 == static_cast<long>(timeUtils::now()),
+		"Cached milliseconds match cached seconds");
+}
+
+void testContentNegotiation() {
+	expectEqual(httpCompression::negotiateContentCoding("gzip, deflate, br") == "gzip",
+		"gzip is preferred when accepted");
+	expectEqual(httpCompression::negotiateContentCoding("gzip;q=0.5, deflate") == "deflate",
+		"Higher q-value wins");
+	expectEqual(httpCompression::negotiateContentCoding("gzip;q=0, *;q=0") == "",
+		"q=0 refuses a coding");
+	expectEqual(httpCompression::negotiateContentCoding("*") == "gzip",
+		"Wildcard accepts gzip");
+	expectEqual(httpCompression::negotiateContentCoding("") == "",
+		"No Accept-Encoding means identity");
+
+	ServerConfig serverConfig;
+	expectEqual(!httpCompression::variesByEncoding(serverConfig, NULL, "text/html", 100),
+		"Nothing varies by encoding with gzip off");
+	serverConfig.setGzip(true);
+	expectEqual(httpCompression::variesByEncoding(serverConfig, NULL, "text/html", 100)
+		&& !httpCompression::variesByEncoding(serverConfig, NULL, "image/png", 100)
+		&& !httpCompression::variesByEncoding(serverConfig, NULL, "text/html", 10),
+		"Compressible types past gzip_min_length vary by encoding, 304s included");
+}
+
+void testPrebuiltErrorResponses() {
+	const PrebuiltResponse& notFound = errorResponses::getDefault(404);
+	expectEqual(notFound.getHead().find("HTTP/1.1 404 Not Found\r\n") == 0,
+		"Default 404 starts with its status line");
+	expectEqual(notFound.getHead().find("Content-Length: " 
+		+ stringUtils::toString(notFound.getBody().size()) + "\r\n") != std::string::npos,
+		"Default 404 carries its Content-Length");
+	expectEqual(errorResponses::getDefault(999).getStatusCode() == 500,
+		"Unknown status falls back to 500");
+
+	HttpResponse response;
+	response.setPrebuilt(notFound);
+	response.setCookie("id", "42");
+	std::string serialized = response.toStringResponse();
+	expectEqual(serialized.find("Set-Cookie: id=42") != std::string::npos
+		&& serialized.find(notFound.getBody()) == serialized.size() - notFound.getBody().size(),
+		"Prebuilt response keeps per-request cookies");
+}
+
+void testCachedRevalidation() {
+	HttpResponse cached;
+	cached.buildOk("hello", "text/plain");
+	cached.setHeader("ETag", "W/\"v1\"");
+	cached.setHeader("Last-Modified", "Sun, 06 Nov 1994 08:49:37 GMT");
+	HttpRequest matching;
+	matching.parse("GET / HTTP/1.1\r\nHost: a\r\nIf-None-Match: \"v1\"\r\n\r\n", "");
+	expectEqual(httpUtils::checkNotModified(matching, cached),
+		"Cached weak ETag matches If-None-Match");
+	HttpRequest mismatching;
+	mismatching.parse("GET / HTTP/1.1\r\nHost: a\r\nIf-None-Match: \"v2\"\r\n"
+		"If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", "");
+	expectEqual(!httpUtils::checkNotModified(mismatching, cached),
+		"If-None-Match mismatch ignores If-Modified-Since");
+	HttpRequest request;
+	request.parse("GET / HTTP/1.1\r\nHost: a\r\n"
+		"If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n", "");
+	expectEqual(httpUtils::checkNotModified(request, cached),
+		"Cached Last-Modified answers If-Modified-Since");
+	cached.removeHeader("Last-Modified");
+	expectEqual(!httpUtils::checkNotModified(request, cached),
+		"No cached Last-Modified, no 304");
+}
+
+void testResponseCacheKeys() {
+	ServerConfig first;
+	ServerConfig second;
+	HttpRequest request;
+	request.parse("GET /a/./b?x=1 HTTP/1.0\r\n\r\n", "");
+	HttpRequest same;
+	same.parse("GET /a//b?x=1 HTTP/1.0\r\n\r\n", "");
+	expectEqual(responseCache::buildKey(request, first) 
+		== responseCache::buildKey(same, first),
+		"Equivalent paths share a cache key");
+	expectEqual(responseCache::buildKey(request, first) 
+		!= responseCache::buildKey(request, second),
+		"Server blocks never share a cache key");
+
+	responseCache::clear();
+	for (int i = 0; i < RESPONSE_CACHE_MAX_PASSES + 100; ++i) {
+		std::string key = "uncacheable?" + stringUtils::toString(i);
+		responseCache::beginFill(key);
+		responseCache::endFill(key, false, i < 100 ? 0 : 60);
+	}
+	expectEqual(responseCache::getPassCount() == RESPONSE_CACHE_MAX_PASSES,
+		"Expired passes make room, live ones are capped");
+	responseCache::clear();
+}
+
+void testFastCgiRecords() {
+	std::vector<std::string> env;
+	env.push_back("REQUEST_METHOD=GET");
+	std::string request = fastcgi::buildRequest(env, "");
+	expectEqual(request.compare(0, 2, "\x01\x01") == 0,
+		"FastCGI request opens with BEGIN_REQUEST");
+	expectEqual(request.find(std::string("\x0e\x03REQUEST_METHODGET")) != std::string::npos,
+		"CGI variables become name-value pairs");
+
+	// STDOUT "Status" split across two reads, then END_REQUEST
+	std::string response("\x01\x06\x00\x01\x00\x06\x02\x00Status\x00\x00", 16);
+	response += std::string("\x01\x03\x00\x01\x00\x08\x00\x00", 8) + std::string(8, '\0');
+	std::string buffer = response.substr(0, 10);
+	std::string output;
+	bool ended = false;
+	fastcgi::parseRecords(buffer, output, ended);
+	expectEqual(output.empty() && buffer.size() == 10 && !ended,
+		"Incomplete FastCGI record waits for more bytes");
+	buffer += response.substr(10);
+	expectEqual(fastcgi::parseRecords(buffer, output, ended) && output == "Status"
+		&& ended && buffer.empty(), "FastCGI STDOUT is collected until END_REQUEST");
+	buffer = "HTTP/1.1 200 OK";
+	ended = false;
+	expectEqual(!fastcgi::parseRecords(buffer, output, ended),
+		"Non-FastCGI bytes are rejected");
+}
+
+void testLocationMatcher() {
+	ServerConfig serverConfig;
+	const char* prefixes[] = { "/", "/images/", "/img", "/images/thumbs/", "/api" };
+	for (size_t i = 0; i < 5; ++i) {
+		serverConfig.addLocation(LocationConfig(prefixes[i], 
+			serverConfig.getClientMaxBodySize()));
+	}
+	const LocationConfig* thumbs = serverConfig.findLocation("/images/thumbs/a.png");
+	const LocationConfig* images = serverConfig.findLocation("/images/thumb");
+	const LocationConfig* img = serverConfig.findLocation("/imgx");
+	const LocationConfig* root = serverConfig.findLocation("/im");
+	expectEqual(thumbs && thumbs->getLocation() == "/images/thumbs/"
+		&& images && images->getLocation() == "/images/"
+		&& img && img->getLocation() == "/img"
+		&& root && root->getLocation() == "/"
+		&& serverConfig.findLocation("/apix")->getLocation() == "/api",
+		"Location lookup picks the longest matching prefix");
+
+	const char* modified[][2] = { { "=", "/exact" }, { "^~", "/static/" }, 
+		{ "~", "\\.php$" }, { "~*", "\\.(png|jpg)$" } };
+	for (size_t i = 0; i < 4; ++i) {
+		LocationConfig location(modified[i][1], serverConfig.getClientMaxBodySize());
+		location.setModifier(modified[i][0]);
+		serverConfig.addLocation(location);
+	}
+	expectEqual(serverConfig.findLocation("/exact")->getModifier() == "="
+		&& serverConfig.findLocation("/exact/")->getLocation() == "/"
+		&& serverConfig.findLocation("/static/a.php")->getModifier() == "^~"
+		&& serverConfig.findLocation("/images/index.php")->getModifier() == "~"
+		&& serverConfig.findLocation("/images/A.PNG")->getModifier() == "~*"
+		&& serverConfig.findLocation("/images/a.gif")->getLocation() == "/images/",
+		"Location modifiers follow nginx precedence");
+}
+
+void testVirtualHosts() {
+	ServerConfig first;
+	ServerConfig wildcards;
+	ServerConfig fallback;
+	first.addServerName("example.com");
+	wildcards.addServerName("*.example.com");
+	wildcards.addServerName("www.example.*");
+	fallback.addServerName("other.org");
+	fallback.setDefaultServer(true);
+	VirtualHosts virtualHosts;
+	virtualHosts.add(&first);
+	virtualHosts.add(&wildcards);
+	virtualHosts.add(&fallback);
+	expectEqual(&virtualHosts.find("Example.COM:8080") == &first
+		&& &virtualHosts.find("a.b.example.com") == &wildcards
+		&& &virtualHosts.find("www.example.org") == &wildcards
+		&& &virtualHosts.find("unknown.net") == &fallback
+		&& &virtualHosts.find("") == &fallback,
+		"Host picks the exact name, then wildcards, then the default_server");
+}
+
+void testSessionTable() {
+	SessionManager sessionManager;
+	std::vector<std::string> ids;
+	// Enough to grow the table a few times
+	for (size_t i = 0; i < 5000; ++i) {
+		ids.push_back(sessionManager.createSession().getSessionId());
+	}
+	expectEqual(ids[0].size() == 22 && ids[0].find_first_of("+/=") == std::string::npos,
+		"Session ids are 128 bits in base64url");
+	bool all_found = true;
+	for (size_t i = 0; i < ids.size(); ++i) {
+		Session* session = sessionManager.getSession(ids[i]);
+		all_found = all_found && session && session->getSessionId() == ids[i];
+	}
+	expectEqual(all_found && sessionManager.getSessionCount() == 5000,
+		"Every session is found after the table grew");
+	for (size_t i = 0; i < ids.size(); i += 2) {
+		sessionManager.destroySession(ids[i]);
+	}
+	bool survivors_found = true;
+	for (size_t i = 1; i < ids.size(); i += 2) {
+		survivors_found = survivors_found && sessionManager.sessionExists(ids[i]);
+	}
+	expectEqual(survivors_found && !sessionManager.sessionExists(ids[0])
+		&& sessionManager.getSessionCount() == 2500,
+		"Deleting sessions keeps the others reachable");
+	expectEqual(!sessionManager.getSession("sess_1723723845_12345_67890"),
+		"Old-style session ids are not found");
+}
+
+void testSessionExpiry() {
+	timeUtils::updateClock();
+	SessionManager sessionManager;
+	std::string destroyed_id = sessionManager.createSession().getSessionId();
+	for (size_t i = 0; i < 10; ++i) {
+		sessionManager.createSession();
+	}
+	sessionManager.destroySession(destroyed_id);
+	expectEqual(sessionManager.getNextExpiry() == timeUtils::now() + 3601,
+		"Next expiry is one max-age after creation");
+	expectEqual(sessionManager.expireSessions(SESSION_EXPIRY_BATCH) == 0
+		&& sessionManager.getSessionCount() == 10,
+		"Nothing expires before its deadline");
+}
+
+// The stale and the touched entries fall due one second before the bulk
+void testSessionExpiryBatches() {
+	timeUtils::updateClock();
+	SessionManager sessionManager;
+	std::string stale_id = sessionManager.createSession().getSessionId();
+	std::string touched_id = sessionManager.createSession().getSessionId();
+	timeUtils::advanceClock(1);
+	const size_t bulk = SESSION_EXPIRY_BATCH * 2 + 20;
+	for (size_t i = 0; i < bulk; ++i) {
+		sessionManager.createSession();
+	}
+	sessionManager.destroySession(stale_id);
+	timeUtils::advanceClock(1799);
+	Session* touched = sessionManager.getSession(touched_id);
+	touched->updateLastAccessed();
+	timeUtils::advanceClock(1801);
+	expectEqual(sessionManager.expireSessions(SESSION_EXPIRY_BATCH) == 0 
+		&& sessionManager.getSessionCount() == bulk + 1,
+		"Touched session is re-armed and the stale entry skipped, not expired");
+	timeUtils::advanceClock(1);
+	size_t first = sessionManager.expireSessions(SESSION_EXPIRY_BATCH);
+	size_t second = sessionManager.expireSessions(SESSION_EXPIRY_BATCH);
+	size_t third = sessionManager.expireSessions(SESSION_EXPIRY_BATCH);
+	size_t fourth = sessionManager.expireSessions(SESSION_EXPIRY_BATCH);
+	expectEqual(first == SESSION_EXPIRY_BATCH && second == SESSION_EXPIRY_BATCH 
+		&& third == 20 && fourth == 0, "Expired sessions go in SESSION_EXPIRY_BATCH slices");
+	expectEqual(sessionManager.getSessionCount() == 1 
+		&& sessionManager.getSession(touched_id) == touched
+		&& sessionManager.getNextExpiry() == touched->getExpiry(),
+		"Touched session outlives its first deadline");
+	timeUtils::updateClock();
+}
+
+void testSessionSnapshot() {
+	timeUtils::updateClock();
+	const std::string path = "/tmp/webserv-test-sessions.bin";
+	SessionManager sessionManager;
+	Session& session = sessionManager.createSession();
+	std::string session_id = session.getSessionId();
+	session.getRecord().page_views = 7;
+	session.getRecord().last_page = "index.html";
+	session.setData("theme", "dark");
+	Session& forever = sessionManager.createSession();
+	forever.setMaxAge(-1);
+	std::string forever_id = forever.getSessionId();
+	expectEqual(sessionManager.writeSnapshot(path), "Snapshot is written");
+	SessionManager restored;
+	expectEqual(restored.loadSnapshot(path) == 2, "Snapshot loads every session");
+	Session* loaded = restored.getSession(session_id);
+	expectEqual(loaded && loaded->getRecord().page_views == 7
+		&& loaded->getRecord().last_page == "index.html"
+		&& loaded->getData("theme") == "dark"
+		&& loaded->getCreatedAt() == session.getCreatedAt(),
+		"Restored session keeps its id, record and data");
+	expectEqual(restored.getNextExpiry() == sessionManager.getNextExpiry(),
+		"Restored sessions expire when the originals would");
+
+	Session& short_lived = sessionManager.createSession();
+	short_lived.setMaxAge(1);
+	std::string short_id = short_lived.getSessionId();
+	sessionManager.writeSnapshot(path);
+	timeUtils::advanceClock(2);
+	SessionManager later;
+	expectEqual(later.loadSnapshot(path) == 2 && !later.sessionExists(short_id)
+		&& later.sessionExists(session_id), "Sessions expired since the snapshot are skipped");
+	timeUtils::updateClock();
+
+	expectEqual(sessionManager.beginSnapshot(path) && sessionManager.continueSnapshot(1),
+		"Snapshot is written a batch at a time");
+	// The oldest is written, the other two are not yet
+	sessionManager.destroySession(short_id);
+	forever.getRecord().page_views = 3;
+	while (sessionManager.continueSnapshot(1)) {
+	}
+	SessionManager batched;
+	expectEqual(!sessionManager.isSnapshotting() && batched.loadSnapshot(path) == 2
+		&& !batched.sessionExists(short_id) 
+		&& batched.getSession(forever_id)->getRecord().page_views == 3,
+		"Batched snapshot leaves out destroyed sessions and saves later changes");
+	unlink(path.c_str());
+}
+
+void testSessionLimits() {
+	timeUtils::updateClock();
+	SessionConfig sessionConfig;
+	sessionConfig.setMaxCount(3);
+	sessionConfig.setCreateRate(2, 60);
+	SessionManager sessionManager;
+	sessionManager.setConfig(sessionConfig);
+	std::string first = sessionManager.createSession().getSessionId();
+	std::string second = sessionManager.createSession().getSessionId();
+	sessionManager.createSession();
+	sessionManager.getSession(first);
+	sessionManager.createSession();
+	expectEqual(sessionManager.getSessionCount() == 3 && sessionManager.sessionExists(first)
+		&& !sessionManager.sessionExists(second),
+		"Least recently used session is evicted at session_max_count");
+	expectEqual(sessionManager.allowCreation("10.0.0.1") 
+		&& sessionManager.allowCreation("10.0.0.1") 
+		&& !sessionManager.allowCreation("10.0.0.1") 
+		&& sessionManager.allowCreation("10.0.0.2"),
+		"Session creation is rate limited per client IP");
+}
+
+void testSessionCookieBackend() {
+	timeUtils::updateClock();
+	SessionConfig sessionConfig;
+	sessionConfig.setBackend("cookie");
+	sessionConfig.setSecret("0123456789abcdef0123456789abcdef");
+	SessionManager sessionManager;
+	sessionManager.setConfig(sessionConfig);
+	Session& session = sessionManager.createSession();
+	session.getRecord().page_views = 7;
+	session.setData("theme", "dark");
+	std::string id = session.getSessionId();
+	std::string token = sessionManager.issueCookie(session, "");
+	Session* restored = sessionManager.getSession(token);
+	expectEqual(sessionManager.getSessionCount() == 0 && restored 
+		&& restored->getSessionId() == id && restored->getRecord().page_views == 7
+		&& restored->getData("theme") == "dark",
+		"Cookie backend keeps the session in the signed cookie");
+	expectEqual(sessionManager.issueCookie(*restored, token).empty(),
+		"Unchanged cookie session is not re-sent");
+	std::string forged = token;
+	forged[forged.size() / 2] = forged[forged.size() / 2] == 'A' ? 'B' : 'A';
+	expectEqual(!sessionManager.getSession(forged) && !sessionManager.sessionExists(forged),
+		"Cookie with a bad signature is rejected");
+}
+
+static bool setsSessionCookie(HttpResponse& response) {
+	return response.toStringResponse().find("Set-Cookie: WEBSERV_SESSION=") 
+		!= std::string::npos;
+}
+
+void testSessionModes() {
+	timeUtils::updateClock();
+	HttpRequest request;
+	request.parse("GET / HTTP/1.1\r\nHost: a\r\n\r\n", "10.0.0.5");
+	SessionManager sessionManager;
+	LocationConfig locationConfig("/", 1024);
+
+	locationConfig.setSession("off");
+	Session pending("");
+	HttpResponse offResponse;
+	Session* session = cookieUtils::openSession(request, &locationConfig, 
+		sessionManager, offResponse, pending);
+	cookieUtils::commitSession(request, sessionManager, offResponse, session, pending);
+	expectEqual(!session && sessionManager.getSessionCount() == 0 
+		&& !setsSessionCookie(offResponse), "Session off creates no session and sends no cookie");
+
+	locationConfig.setSession("lazy");
+	Session readPending("");
+	HttpResponse readResponse;
+	session = cookieUtils::openSession(request, &locationConfig, sessionManager, 
+		readResponse, readPending);
+	cookieUtils::trackPageView(session, "/index.html");
+	cookieUtils::commitSession(request, sessionManager, readResponse, session, readPending);
+	expectEqual(session == &readPending && sessionManager.getSessionCount() == 0 
+		&& !setsSessionCookie(readResponse), "Lazy session is not created by a page view");
+
+	Session writePending("");
+	HttpResponse writeResponse;
+	session = cookieUtils::openSession(request, &locationConfig, sessionManager, 
+		writeResponse, writePending);
+	cookieUtils::trackFileUpload(session, "a.txt");
+	cookieUtils::commitSession(request, sessionManager, writeResponse, session, writePending);
+	expectEqual(sessionManager.getSessionCount() == 1 && setsSessionCookie(writeResponse),
+		"Lazy session is created and sent once it is marked changed");
+
+	locationConfig.setSession("on");
+	Session onPending("");
+	HttpResponse onResponse;
+	session = cookieUtils::openSession(request, &locationConfig, sessionManager, 
+		onResponse, onPending);
+	cookieUtils::commitSession(request, sessionManager, onResponse, session, onPending);
+	expectEqual(session && session != &onPending && sessionManager.getSessionCount() == 2 
+		&& setsSessionCookie(onResponse), "Session on creates a session right away");
+}
+
+// The script reports the soft limits it was started with
+void testCgiLimits() {
+	CgiLimits limits;
+	limits.cpu_seconds = 7;
+	limits.address_space = 0;
+	limits.open_files = 32;
+	limits.nice = 0;
+	int out[2];
+	int null_fd = open("/dev/null", O_RDONLY);
+	if (null_fd < 0 || pipe(out) < 0) {
+		expectEqual(false, "CGI limits test needs a pipe");
+		return;
+	}
+	char sh[] = "/bin/sh";
+	char flag[] = "-c";
+	char script[] = "ulimit -t; ulimit -n";
+	char* argv[] = { sh, flag, script, NULL };
+	char* envp[] = { NULL };
+	pid_t pid = cgiSpawner::spawnLocal("/", argv, envp, limits, null_fd, out[1]);
+	close(null_fd);
+	close(out[1]);
+	std::string output;
+	char buffer[64];
+	ssize_t bytes;
+	while ((bytes = read(out[0], buffer, sizeof(buffer))) > 0) {
+		output.append(buffer, bytes);
+	}
+	close(out[0]);
+	int status = 0;
+	expectEqual(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) 
+		&& WEXITSTATUS(status) == 0, "Limited script runs to completion");
+	expectEqual(output == "7\n32\n", "Script sees cpu_seconds and open_files as its limits");
+}
+
+// Runs a script printing header_block, and streams its response head
+static HttpResponse runCgiHeaders(const std::string& header_block) {
+	const std::string path = "/tmp/webserv-test-headers.sh";
+	std::ofstream script(path.c_str());
+	script << "#!/bin/sh\nprintf '" << header_block << "hello world'\n";
+	script.close();
+	chmod(path.c_str(), 0755);
+	HttpRequest request;
+	request.parse("GET /webserv-test-headers.sh HTTP/1.1\r\nHost: a\r\n\r\n", "127.0.0.1");
+	ServerConfig serverConfig;
+	LocationConfig locationConfig("/", 1024);
+	CgiHandler cgi(path, "/bin/sh", request, serverConfig, &locationConfig, "");
+	HttpResponse response;
+	if (cgi.start(-1)) {
+		while (cgi.readOutput()) {
+		}
+		httpHandler::beginCgiStream(cgi, response);
+		cgi.closeOutput();
+		cgi.reap();
+	}
+	unlink(path.c_str());
+	return response;
+}
+
+void testCgiHeaders() {
+	HttpResponse made = runCgiHeaders("Status: 201 Made\\r\\nLocation: /x\\r\\n"
+		"Set-Cookie: a=1\\r\\nSet-Cookie: b=2\\r\\nContent-Length: 5\\r\\n"
+		"Connection: close\\r\\nX-Script: yes\\r\\n\\r\\n");
+	std::string head = made.toStringHeaders();
+	expectEqual(head.find("HTTP/1.1 201 Made\r\n") == 0,
+		"Status header sets the status line, even beside Location");
+	expectEqual(made.getHeader("Location") == "/x" && made.getHeader("X-Script") == "yes",
+		"Script headers are passed on");
+	expectEqual(head.find("Set-Cookie: a=1\r\n") != std::string::npos
+		&& head.find("Set-Cookie: b=2\r\n") != std::string::npos, "Every Set-Cookie is kept");
+	expectEqual(made.getHeader("Content-Length") == "5" 
+		&& made.getHeader("Transfer-Encoding").empty() 
+		&& made.getHeader("Connection") != "close",
+		"Script Content-Length frames the body, Connection stays ours");
+
+	HttpResponse redirect = runCgiHeaders("Location: /y\\n\\n");
+	expectEqual(redirect.getStatusCode() == 302 && redirect.getHeader("Location") == "/y",
+		"Location alone means 302");
+
+	HttpResponse unsized = runCgiHeaders("Content-Length: 5x\\r\\n\\r\\n");
+	expectEqual(unsized.getHeader("Content-Length").empty() 
+		&& unsized.getHeader("Transfer-Encoding") == "chunked",
+		"Content-Length that is not a number is replaced by chunks");
+}
+
+// Output past the announced Content-Length never reaches the client
+void testCgiStreamCap() {
+	VirtualHosts virtualHosts;
+	Client client(-1, NULL, virtualHosts, "127.0.0.1");
+	HttpResponse response;
+	response.buildOk("", "text/plain");
+	response.setHeader("Content-Length", "5");
+	response.setStreamed(true);
+	client.startStream(response);
+	std::string head = client.getResponseBuffer();
+	client.appendStreamBody("hel");
+	expectEqual(!client.isStreamFilled(), "Stream is open below its Content-Length");
+	client.appendStreamBody("lo world");
+	expectEqual(client.isStreamFilled() && client.getResponseBuffer() == head + "hello",
+		"Stream is cut at its Content-Length");
+}
+
+// Output keeps pushing the idle deadline, never past the overall cap
+void testCgiRunCap() {
+	timeUtils::updateClock();
+	HttpRequest request;
+	request.parse("GET /true HTTP/1.1\r\nHost: a\r\n\r\n", "127.0.0.1");
+	ServerConfig serverConfig;
+	LocationConfig locationConfig("/", 1024);
+	CgiHandler cgi("/bin/true", "", request, serverConfig, &locationConfig, "");
+	long launch_ms = timeUtils::nowMs();
+	cgi.start(-1);
+	expectEqual(cgi.getDeadlineMs() == launch_ms + TIMEOUT_SECONDS * 1000L,
+		"Script starts with the idle timeout");
+	timeUtils::advanceClock(CGI_MAX_RUN_SECONDS - 1);
+	cgi.markActivity();
+	expectEqual(cgi.getDeadlineMs() == launch_ms + CGI_MAX_RUN_SECONDS * 1000L,
+		"Activity does not push the deadline past CGI_MAX_RUN_SECONDS");
+	timeUtils::advanceClock(1);
+	cgi.markActivity();
+	expectEqual(cgi.hasTimedOut(timeUtils::nowMs()), "Busy script times out at the cap");
+	cgi.closeOutput();
+	cgi.abort();
+	cgi.reap();
+	timeUtils::updateClock();
+}
+
+// An NPH script writes its own status line straight to the client socket
+void testCgiNph() {
+	HttpRequest request;
+	request.parse("GET /nph-test.sh HTTP/1.1\r\nHost: a\r\n\r\n", "127.0.0.1");
+	ServerConfig serverConfig;
+	LocationConfig locationConfig("/", 1024);
+	CgiHandler plain("/tmp/test.sh", "/bin/sh", request, serverConfig, &locationConfig, "");
+	expectEqual(!plain.isNph(), "Script is not NPH by default");
+	LocationConfig nphLocation("/", 1024);
+	nphLocation.setCgiNph(true);
+	CgiHandler forced("/tmp/test.sh", "/bin/sh", request, serverConfig, &nphLocation, "");
+	expectEqual(forced.isNph(), "cgi_nph on makes every script NPH");
+
+	const std::string path = "/tmp/nph-webserv-test.sh";
+	std::ofstream script(path.c_str());
+	script << "#!/bin/sh\nprintf 'HTTP/1.1 299 Raw\\r\\n\\r\\nnph'\n";
+	script.close();
+	chmod(path.c_str(), 0755);
+	CgiHandler cgi(path, "/bin/sh", request, serverConfig, &locationConfig, "");
+	expectEqual(cgi.isNph(), "nph- filename prefix is detected");
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		expectEqual(false, "NPH test needs a socket pair");
+		return;
+	}
+	bool started = cgi.start(sv[0]);
+	close(sv[0]);
+	std::string received;
+	char buffer[64];
+	ssize_t bytes;
+	while ((bytes = read(sv[1], buffer, sizeof(buffer))) > 0) {
+		received.append(buffer, bytes);
+	}
+	close(sv[1]);
+	cgi.closeOutput();
+	cgi.reap();
+	unlink(path.c_str());
+	expectEqual(started && received == "HTTP/1.1 299 Raw\r\n\r\nnph",
+		"NPH script output reaches the client untouched");
+}
+
+void testSessionTracking() {
+	timeUtils::updateClock();
+	Session session("");
+	cookieUtils::trackPageView(&session, "/www/index.html");
+	cookieUtils::trackPageView(&session, "/www/about.html");
+	expectEqual(!session.isChanged(), "Page views do not mark the session changed");
+	cookieUtils::trackFileUpload(&session, "a.txt");
+	cookieUtils::trackFileDelete(&session, "/uploads/b.txt");
+	cookieUtils::trackCgiExecution(&session, "/cgi-bin/x.py");
+	const SessionRecord& record = session.getRecord();
+	time_t now = timeUtils::now();
+	expectEqual(record.page_views == 2 && record.last_page == "/www/about.html"
+		&& record.last_page_time == now, "trackPageView updates the page fields");
+	expectEqual(record.upload_count == 1 && record.last_upload == "a.txt"
+		&& record.last_upload_time == now, "trackFileUpload updates the upload fields");
+	expectEqual(record.delete_count == 1 && record.last_delete == "/uploads/b.txt"
+		&& record.last_delete_time == now, "trackFileDelete updates the delete fields");
+	expectEqual(record.cgi_count == 1 && record.last_cgi == "/cgi-bin/x.py"
+		&& record.last_cgi_time == now && session.isChanged(), 
+		"trackCgiExecution updates the CGI fields");
+
+	struct tm timeinfo;
+	localtime_r(&now, &timeinfo);
+	char clock[20];
+	std::strftime(clock, sizeof(clock), "%H:%M:%S", &timeinfo);
+	std::string at = clock;
+	expectEqual(cookieUtils::getSessionStatsJson(&session) == "{\"page_views\":2,"
+		"\"upload_count\":1,\"delete_count\":1,\"cgi_count\":1,"
+		"\"last_page_view\":\"" + at + "\",\"last_upload\":\"" + at + "\","
+		"\"last_delete\":\"" + at + "\",\"last_cgi\":\"" + at + "\","
+		"\"last_page_name\":\"about.html\",\"last_upload_file\":\"a.txt\","
+		"\"last_delete_file\":\"/uploads/b.txt\",\"last_cgi_script\":\"x.py\"}",
+		"Session stats JSON keeps its format");
+	expectEqual(cookieUtils::getSessionStatsJson(NULL) == "{\"page_views\":0,"
+		"\"upload_count\":0,\"delete_count\":0,\"cgi_count\":0,"
+		"\"last_page_view\":\"never\",\"last_upload\":\"never\","
+		"\"last_delete\":\"never\",\"last_cgi\":\"never\","
+		"\"last_page_name\":\"-\",\"last_upload_file\":\"-\","
+		"\"last_delete_file\":\"-\",\"last_cgi_script\":\"-\"}",
+		"No session gives zeroed stats");
+}
+
+// A full cache drops its stale entries, or a single one, never everything
+void testStatCacheEviction() {
+	timeUtils::updateClock();
+	statCache::clear();
+	for (size_t i = 0; i < STAT_CACHE_MAX_ENTRIES; ++i) {
+		statCache::lookup("/nonexistent/" + stringUtils::toString(i));
+	}
+	statCache::lookup("/nonexistent/fresh");
+	expectEqual(statCache::getEntryCount() == STAT_CACHE_MAX_ENTRIES,
+		"Full stat cache evicts one entry when all are fresh");
+	timeUtils::advanceClock(STAT_CACHE_TTL_SECONDS);
+	statCache::lookup("/nonexistent/fresh");
+	statCache::lookup("/nonexistent/next");
+	expectEqual(statCache::getEntryCount() == 2,
+		"Full stat cache sweeps its stale entries");
+	statCache::clear();
+	timeUtils::updateClock();
+}